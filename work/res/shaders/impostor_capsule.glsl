@@ -0,0 +1,105 @@
+//---------------------------------------------------------------------------
+//
+// Ray-cast capsule impostor
+//
+// Each instance is the bounding box of a capsule (a cylinder with
+// hemispherical caps) between two points. The fragment shader intersects
+// the view ray with the capsule, discards misses and writes the depth of
+// the hit.
+//
+// Compiled with makeShaderProgram(profile, stypes, source), which defines
+// _VERTEX_ or _FRAGMENT_ for the stage being compiled.
+//
+//---------------------------------------------------------------------------
+
+varying vec3 v_position; // view space position on the box
+varying vec3 v_start;    // view space capsule end points
+varying vec3 v_end;
+varying float v_radius;  // view space radius of the capsule
+
+
+#ifdef _VERTEX_
+
+attribute vec3 a_corner; // box corner in [-1, 1]
+attribute vec4 a_start;  // per instance, xyz = start, w = radius
+attribute vec3 a_end;    // per instance, end
+
+void main() {
+	v_start = (gl_ModelViewMatrix * vec4(a_start.xyz, 1.0)).xyz;
+	v_end = (gl_ModelViewMatrix * vec4(a_end, 1.0)).xyz;
+	v_radius = a_start.w * length(gl_ModelViewMatrix[0].xyz);
+
+	// Box around the segment, extended by the radius in every direction
+	vec3 axis = v_end - v_start;
+	float half_length = 0.5 * length(axis);
+	vec3 u = half_length > 0.0 ? axis / (2.0 * half_length) : vec3(0.0, 0.0, 1.0);
+	vec3 v = abs(u.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+	vec3 w = normalize(cross(u, v));
+	v = cross(w, u);
+
+	vec3 center = 0.5 * (v_start + v_end);
+	v_position = center
+		+ u * a_corner.x * (half_length + v_radius)
+		+ v * a_corner.y * v_radius
+		+ w * a_corner.z * v_radius;
+
+	gl_FrontColor = gl_Color;
+	gl_Position = gl_ProjectionMatrix * vec4(v_position, 1.0);
+}
+
+#endif
+
+
+#ifdef _FRAGMENT_
+
+// Distance along rd to the first hit, or -1 for a miss
+float intersectCapsule(vec3 rd, vec3 pa, vec3 pb, float r) {
+	vec3 ba = pb - pa;
+	vec3 oa = -pa;
+	float baba = dot(ba, ba);
+	float bard = dot(ba, rd);
+	float baoa = dot(ba, oa);
+	float rdoa = dot(rd, oa);
+	float oaoa = dot(oa, oa);
+
+	// infinite cylinder
+	float a = baba - bard * bard;
+	float b = baba * rdoa - baoa * bard;
+	float c = baba * oaoa - baoa * baoa - r * r * baba;
+	float h = b * b - a * c;
+	if (h >= 0.0) {
+		float t = (-b - sqrt(h)) / a;
+		float y = baoa + t * bard;
+		if (y > 0.0 && y < baba) return t;
+
+		// hemispherical caps
+		vec3 oc = (y <= 0.0) ? oa : -pb;
+		b = dot(rd, oc);
+		c = dot(oc, oc) - r * r;
+		h = b * b - c;
+		if (h > 0.0) return -b - sqrt(h);
+	}
+	return -1.0;
+}
+
+void main() {
+	// ray from the eye (the origin in view space)
+	vec3 rd = normalize(v_position);
+	float t = intersectCapsule(rd, v_start, v_end, v_radius);
+	if (t < 0.0) discard;
+
+	vec3 p = rd * t;
+	vec3 ba = v_end - v_start;
+	float s = clamp(dot(p - v_start, ba) / max(dot(ba, ba), 1e-12), 0.0, 1.0);
+	vec3 n = (p - v_start - s * ba) / v_radius;
+
+	// match the fixed function lighting set up in setupLight()
+	vec3 l = normalize(gl_LightSource[0].position.xyz);
+	vec4 diffuse = gl_LightSource[0].diffuse * max(dot(n, l), 0.0);
+	gl_FragColor = vec4((gl_LightSource[0].ambient + diffuse).rgb * gl_Color.rgb, gl_Color.a);
+
+	vec4 clip = gl_ProjectionMatrix * vec4(p, 1.0);
+	gl_FragDepth = 0.5 * (gl_DepthRange.diff * clip.z / clip.w + gl_DepthRange.near + gl_DepthRange.far);
+}
+
+#endif
@@ -0,0 +1,66 @@
+//---------------------------------------------------------------------------
+//
+// Ray-cast sphere impostor
+//
+// Each instance is a single quad facing the eye. The fragment shader
+// intersects the view ray with the sphere, discards misses and writes the
+// depth of the hit so impostors intersect correctly with real geometry.
+//
+// Compiled with makeShaderProgram(profile, stypes, source), which defines
+// _VERTEX_ or _FRAGMENT_ for the stage being compiled.
+//
+//---------------------------------------------------------------------------
+
+varying vec3 v_position; // view space position on the quad
+varying vec3 v_center;   // view space center of the sphere
+varying float v_radius;  // view space radius of the sphere
+
+
+#ifdef _VERTEX_
+
+attribute vec2 a_corner; // quad corner in [-1, 1]
+attribute vec4 a_sphere; // per instance, xyz = center, w = radius
+
+void main() {
+	v_center = (gl_ModelViewMatrix * vec4(a_sphere.xyz, 1.0)).xyz;
+	v_radius = a_sphere.w * length(gl_ModelViewMatrix[0].xyz);
+
+	// Basis facing the eye. A quad of half-size r placed on the
+	// near side of the sphere always covers its silhouette.
+	vec3 forward = normalize(-v_center);
+	vec3 up = abs(forward.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+	vec3 right = normalize(cross(up, forward));
+	up = cross(forward, right);
+
+	v_position = v_center + (forward + right * a_corner.x + up * a_corner.y) * v_radius;
+
+	gl_FrontColor = gl_Color;
+	gl_Position = gl_ProjectionMatrix * vec4(v_position, 1.0);
+}
+
+#endif
+
+
+#ifdef _FRAGMENT_
+
+void main() {
+	// ray from the eye (the origin in view space)
+	vec3 rd = normalize(v_position);
+	float b = dot(rd, v_center);
+	float c = dot(v_center, v_center) - v_radius * v_radius;
+	float h = b * b - c;
+	if (h < 0.0) discard;
+
+	vec3 p = rd * (b - sqrt(h));
+	vec3 n = (p - v_center) / v_radius;
+
+	// match the fixed function lighting set up in setupLight()
+	vec3 l = normalize(gl_LightSource[0].position.xyz);
+	vec4 diffuse = gl_LightSource[0].diffuse * max(dot(n, l), 0.0);
+	gl_FragColor = vec4((gl_LightSource[0].ambient + diffuse).rgb * gl_Color.rgb, gl_Color.a);
+
+	vec4 clip = gl_ProjectionMatrix * vec4(p, 1.0);
+	gl_FragDepth = 0.5 * (gl_DepthRange.diff * clip.z / clip.w + gl_DepthRange.near + gl_DepthRange.far);
+}
+
+#endif
@@ -0,0 +1,94 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#include "alloc_tracker.hpp"
+
+#ifdef CGRA_ALLOC_TRACKING
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+	// Constant initialized, so allocations made by other static
+	// constructors before main are counted too
+	std::atomic<unsigned long long> g_allocations { 0 };
+	std::atomic<unsigned long long> g_frees { 0 };
+	std::atomic<unsigned long long> g_bytes { 0 };
+
+	void * allocate(std::size_t size) {
+		g_allocations.fetch_add(1, std::memory_order_relaxed);
+		g_bytes.fetch_add(size, std::memory_order_relaxed);
+
+		// malloc(0) may return null, operator new must not
+		if (size == 0) size = 1;
+		while (true) {
+			void *p = std::malloc(size);
+			if (p) return p;
+			std::new_handler handler = std::get_new_handler();
+			if (!handler) throw std::bad_alloc();
+			handler();
+		}
+	}
+
+	void deallocate(void *p) {
+		if (!p) return;
+		g_frees.fetch_add(1, std::memory_order_relaxed);
+		std::free(p);
+	}
+
+	void * allocateNoThrow(std::size_t size) {
+		try {
+			return allocate(size);
+		} catch (const std::bad_alloc &) {
+			return nullptr;
+		}
+	}
+}
+
+void * operator new(std::size_t size) { return allocate(size); }
+void * operator new[](std::size_t size) { return allocate(size); }
+void * operator new(std::size_t size, const std::nothrow_t &) noexcept { return allocateNoThrow(size); }
+void * operator new[](std::size_t size, const std::nothrow_t &) noexcept { return allocateNoThrow(size); }
+
+void operator delete(void *p) noexcept { deallocate(p); }
+void operator delete[](void *p) noexcept { deallocate(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { deallocate(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { deallocate(p); }
+void operator delete(void *p, std::size_t) noexcept { deallocate(p); }
+void operator delete[](void *p, std::size_t) noexcept { deallocate(p); }
+
+#endif
+
+namespace cgra {
+
+	bool allocTrackingEnabled() {
+#ifdef CGRA_ALLOC_TRACKING
+		return true;
+#else
+		return false;
+#endif
+	}
+
+
+	alloc_counts allocCounts() {
+		alloc_counts c;
+#ifdef CGRA_ALLOC_TRACKING
+		c.allocations = g_allocations.load(std::memory_order_relaxed);
+		c.frees = g_frees.load(std::memory_order_relaxed);
+		c.bytes = g_bytes.load(std::memory_order_relaxed);
+#endif
+		return c;
+	}
+}
@@ -0,0 +1,48 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#pragma once
+
+// Heap allocation counting, built when CGRA_ALLOC_TRACKING is defined (the
+// CMake option of the same name). The global operator new and delete are
+// replaced with versions that count every allocation, from any thread,
+// before passing on to malloc and free. Without the option the counts stay
+// at zero and nothing is replaced.
+//
+// The frame profiler shows the allocations made in each frame, and the
+// "alloc" benchmark checks that playing a clip allocates nothing once it
+// has warmed up.
+
+namespace cgra {
+
+	struct alloc_counts {
+		unsigned long long allocations = 0;
+		unsigned long long frees = 0;
+		unsigned long long bytes = 0; // requested by the allocations
+	};
+
+	inline alloc_counts operator-(const alloc_counts &a, const alloc_counts &b) {
+		alloc_counts d;
+		d.allocations = a.allocations - b.allocations;
+		d.frees = a.frees - b.frees;
+		d.bytes = a.bytes - b.bytes;
+		return d;
+	}
+
+	// Whether the counting operator new was built in
+	bool allocTrackingEnabled();
+
+	// Totals since the program started
+	alloc_counts allocCounts();
+}
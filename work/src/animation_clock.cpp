@@ -0,0 +1,108 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "animation_clock.hpp"
+
+using namespace std;
+
+
+AnimationClock::AnimationClock(double rate, int maxSteps) : m_step(1 / rate), m_maxSteps(maxSteps) {
+	assert(rate > 0 && maxSteps > 0);
+}
+
+
+int AnimationClock::update(double now) {
+	if (m_lastTime < 0) m_lastTime = now;
+	m_accumulator += now - m_lastTime;
+	m_lastTime = now;
+
+	// Nothing to simulate while paused
+	if (m_speed == 0) {
+		m_accumulator = 0;
+		m_previous = m_current;
+		return 0;
+	}
+
+	int steps = 0;
+	while (m_accumulator >= m_step) {
+		// After a hitch, drop whatever we cannot catch up on
+		// rather than spending the next frames catching up
+		if (steps == m_maxSteps) {
+			double backlog = floor(m_accumulator / m_step);
+			m_dropped += (unsigned long) backlog;
+			m_accumulator -= backlog * m_step;
+			break;
+		}
+
+		m_previous = m_current;
+		m_current = wrap(m_current + m_speed);
+		m_accumulator -= m_step;
+		steps++;
+	}
+
+	// When wrapping, keep the previous step on the same side so
+	// interpolation does not sweep back through the whole clip
+	if (m_length > 0 && abs(m_current - m_previous) > m_length / 2.0) {
+		m_previous += (m_current > m_previous) ? m_length : -m_length;
+	}
+
+	return steps;
+}
+
+
+void AnimationClock::setLength(int frames) {
+	m_length = frames;
+	m_speed = clampSpeed(m_speed);
+}
+
+
+void AnimationClock::fastForward() {
+	m_speed = clampSpeed((m_speed == 0) ? 2 : m_speed * 2);
+}
+
+
+double AnimationClock::frame() const {
+	return wrap(m_previous + (m_current - m_previous) * alpha());
+}
+
+
+void AnimationClock::stop() {
+	m_speed = 0;
+	seek(0);
+}
+
+
+void AnimationClock::seek(double frame) {
+	m_current = m_previous = wrap(frame);
+}
+
+
+// A step must stay under half the clip, or the wrap fixup in update()
+// cannot tell which way the playhead went
+double AnimationClock::clampSpeed(double speed) const {
+	double limit = max_speed;
+	if (m_length > 0) limit = min(limit, max(1.0, ceil(m_length / 2.0) - 1));
+	return max(-limit, min(limit, speed));
+}
+
+
+double AnimationClock::wrap(double frame) const {
+	if (m_length <= 0) return frame;
+	frame = fmod(frame, double(m_length));
+	return (frame < 0) ? frame + m_length : frame;
+}
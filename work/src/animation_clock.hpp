@@ -0,0 +1,74 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#pragma once
+
+
+// Fixed-timestep clock for animation playback.
+//
+// Wall time (from glfwGetTime) is accumulated and consumed in whole steps
+// of 1/rate seconds, each of which moves the playhead by the playback
+// speed (in frames). The frame to render is interpolated between the last
+// two steps, so playback runs at the same speed on any monitor.
+class AnimationClock {
+
+private:
+	double m_step;             // Seconds per simulation step
+	int m_maxSteps;            // Most steps taken by one update, the rest is dropped
+	double m_lastTime = -1;    // Time of the last update
+	double m_accumulator = 0;  // Time not yet consumed by a step
+	double m_previous = 0;     // Playhead (frames) before and after the last step
+	double m_current = 0;
+	double m_speed = 0;        // Frames per step, 0 when paused
+	int m_length = 0;          // Frames in the clip, the playhead wraps around it
+	unsigned long m_dropped = 0;
+
+	double wrap(double) const;
+	double clampSpeed(double) const;
+
+public:
+	// Fastest playback, in frames per step
+	static constexpr double max_speed = 16;
+
+	// The default rate matches the 120Hz AMC captures
+	explicit AnimationClock(double rate = 120, int maxSteps = 8);
+
+	// Consumes the time since the last update in fixed steps,
+	// returns how many steps were taken
+	int update(double now);
+
+	// Interpolated playhead for rendering
+	double frame() const;
+
+	// Fraction of a step between the last step and now
+	double alpha() const { return m_accumulator / m_step; }
+
+	void setLength(int frames);
+	int length() const { return m_length; }
+
+	// Playback controls
+	void play() { m_speed = 1; }
+	void pause() { m_speed = 0; }
+	void stop();
+	void rewind() { m_speed = -1; }
+	void fastForward();
+	void seek(double frame);
+
+	bool playing() const { return m_speed != 0; }
+	double speed() const { return m_speed; }
+	double stepRate() const { return 1 / m_step; }
+
+	// Steps dropped by the catch-up limit so far
+	unsigned long droppedSteps() const { return m_dropped; }
+};
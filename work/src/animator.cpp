@@ -0,0 +1,94 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#include <chrono>
+
+#include "animator.hpp"
+#include "profiler.hpp"
+
+using namespace std;
+using namespace cgra;
+
+
+Animator::Animator(const Skeleton *skeleton, function<void()> onPublish) : m_skeleton(skeleton), m_onPublish(onPublish) {
+	m_thread = thread(&Animator::run, this);
+}
+
+
+Animator::~Animator() {
+	{
+		lock_guard<mutex> lock(m_wakeMutex);
+		m_running = false;
+	}
+	m_wake.notify_one();
+	m_thread.join();
+}
+
+
+void Animator::request(float frame) {
+	// Trace viewers attach flow events to the enclosing slice
+	CGRA_PROFILE_SCOPE("Request pose");
+	m_requestedFrame = frame;
+	{
+		lock_guard<mutex> lock(m_wakeMutex);
+		m_requests++;
+		CGRA_TRACE_FLOW_BEGIN("Pose request", m_requests.load());
+	}
+	m_wake.notify_one();
+}
+
+
+bool Animator::acquire() {
+	return m_poses.acquire();
+}
+
+
+double Animator::now() {
+	using namespace std::chrono;
+	static const steady_clock::time_point start = steady_clock::now();
+	return duration<double>(steady_clock::now() - start).count();
+}
+
+
+void Animator::run() {
+	unsigned handled = 0;
+	pose p;
+	CGRA_TRACE_THREAD("Animator");
+
+	while (true) {
+		// Sleep until there is a new request (or we are shut down)
+		{
+			unique_lock<mutex> lock(m_wakeMutex);
+			m_wake.wait(lock, [&] { return !m_running || m_requests != handled; });
+			if (!m_running) return;
+			handled = m_requests;
+		}
+
+		pose_snapshot &snapshot = m_poses.back();
+		snapshot.frame = m_requestedFrame;
+		snapshot.evalStart = now();
+
+		{
+			CGRA_PROFILE_SCOPE("Evaluate pose");
+			// Requests made while we were busy are coalesced, only the latest one lands
+			CGRA_TRACE_FLOW_END("Pose request", handled);
+			m_skeleton->samplePose(snapshot.frame, p);
+			m_skeleton->evaluatePose(p, snapshot.world);
+		}
+
+		snapshot.evalEnd = now();
+		m_poses.publish();
+		if (m_onPublish) m_onPublish();
+	}
+}
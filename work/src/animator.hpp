@@ -0,0 +1,84 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cgra_math.hpp"
+#include "skeleton.hpp"
+#include "triple_buffer.hpp"
+
+
+// A pose evaluated by the animation thread, ready to be rendered
+struct pose_snapshot {
+	std::vector<cgra::affine3> world; // World transform of each bone
+	float frame = 0;                  // Frame of motion that was sampled
+	double evalStart = 0;             // Animator::now() around the evaluation
+	double evalEnd = 0;
+};
+
+
+// Samples and evaluates the skeleton's motion on its own thread.
+//
+// The main thread requests the frame it wants next and picks up finished
+// poses through a triple buffer, so it can submit frame N while frame N+1
+// is being evaluated.
+class Animator {
+
+private:
+	const Skeleton *m_skeleton;
+	cgra::triple_buffer<pose_snapshot> m_poses;
+
+	std::thread m_thread;
+	std::atomic<bool> m_running { true };
+	std::atomic<float> m_requestedFrame { 0 };
+	std::atomic<unsigned> m_requests { 0 };
+
+	// Only used to wake the thread when there is work, pose data never
+	// passes through the lock
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wake;
+
+	std::function<void()> m_onPublish;
+
+	void run();
+
+public:
+	// The callback is run on the animation thread after every pose is
+	// published (eg. glfwPostEmptyEvent to wake an idle main loop)
+	explicit Animator(const Skeleton *, std::function<void()> onPublish = nullptr);
+	~Animator();
+
+	Animator(const Animator &) = delete;
+	Animator & operator=(const Animator &) = delete;
+
+	// Asks the animation thread to evaluate the given frame
+	void request(float frame);
+
+	// Picks up the most recently evaluated pose, returns false if
+	// nothing new has finished since the last call
+	bool acquire();
+
+	// The pose picked up by the last successful acquire
+	const pose_snapshot & current() const { return m_poses.front(); }
+
+	// Seconds on a steady clock shared by both threads, for timing
+	static double now();
+};
@@ -0,0 +1,952 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "alloc_tracker.hpp"
+#include "animation_clock.hpp"
+#include "animator.hpp"
+#include "benchmark.hpp"
+#include "cgra_math.hpp"
+#include "cgra_soa.hpp"
+#include "dualquat.hpp"
+#include "frame_arena.hpp"
+#include "profiler.hpp"
+#include "quat.hpp"
+#include "quat_soa.hpp"
+#include "skeleton.hpp"
+#include "skinning.hpp"
+
+using namespace std;
+using namespace cgra;
+
+
+namespace {
+
+	// Results are written here so the benchmarked code is not optimized away
+	volatile float g_sink = 0;
+
+
+	// The math types are usable in constant expressions. The SSE overloads are
+	// not constexpr, so matrix4<float> products name the generic template here
+	constexpr vec3 c_x(1, 0, 0), c_y(0, 1, 0);
+	static_assert(cross(c_x, c_y) == vec3(0, 0, 1), "constexpr cross");
+	static_assert(dot(c_x + c_y, c_y) == 1, "constexpr dot");
+
+	constexpr mat3 c_rot(0, 1, 0, -1, 0, 0, 0, 0, 1);
+	static_assert(c_rot * c_x == c_y, "constexpr matrix3 * vector3");
+	static_assert(determinant(c_rot) == 1, "constexpr determinant");
+
+	constexpr mat4 c_model = operator*<float, float>(mat4::translate(1, 2, 3), mat4::scale(2.f));
+	static_assert(c_model[3] == vec4(1, 2, 3, 1) && c_model[1].y == 2, "constexpr matrix4 product");
+	static_assert(transpose<float>(c_model)[0].w == 1, "constexpr transpose");
+
+	constexpr affine3 c_affine = operator*<float, float>(affine3::translate(vec3(0, 0, 5)), affine3(c_rot, c_x));
+	static_assert(c_affine.translation() == vec3(1, 0, 5), "constexpr affine3 product");
+
+	constexpr quat c_qx(0, 1, 0, 0), c_qy(0, 0, 1, 0);
+	static_assert((c_qx * c_qy).z == 1, "constexpr quat product");
+	static_assert(mat4(c_qx * c_qy)[0].x == -1, "constexpr quat to matrix4");
+
+
+	// Best time of several runs of f, in nanoseconds per item
+	// where f processes the given number of items per call
+	template <typename F>
+	double timePerItem(size_t items, F f, int runs = 7, int callsPerRun = 200) {
+		using namespace std::chrono;
+		double best = 1e300;
+		for (int r = 0; r < runs; r++) {
+			steady_clock::time_point start = steady_clock::now();
+			for (int c = 0; c < callsPerRun; c++) f();
+			double ns = duration<double, nano>(steady_clock::now() - start).count();
+			best = min(best, ns / (double(callsPerRun) * items));
+		}
+		return best;
+	}
+
+
+	// Distance between two floats in units in the last place
+	int64_t ulps(float a, float b) {
+		int32_t ia, ib;
+		memcpy(&ia, &a, sizeof(float));
+		memcpy(&ib, &b, sizeof(float));
+		// map the sign-magnitude bits onto a monotonic integer line
+		int64_t la = (ia < 0) ? int64_t(INT32_MIN) - ia : ia;
+		int64_t lb = (ib < 0) ? int64_t(INT32_MIN) - ib : ib;
+		return (la > lb) ? la - lb : lb - la;
+	}
+
+
+	// Largest difference between two matrices, in ulps of their largest
+	// element (so entries that should be zero do not dominate)
+	double matrixUlps(const mat4 &a, const mat4 &b) {
+		float scale = 0, diff = 0;
+		for (int i = 0; i < 4; i++) {
+			for (int j = 0; j < 4; j++) {
+				scale = max(scale, abs(a[i][j]));
+				diff = max(diff, abs(a[i][j] - b[i][j]));
+			}
+		}
+		return (scale == 0) ? diff : diff / (scale * numeric_limits<float>::epsilon());
+	}
+
+
+	void report(const string &name, double generic, double optimized) {
+		ios::fmtflags flags = cout.flags();
+		cout << "  " << left << setw(24) << name << right << fixed << setprecision(2)
+			<< setw(9) << generic << " ns" << setw(9) << optimized << " ns"
+			<< setw(8) << generic / optimized << "x" << endl;
+		cout.flags(flags);
+	}
+
+
+	// Throughput of the AoS and SoA versions, in millions of points per second
+	void reportThroughput(const string &name, double aos, double soa) {
+		ios::fmtflags flags = cout.flags();
+		cout << "  " << left << setw(24) << name << right << fixed << setprecision(1)
+			<< setw(9) << 1e3 / aos << " M/s" << setw(8) << 1e3 / soa << " M/s"
+			<< setw(7) << setprecision(2) << aos / soa << "x" << endl;
+		cout.flags(flags);
+	}
+
+
+	bool check(const string &what, double error, double tolerance) {
+		bool ok = error <= tolerance;
+		cout << "  " << left << setw(24) << what << right << (ok ? "ok" : "FAILED")
+			<< " (max error " << error << ", tolerance " << tolerance << ")" << endl;
+		return ok;
+	}
+
+
+	// matrix4<float> SSE specializations against the generic templates
+	//
+	bool benchMath() {
+#ifndef CGRA_SIMD_SSE
+		cout << "  SSE specializations not compiled in (CGRA_NO_SIMD or no SSE)" << endl;
+		return true;
+#else
+		const size_t n = 1024;
+		vector<mat4> a(n), b(n), r(n);
+		vector<vec4> v(n), rv(n);
+		for (size_t i = 0; i < n; i++) {
+			// keep the matrices well conditioned so inverses are comparable
+			a[i] = mat4::random(-1, 1) + mat4(3);
+			b[i] = mat4::random(-1, 1);
+			v[i] = vec4::random(-1, 1);
+		}
+
+		// Equivalence
+		double mulError = 0, mulVecError = 0, vecMulError = 0, transposeError = 0, inverseError = 0;
+		for (size_t i = 0; i < n; i++) {
+			mulError = max(mulError, matrixUlps(operator*<float, float>(a[i], b[i]), a[i] * b[i]));
+			transposeError = max(transposeError, matrixUlps(transpose<float>(a[i]), transpose(a[i])));
+			inverseError = max(inverseError, matrixUlps(inverse<float>(a[i]), inverse(a[i])));
+			vec4 gv = operator*<float, float>(a[i], v[i]), sv = a[i] * v[i];
+			vec4 gt = operator*<float, float>(v[i], a[i]), st = v[i] * a[i];
+			for (int j = 0; j < 4; j++) {
+				mulVecError = max(mulVecError, double(ulps(gv[j], sv[j])));
+				vecMulError = max(vecMulError, double(ulps(gt[j], st[j])));
+			}
+		}
+
+		bool ok = true;
+		ok &= check("mat4 * mat4", mulError, 0);
+		ok &= check("mat4 * vec4", mulVecError, 0);
+		ok &= check("vec4 * mat4", vecMulError, 0);
+		ok &= check("transpose", transposeError, 0);
+		ok &= check("inverse", inverseError, 16);
+
+		// Timing
+		cout << "  " << left << setw(24) << "" << right << setw(12) << "generic" << setw(12) << "sse" << endl;
+		report("mat4 * mat4",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = operator*<float, float>(a[i], b[i]); g_sink = r[n - 1][0][0]; }),
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = a[i] * b[i]; g_sink = r[n - 1][0][0]; }));
+		report("mat4 * vec4",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) rv[i] = operator*<float, float>(a[i], v[i]); g_sink = rv[n - 1][0]; }),
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) rv[i] = a[i] * v[i]; g_sink = rv[n - 1][0]; }));
+		report("vec4 * mat4",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) rv[i] = operator*<float, float>(v[i], a[i]); g_sink = rv[n - 1][0]; }),
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) rv[i] = v[i] * a[i]; g_sink = rv[n - 1][0]; }));
+		report("transpose",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = transpose<float>(a[i]); g_sink = r[n - 1][0][0]; }),
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = transpose(a[i]); g_sink = r[n - 1][0][0]; }));
+		report("inverse",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = inverse<float>(a[i]); g_sink = r[n - 1][0][0]; }),
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = inverse(a[i]); g_sink = r[n - 1][0][0]; }));
+
+		return ok;
+#endif
+	}
+
+
+	// Affine and rigid inverses against the general inverse
+	//
+	bool benchInverse() {
+		const size_t n = 1024;
+		vector<mat4> rigid(n), affine(n), r(n);
+		for (size_t i = 0; i < n; i++) {
+			vec3 angles = vec3::random(-3, 3);
+			rigid[i] = mat4::translate(vec3::random(-10, 10))
+				* mat4::rotateZ(angles.z) * mat4::rotateY(angles.y) * mat4::rotateX(angles.x);
+			affine[i] = rigid[i] * mat4::scale(vec3::random(0.5f, 2));
+		}
+
+		// Equivalence
+		// (the generic templates are checked too, in case they are specialized)
+		double affineError = 0, rigidError = 0;
+		for (size_t i = 0; i < n; i++) {
+			mat4 general = inverse(affine[i]);
+			affineError = max(affineError, matrixUlps(general, inverseAffine(affine[i])));
+			affineError = max(affineError, matrixUlps(general, inverseAffine<float>(affine[i])));
+			general = inverse(rigid[i]);
+			rigidError = max(rigidError, matrixUlps(general, inverseRigid(rigid[i])));
+			rigidError = max(rigidError, matrixUlps(general, inverseRigid<float>(rigid[i])));
+		}
+
+		bool ok = true;
+		ok &= check("inverseAffine", affineError, 16);
+		ok &= check("inverseRigid", rigidError, 16);
+
+		// Timing
+		cout << "  " << left << setw(24) << "" << right << setw(12) << "inverse" << setw(12) << "fast" << endl;
+		report("inverseAffine",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = inverse(affine[i]); g_sink = r[n - 1][0][0]; }),
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = inverseAffine(affine[i]); g_sink = r[n - 1][0][0]; }));
+		report("inverseRigid",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = inverse(rigid[i]); g_sink = r[n - 1][0][0]; }),
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = inverseRigid(rigid[i]); g_sink = r[n - 1][0][0]; }));
+
+		return ok;
+	}
+
+
+	// affine3 composition and point transforms against mat4
+	//
+	bool benchAffine() {
+		const size_t n = 1024;
+		vector<mat4> ma(n), mb(n), mr(n);
+		vector<affine3> aa(n), ab(n), ar(n);
+		vector<vec3> p(n), rp(n);
+		for (size_t i = 0; i < n; i++) {
+			vec3 angles = vec3::random(-3, 3);
+			ma[i] = mat4::translate(vec3::random(-10, 10))
+				* mat4::rotateZ(angles.z) * mat4::rotateY(angles.y) * mat4::rotateX(angles.x);
+			mb[i] = mat4::translate(vec3::random(-10, 10)) * mat4::rotateX(angles.y) * mat4::scale(vec3::random(0.5f, 2));
+			aa[i] = affine3(ma[i]);
+			ab[i] = affine3(mb[i]);
+			p[i] = vec3::random(-1, 1);
+		}
+
+		// Equivalence
+		double composeError = 0, pointError = 0;
+		for (size_t i = 0; i < n; i++) {
+			mat4 m = ma[i] * mb[i];
+			composeError = max(composeError, matrixUlps(m, mat4(aa[i] * ab[i])));
+			composeError = max(composeError, matrixUlps(m, mat4(operator*<float, float>(aa[i], ab[i]))));
+			vec3 mp = vec3(m * vec4(p[i], 1)), ap = transformPoint(aa[i] * ab[i], p[i]);
+			for (int j = 0; j < 3; j++) {
+				pointError = max(pointError, double(ulps(mp[j], ap[j])));
+			}
+		}
+
+		bool ok = true;
+		ok &= check("affine3 * affine3", composeError, 0);
+		ok &= check("transformPoint", pointError, 0);
+
+		// Timing
+		cout << "  " << left << setw(24) << "" << right << setw(12) << "mat4" << setw(12) << "affine3" << endl;
+		report("compose",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) mr[i] = ma[i] * mb[i]; g_sink = mr[n - 1][0][0]; }),
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) ar[i] = aa[i] * ab[i]; g_sink = ar[n - 1].row(0).x; }));
+		report("transform point",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) rp[i] = vec3(ma[i] * vec4(p[i], 1)); g_sink = rp[n - 1].x; }),
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) rp[i] = transformPoint(aa[i], p[i]); g_sink = rp[n - 1].x; }));
+		cout << "  " << left << setw(24) << "bytes per transform" << right
+			<< setw(12) << sizeof(mat4) << setw(12) << sizeof(affine3) << endl;
+
+		return ok;
+	}
+
+
+	// Structure of arrays kernels against vec3 one at a time
+	//
+	bool benchSoA() {
+		// not a multiple of four, so the remainder is exercised
+		const size_t n = 100003;
+		vector<vec3> a(n), b(n), r(n);
+		vector<float> rd(n), sd(n);
+		for (size_t i = 0; i < n; i++) {
+			a[i] = vec3::random(-1, 1);
+			b[i] = vec3::random(-1, 1);
+		}
+		vec3 angles = vec3::random(-3, 3);
+		affine3 t(mat4::translate(vec3::random(-10, 10))
+			* mat4::rotateZ(angles.z) * mat4::rotateY(angles.y) * mat4::rotateX(angles.x));
+		vec3_soa sa(a), sb(b), sr(n);
+
+		// Equivalence, for every count up to a few blocks and the full arrays
+		double pointError = 0, vectorError = 0, normalizeError = 0, dotError = 0, crossError = 0, mixError = 0;
+		auto compare = [&](size_t count, double &error) {
+			for (size_t i = 0; i < count; i++) {
+				vec3 v = sr.get(i);
+				for (int j = 0; j < 3; j++) error = max(error, double(ulps(r[i][j], v[j])));
+			}
+		};
+		vector<size_t> counts { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, n };
+		for (size_t count : counts) {
+			const_vec3_span ca(sa.x(), sa.y(), sa.z(), count), cb(sb.x(), sb.y(), sb.z(), count);
+
+			transformPoints(t, ca, sr);
+			for (size_t i = 0; i < count; i++) r[i] = transformPoint(t, a[i]);
+			compare(count, pointError);
+
+			transformVectors(t, ca, sr);
+			for (size_t i = 0; i < count; i++) r[i] = transformVector(t, a[i]);
+			compare(count, vectorError);
+
+			normalize(ca, sr);
+			for (size_t i = 0; i < count; i++) r[i] = normalize(a[i]);
+			compare(count, normalizeError);
+
+			cross(ca, cb, sr);
+			for (size_t i = 0; i < count; i++) r[i] = cross(a[i], b[i]);
+			compare(count, crossError);
+
+			mix(ca, cb, 0.3f, sr);
+			for (size_t i = 0; i < count; i++) r[i] = mix(a[i], b[i], 0.3f);
+			compare(count, mixError);
+
+			dot(ca, cb, sd.data());
+			for (size_t i = 0; i < count; i++) dotError = max(dotError, double(ulps(dot(a[i], b[i]), sd[i])));
+		}
+
+		bool ok = true;
+		ok &= check("transformPoints", pointError, 0);
+		ok &= check("transformVectors", vectorError, 0);
+		ok &= check("normalize", normalizeError, 0);
+		ok &= check("dot", dotError, 0);
+		ok &= check("cross", crossError, 0);
+		ok &= check("mix", mixError, 0);
+
+		// Throughput
+		cout << "  " << left << setw(24) << "" << right << setw(13) << "vec3" << setw(12) << "soa" << endl;
+		reportThroughput("transformPoints",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = transformPoint(t, a[i]); g_sink = r[n - 1].x; }, 7, 10),
+			timePerItem(n, [&] { transformPoints(t, sa, sr); g_sink = sr.x()[n - 1]; }, 7, 10));
+		reportThroughput("transformVectors",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = transformVector(t, a[i]); g_sink = r[n - 1].x; }, 7, 10),
+			timePerItem(n, [&] { transformVectors(t, sa, sr); g_sink = sr.x()[n - 1]; }, 7, 10));
+		reportThroughput("normalize",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = normalize(a[i]); g_sink = r[n - 1].x; }, 7, 10),
+			timePerItem(n, [&] { normalize(sa, sr); g_sink = sr.x()[n - 1]; }, 7, 10));
+		reportThroughput("dot",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) rd[i] = dot(a[i], b[i]); g_sink = rd[n - 1]; }, 7, 10),
+			timePerItem(n, [&] { dot(sa, sb, sd.data()); g_sink = sd[n - 1]; }, 7, 10));
+		reportThroughput("cross",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = cross(a[i], b[i]); g_sink = r[n - 1].x; }, 7, 10),
+			timePerItem(n, [&] { cross(sa, sb, sr); g_sink = sr.x()[n - 1]; }, 7, 10));
+		reportThroughput("mix",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = mix(a[i], b[i], 0.3f); g_sink = r[n - 1].x; }, 7, 10),
+			timePerItem(n, [&] { mix(sa, sb, 0.3f, sr); g_sink = sr.x()[n - 1]; }, 7, 10));
+
+		return ok;
+	}
+
+
+	// Degree/radian conversion in float against the old conversion through double
+	//
+	float radiansThroughDouble(float val) {
+		return float(val * 3.1415926535897932384626433832795 / 180.0);
+	}
+
+	float degreesThroughDouble(float val) {
+		return float(val / 3.1415926535897932384626433832795 * 180.0);
+	}
+
+	bool benchAngles() {
+		// every joint angle of a few seconds of a 31 bone skeleton
+		const size_t n = 31 * 3 * 1024;
+		vector<float> angles(n), r(n);
+		for (size_t i = 0; i < n; i++) angles[i] = math::random<float>(-180, 180);
+
+		// Equivalence
+		double radiansError = 0, degreesError = 0;
+		for (size_t i = 0; i < n; i++) {
+			radiansError = max(radiansError, double(ulps(radiansThroughDouble(angles[i]), radians(angles[i]))));
+			degreesError = max(degreesError, double(ulps(degreesThroughDouble(angles[i]), degrees(angles[i]))));
+		}
+
+		bool ok = true;
+		ok &= check("radians", radiansError, 2);
+		ok &= check("degrees", degreesError, 2);
+
+		// Timing
+		cout << "  " << left << setw(24) << "" << right << setw(12) << "double" << setw(12) << "float" << endl;
+		report("radians",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = radiansThroughDouble(angles[i]); g_sink = r[n - 1]; }, 7, 20),
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = radians(angles[i]); g_sink = r[n - 1]; }, 7, 20));
+		report("degrees",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = degreesThroughDouble(angles[i]); g_sink = r[n - 1]; }, 7, 20),
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = degrees(angles[i]); g_sink = r[n - 1]; }, 7, 20));
+
+		return ok;
+	}
+
+
+	// Batched quaternion kernels against the quat functions, and the
+	// approximate slerp against slerp
+	//
+	bool benchQuat() {
+		// not a multiple of four, so the remainder is exercised
+		const size_t n = 100003;
+		vector<quat> a(n), b(n), r(n);
+		vector<vec3> v(n), rv(n);
+		for (size_t i = 0; i < n; i++) {
+			a[i] = quat::random();
+			b[i] = quat::random();
+			v[i] = vec3::random(-1, 1);
+		}
+		quat_soa sa(a), sb(b), sr(n);
+		vec3_soa sv(v), srv(n);
+		const float t = 0.3f;
+
+		// Equivalence, for every count up to a few blocks and the full arrays
+		double multiplyError = 0, normalizeError = 0, rotateError = 0, nlerpError = 0, slerpError = 0;
+		auto compare = [&](size_t count, double &error) {
+			for (size_t i = 0; i < count; i++) {
+				quat q = sr.get(i);
+				for (int j = 0; j < 4; j++) error = max(error, double(ulps(r[i][j], q[j])));
+			}
+		};
+		vector<size_t> counts { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, n };
+		for (size_t count : counts) {
+			const_quat_span ca(sa.w(), sa.x(), sa.y(), sa.z(), count), cb(sb.w(), sb.x(), sb.y(), sb.z(), count);
+
+			multiply(ca, cb, sr);
+			for (size_t i = 0; i < count; i++) r[i] = a[i] * b[i];
+			compare(count, multiplyError);
+
+			normalize(ca, sr);
+			for (size_t i = 0; i < count; i++) r[i] = normalize(a[i]);
+			compare(count, normalizeError);
+
+			nlerp(ca, cb, t, sr);
+			for (size_t i = 0; i < count; i++) r[i] = nlerp(a[i], b[i], t);
+			compare(count, nlerpError);
+
+			slerpApprox(ca, cb, t, sr);
+			for (size_t i = 0; i < count; i++) r[i] = slerpApprox(a[i], b[i], t);
+			compare(count, slerpError);
+
+			rotate(ca, sv, srv);
+			for (size_t i = 0; i < count; i++) {
+				vec3 u = rotate(a[i], v[i]), w = srv.get(i);
+				for (int j = 0; j < 3; j++) rotateError = max(rotateError, double(ulps(u[j], w[j])));
+			}
+		}
+
+		// Accuracy of the fast paths, in absolute error of the components
+		double approxError = 0, matrixError = 0;
+		for (size_t i = 0; i < n; i++) {
+			float s = i / float(n - 1);
+			quat e = slerp(a[i], b[i], s), f = slerpApprox(a[i], b[i], s);
+			for (int j = 0; j < 4; j++) approxError = max(approxError, double(abs(e[j] - f[j])));
+			vec3 m = mat3(a[i]) * v[i], q = rotate(a[i], v[i]);
+			for (int j = 0; j < 3; j++) matrixError = max(matrixError, double(abs(m[j] - q[j])));
+		}
+
+		bool ok = true;
+		ok &= check("multiply", multiplyError, 0);
+		ok &= check("normalize", normalizeError, 0);
+		ok &= check("rotate", rotateError, 0);
+		ok &= check("nlerp", nlerpError, 0);
+		ok &= check("slerpApprox", slerpError, 0);
+		ok &= check("slerpApprox / slerp", approxError, 4e-5);
+		ok &= check("rotate / mat3", matrixError, 1e-5);
+
+		// Throughput
+		cout << "  " << left << setw(24) << "" << right << setw(13) << "quat" << setw(12) << "soa" << endl;
+		reportThroughput("multiply",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = a[i] * b[i]; g_sink = r[n - 1].x; }, 7, 10),
+			timePerItem(n, [&] { multiply(sa, sb, sr); g_sink = sr.x()[n - 1]; }, 7, 10));
+		reportThroughput("normalize",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = normalize(a[i]); g_sink = r[n - 1].x; }, 7, 10),
+			timePerItem(n, [&] { normalize(sa, sr); g_sink = sr.x()[n - 1]; }, 7, 10));
+		reportThroughput("rotate",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) rv[i] = rotate(a[i], v[i]); g_sink = rv[n - 1].x; }, 7, 10),
+			timePerItem(n, [&] { rotate(sa, sv, srv); g_sink = srv.x()[n - 1]; }, 7, 10));
+		reportThroughput("nlerp",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = nlerp(a[i], b[i], t); g_sink = r[n - 1].x; }, 7, 10),
+			timePerItem(n, [&] { nlerp(sa, sb, t, sr); g_sink = sr.x()[n - 1]; }, 7, 10));
+		reportThroughput("slerp / batched approx",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = slerp(a[i], b[i], t); g_sink = r[n - 1].x; }, 7, 10),
+			timePerItem(n, [&] { slerpApprox(sa, sb, t, sr); g_sink = sr.x()[n - 1]; }, 7, 10));
+
+		cout << "  " << left << setw(24) << "" << right << setw(12) << "slerp" << setw(12) << "approx" << endl;
+		report("slerp",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = slerp(a[i], b[i], t); g_sink = r[n - 1].x; }, 7, 10),
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = slerpApprox(a[i], b[i], t); g_sink = r[n - 1].x; }, 7, 10));
+
+		return ok;
+	}
+
+
+	// Dual quaternion skinning against linear blend skinning, on random
+	// meshes bound to as many joints as priman has
+	//
+	bool benchSkinning() {
+		const size_t jointCount = 31;
+		vector<affine3> matrices(jointCount);
+		vector<dualquat> dualquats(jointCount);
+		for (size_t j = 0; j < jointCount; j++) {
+			dualquats[j] = dualquat(quat::random(), vec3::random(-10, 10));
+			matrices[j] = affine3(dualquats[j]);
+		}
+
+		auto randomMesh = [&](size_t n, vec3_soa &mesh, skin_influences &influences) {
+			mesh.resize(n);
+			influences.resize(n);
+			for (size_t i = 0; i < n; i++) {
+				mesh.set(i, vec3::random(-1, 1));
+				float w[skin_influences::slots], sum = 0;
+				for (int k = 0; k < skin_influences::slots; k++) sum += w[k] = math::random<float>(0, 1);
+				for (int k = 0; k < skin_influences::slots; k++) {
+					influences.joint[k][i] = uint16_t(math::random<int>(0, jointCount - 1));
+					influences.weight[k][i] = w[k] / sum;
+				}
+			}
+		};
+
+		// Equivalence with the single vertex versions, for every count up to
+		// a few blocks and across several chunks on several threads
+		double linearError = 0, dualQuatError = 0;
+		vector<size_t> counts { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 100003 };
+		for (size_t count : counts) {
+			vec3_soa mesh, skinned(count);
+			skin_influences influences;
+			randomMesh(count, mesh, influences);
+
+			Skinning::linearBlend(matrices, influences, mesh, skinned, 4);
+			for (size_t i = 0; i < count; i++) {
+				vec3 p = Skinning::linearBlend(matrices, influences, i, mesh.get(i)), q = skinned.get(i);
+				for (int j = 0; j < 3; j++) linearError = max(linearError, double(ulps(p[j], q[j])));
+			}
+
+			Skinning::dualQuaternion(dualquats, influences, mesh, skinned, 4);
+			for (size_t i = 0; i < count; i++) {
+				vec3 p = Skinning::dualQuaternion(dualquats, influences, i, mesh.get(i)), q = skinned.get(i);
+				for (int j = 0; j < 3; j++) dualQuatError = max(dualQuatError, double(ulps(p[j], q[j])));
+			}
+		}
+
+		// With one joint per vertex both are the joint's rigid transform
+		double rigidError = 0;
+		{
+			const size_t n = 1024;
+			vec3_soa mesh, lbs(n), dqs(n);
+			skin_influences influences;
+			randomMesh(n, mesh, influences);
+			for (size_t i = 0; i < n; i++) {
+				influences.weight[0][i] = 1;
+				for (int k = 1; k < skin_influences::slots; k++) influences.weight[k][i] = 0;
+			}
+			Skinning::linearBlend(matrices, influences, mesh, lbs);
+			Skinning::dualQuaternion(dualquats, influences, mesh, dqs);
+			for (size_t i = 0; i < n; i++) {
+				for (int j = 0; j < 3; j++) rigidError = max(rigidError, double(abs(lbs.get(i)[j] - dqs.get(i)[j])));
+			}
+		}
+
+		bool ok = true;
+		ok &= check("linearBlend", linearError, 0);
+		ok &= check("dualQuaternion", dualQuatError, 0);
+		ok &= check("single joint lbs / dqs", rigidError, 1e-4);
+
+		// Threaded skinning reuses the worker pool, so it does not allocate
+		if (allocTrackingEnabled()) {
+			const size_t n = 100000;
+			vec3_soa mesh, skinned(n);
+			skin_influences influences;
+			randomMesh(n, mesh, influences);
+			Skinning::linearBlend(matrices, influences, mesh, skinned, 4);
+			alloc_counts before = allocCounts();
+			for (int i = 0; i < 10; i++) Skinning::linearBlend(matrices, influences, mesh, skinned, 4);
+			ok &= check("allocations", double((allocCounts() - before).allocations), 0);
+		}
+
+		// Throughput, on one thread and on every hardware thread
+		cout << "  " << left << setw(24) << "" << right << setw(13) << "lbs" << setw(12) << "dqs" << endl;
+		for (size_t n : { size_t(10000), size_t(100000), size_t(1000000) }) {
+			vec3_soa mesh, skinned(n);
+			skin_influences influences;
+			randomMesh(n, mesh, influences);
+			int calls = int(max<size_t>(1, 2000000 / n));
+			for (unsigned threads : { 1u, 0u }) {
+				ostringstream name;
+				name << n << " verts, " << (threads == 1 ? "1 thread" : "threads");
+				reportThroughput(name.str(),
+					timePerItem(n, [&] { Skinning::linearBlend(matrices, influences, mesh, skinned, threads); g_sink = skinned.x()[n - 1]; }, 7, calls),
+					timePerItem(n, [&] { Skinning::dualQuaternion(dualquats, influences, mesh, skinned, threads); g_sink = skinned.x()[n - 1]; }, 7, calls));
+			}
+		}
+		cout << "  bytes per joint: affine3 " << sizeof(affine3) << ", dualquat " << sizeof(dualquat) << endl;
+
+		return ok;
+	}
+
+
+	// The per-thread xoshiro stream against the shared standard engine the
+	// math::random helpers used to draw from
+	//
+	float randomThroughStandard(float lower, float upper) {
+		static std::default_random_engine re { 5489u };
+		return float(std::uniform_real_distribution<double>(lower, upper)(re));
+	}
+
+	bool benchRandom() {
+		const size_t n = 1 << 20;
+		vector<float> r(n);
+		vector<vec3> rv(n / 4);
+		vector<quat> rq(n / 4);
+
+		// The same seed and stream repeat, different streams do not
+		math::random_stream a(42, 0), b(42, 0), c(42, 1);
+		size_t repeats = 0, overlaps = 0;
+		for (int i = 0; i < 1000; i++) {
+			uint64_t x = a(), y = b(), z = c();
+			repeats += (x == y);
+			overlaps += (x == z);
+		}
+
+		// Range and mean of the scalar draws and bulk fill
+		math::random_stream rs(7);
+		double rangeError = 0, sum = 0;
+		for (size_t i = 0; i < n; i++) {
+			float f = rs.uniform<float>(-1, 1);
+			if (f < -1 || f >= 1) rangeError++;
+			sum += f;
+		}
+		rs.fill(r.data(), n, -1, 1);
+		for (float f : r) {
+			if (f < -1 || f >= 1) rangeError++;
+			sum += f;
+		}
+
+		randomRotations(rq.data(), rq.size(), rs);
+		double unitError = 0;
+		for (const quat &q : rq) unitError = max(unitError, double(abs(length(q) - 1)));
+
+		bool ok = true;
+		ok &= check("seeded stream repeats", double(1000 - repeats), 0);
+		ok &= check("streams do not overlap", double(overlaps), 0);
+		ok &= check("values out of range", rangeError, 0);
+		ok &= check("mean of 2M in [-1, 1)", abs(sum / (2 * n)), 2e-3);
+		ok &= check("unit rotations", unitError, 1e-6);
+
+		// Timing
+		cout << "  " << left << setw(24) << "" << right << setw(12) << "standard" << setw(12) << "xoshiro" << endl;
+		report("float",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = randomThroughStandard(-1, 1); g_sink = r[n - 1]; }, 7, 2),
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = math::random<float>(-1, 1); g_sink = r[n - 1]; }, 7, 2));
+		report("float, bulk fill",
+			timePerItem(n, [&] { for (size_t i = 0; i < n; i++) r[i] = randomThroughStandard(-1, 1); g_sink = r[n - 1]; }, 7, 2),
+			timePerItem(n, [&] { math::threadStream().fill(r.data(), n, -1, 1); g_sink = r[n - 1]; }, 7, 2));
+		report("vec3, bulk fill",
+			timePerItem(rv.size(), [&] {
+				for (vec3 &v : rv) {
+					float x = randomThroughStandard(-1, 1), y = randomThroughStandard(-1, 1), z = randomThroughStandard(-1, 1);
+					v = vec3(x, y, z);
+				}
+				g_sink = rv.back().x;
+			}, 7, 2),
+			timePerItem(rv.size(), [&] { math::threadStream().fill(rv.data(), rv.size(), -1, 1); g_sink = rv.back().x; }, 7, 2));
+		report("mat4::random",
+			timePerItem(n / 16, [&] {
+				for (size_t i = 0; i < n / 16; i++) {
+					float m[16];
+					for (float &e : m) e = randomThroughStandard(-1, 1);
+					g_sink = m[15];
+				}
+			}, 7, 2),
+			timePerItem(n / 16, [&] { for (size_t i = 0; i < n / 16; i++) g_sink = mat4::random(-1, 1)[3][3]; }, 7, 2));
+
+		return ok;
+	}
+
+
+	// Joint sampling and evaluation with the kernels specialized for each
+	// dof group against the generic versions that branch on every channel
+	//
+	bool benchDof() {
+		Skeleton skeleton(CGRA_SRCDIR "/res/assets/priman.asf");
+		skeleton.readAMC(CGRA_SRCDIR "/res/assets/walking.amc");
+		const size_t bones = skeleton.bones().size();
+
+		cout << "  dof groups:";
+		for (const dof_group &g : skeleton.dofGroups()) {
+			cout << " " << (g.freedom & dof_root ? "root" : "")
+				<< (g.freedom & dof_rx ? "x" : "") << (g.freedom & dof_ry ? "y" : "") << (g.freedom & dof_rz ? "z" : "")
+				<< (g.freedom == dof_none ? "none" : "") << "(" << g.bones.size() << ")";
+		}
+		cout << endl;
+
+		// Equivalence over every frame, at a fraction between frames
+		pose generic, specialized;
+		vector<affine3> genericWorld, specializedWorld;
+		double sampleError = 0, evaluateError = 0;
+		for (int f = 0; f < skeleton.frameCount(); f++) {
+			skeleton.samplePoseGeneric(f + 0.3f, generic);
+			skeleton.samplePose(f + 0.3f, specialized);
+			for (size_t i = 0; i < bones; i++) {
+				for (int j = 0; j < 3; j++) sampleError = max(sampleError, double(ulps(generic.rotation[i][j], specialized.rotation[i][j])));
+			}
+			for (int j = 0; j < 3; j++) sampleError = max(sampleError, double(ulps(generic.translation[j], specialized.translation[j])));
+
+			skeleton.evaluatePoseGeneric(generic, genericWorld);
+			skeleton.evaluatePose(generic, specializedWorld);
+			for (size_t i = 0; i < bones; i++) {
+				evaluateError = max(evaluateError, matrixUlps(mat4(genericWorld[i]), mat4(specializedWorld[i])));
+			}
+		}
+
+		bool ok = true;
+		ok &= check("samplePose", sampleError, 0);
+		ok &= check("evaluatePose", evaluateError, 16);
+
+		// Timing, per bone
+		const int frames = skeleton.frameCount();
+		int frame = 0;
+		cout << "  " << left << setw(24) << "" << right << setw(12) << "generic" << setw(12) << "dof groups" << endl;
+		report("samplePose",
+			timePerItem(bones, [&] { skeleton.samplePoseGeneric(float(frame++ % frames) + 0.3f, generic); g_sink = generic.rotation[1].x; }, 7, 2000),
+			timePerItem(bones, [&] { skeleton.samplePose(float(frame++ % frames) + 0.3f, specialized); g_sink = specialized.rotation[1].x; }, 7, 2000));
+		report("evaluatePose",
+			timePerItem(bones, [&] { skeleton.evaluatePoseGeneric(generic, genericWorld); g_sink = genericWorld[1].row(0).x; }, 7, 2000),
+			timePerItem(bones, [&] { skeleton.evaluatePose(generic, specializedWorld); g_sink = specializedWorld[1].row(0).x; }, 7, 2000));
+
+		return ok;
+	}
+
+
+	// Cost of recording a trace event, with tracing off and on
+	//
+	bool benchTrace() {
+#ifndef CGRA_PROFILER
+		cout << "  tracing not compiled in (CGRA_PROFILER off)" << endl;
+		return true;
+#else
+		trace_recorder &recorder = traceRecorder();
+		bool enabled = recorder.enabled();
+		const int runs = 7, calls = 50000;
+
+		recorder.setEnabled(false);
+		double off = timePerItem(2, [&] { recorder.begin("bench"); recorder.end("bench"); }, runs, calls);
+
+		recorder.setEnabled(true);
+		size_t before = recorder.eventCount();
+		double on = timePerItem(2, [&] { recorder.begin("bench"); recorder.end("bench"); }, runs, calls);
+		double recorded = double(recorder.eventCount() - before);
+		recorder.setEnabled(enabled);
+
+		ios::fmtflags flags = cout.flags();
+		cout << "  " << left << setw(24) << "ns per event" << right << fixed << setprecision(2)
+			<< setw(9) << off << " off" << setw(9) << on << " on" << endl;
+		cout.flags(flags);
+
+		bool ok = true;
+		ok &= check("events recorded", abs(recorded - 2.0 * runs * calls), 0);
+		return ok;
+#endif
+	}
+
+
+	// Heap allocations while playing walking.amc. After warming up, a frame
+	// of the main loop (clock, animator hand-off and profiler) must not
+	// allocate. Drawing needs a GL context and is not covered here.
+	//
+	bool benchAlloc() {
+		if (!allocTrackingEnabled()) {
+			cout << "  allocation tracking not compiled in (CGRA_ALLOC_TRACKING off)" << endl;
+			return true;
+		}
+
+		Skeleton skeleton(CGRA_SRCDIR "/res/assets/priman.asf");
+		skeleton.readAMC(CGRA_SRCDIR "/res/assets/walking.amc");
+		AnimationClock clock;
+		clock.setLength(skeleton.frameCount());
+		clock.play();
+		Animator animator(&skeleton);
+
+#ifdef CGRA_PROFILER
+		// Trace events are kept in chunks allocated as they fill up
+		bool tracing = traceRecorder().enabled();
+		traceRecorder().setEnabled(false);
+#endif
+
+		// At 60 Hz, waiting for every pose so the animator runs each frame
+		double time = 0;
+		auto frame = [&] {
+			advanceFrameArenas();
+			CGRA_PROFILE_FRAME_BEGIN();
+			{
+				CGRA_PROFILE_SCOPE("Frame");
+				time += 1.0 / 60;
+				clock.update(time);
+				animator.request(float(clock.frame()));
+				while (!animator.acquire()) this_thread::yield();
+
+				// Transient per-frame data, as the renderer's instance lists
+				const vector<affine3> &world = animator.current().world;
+				arena_vector<vec3> joints;
+				for (const affine3 &w : world) joints.push_back(w.translation());
+				g_sink = joints.back().x;
+			}
+			CGRA_PROFILE_FRAME_END();
+		};
+
+		const int frames = max(skeleton.frameCount(), 300);
+		alloc_counts start = allocCounts();
+		for (int i = 0; i < frames; i++) frame();
+		alloc_counts warmup = allocCounts() - start;
+
+		unsigned long long worst = 0;
+		alloc_counts steady = allocCounts();
+		for (int i = 0; i < frames; i++) {
+			alloc_counts before = allocCounts();
+			frame();
+			worst = max(worst, (allocCounts() - before).allocations);
+		}
+		steady = allocCounts() - steady;
+
+#ifdef CGRA_PROFILER
+		traceRecorder().setEnabled(tracing);
+#endif
+
+		cout << "  " << frames << " frames warming up: " << warmup.allocations << " allocations, "
+			<< warmup.bytes << " bytes" << endl;
+		cout << "  " << frames << " frames steady: " << steady.allocations << " allocations, "
+			<< steady.bytes << " bytes" << endl;
+		return check("allocations per frame", double(worst), 0);
+	}
+
+
+	// Frame arena allocation against the heap, and the guarantees the
+	// callers rely on: alignment, memory living through the next frame,
+	// and overflow going to the heap
+	//
+	bool benchArena() {
+		bool ok = true;
+
+		// Alignment of typed and container allocations
+		frame_arena arena(64 * 1024);
+		size_t misaligned = 0;
+		for (size_t n = 1; n < 64; n++) {
+			misaligned += reinterpret_cast<uintptr_t>(arena.alloc<float>(n)) % frame_arena::alignment != 0;
+		}
+		arena_vector<vec3> points { arena_allocator<vec3>(arena) };
+		for (int i = 0; i < 100; i++) points.push_back(vec3(float(i)));
+		misaligned += reinterpret_cast<uintptr_t>(points.data()) % frame_arena::alignment != 0;
+		ok &= check("misaligned", double(misaligned), 0);
+
+		// Overflow falls back to the heap until the next reset
+		arena.reset();
+		mat4 *big = arena.alloc<mat4>(2048);
+		big[2047] = mat4();
+		arena.reset();
+		ok &= check("overflows", abs(double(arena.statistics().overflows) - 1), 0);
+
+		// Memory allocated in one frame survives the next and is reused after
+		advanceFrameArenas();
+		int *first = frameArena().alloc<int>(16);
+		for (int i = 0; i < 16; i++) first[i] = i;
+		advanceFrameArenas();
+		int *second = frameArena().alloc<int>(16);
+		for (int i = 0; i < 16; i++) second[i] = -1;
+		double clobbered = 0;
+		for (int i = 0; i < 16; i++) clobbered += first[i] != i;
+		advanceFrameArenas();
+		ok &= check("kept for a frame", clobbered, 0);
+		ok &= check("reused after two", double(frameArena().alloc<int>(16) != first), 0);
+
+		// Timing, a few small matrix arrays per "frame"
+		cout << "  " << left << setw(24) << "" << right << setw(12) << "heap" << setw(12) << "arena" << endl;
+		const int batch = 64;
+		mat4 *heap[batch];
+		report("alloc mat4[4]",
+			timePerItem(batch, [&] {
+				for (mat4 *&m : heap) m = new mat4[4];
+				g_sink = (*heap[batch - 1])[0][0];
+				for (mat4 *m : heap) delete[] m;
+			}),
+			timePerItem(batch, [&] {
+				mat4 *m = nullptr;
+				for (int i = 0; i < batch; i++) {
+					m = arena.alloc<mat4>(4);
+					for (int j = 0; j < 4; j++) m[j] = mat4();
+				}
+				g_sink = (*m)[0][0];
+				arena.reset();
+			}));
+
+		return ok;
+	}
+
+
+	struct benchmark_entry {
+		const char *name;
+		bool (*run)();
+	};
+
+	const benchmark_entry benchmarks[] = {
+		{ "math", benchMath },
+		{ "inverse", benchInverse },
+		{ "affine", benchAffine },
+		{ "soa", benchSoA },
+		{ "angles", benchAngles },
+		{ "quat", benchQuat },
+		{ "skinning", benchSkinning },
+		{ "random", benchRandom },
+		{ "dof", benchDof },
+		{ "trace", benchTrace },
+		{ "alloc", benchAlloc },
+		{ "arena", benchArena },
+	};
+}
+
+
+bool Benchmark::run(const string &name) {
+	bool ok = true, found = false;
+	for (const benchmark_entry &b : benchmarks) {
+		if (!name.empty() && name != b.name) continue;
+		found = true;
+		cout << b.name << endl;
+		CGRA_PROFILE_SCOPE(b.name);
+		ok &= b.run();
+	}
+	if (!found) {
+		cerr << "Error: no benchmark named " << name << endl;
+		return false;
+	}
+	return ok;
+}
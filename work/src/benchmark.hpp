@@ -0,0 +1,28 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <string>
+
+
+// Microbenchmarks of the hot paths, each checking that the optimized code
+// gives the same results as the code it replaces. Run from the command
+// line with --bench [name] instead of opening the viewer.
+namespace Benchmark {
+
+	// Runs the named benchmark, or all of them if no name is given,
+	// returns false if any check failed
+	bool run(const std::string &name = "");
+}
@@ -14,52 +14,152 @@
 
 #pragma once
 
+#include <map>
+#include <utility>
+#include <vector>
+
 #include "cgra_math.hpp"
 #include "opengl.hpp"
 
 namespace cgra {
 
-	void cgraSphere(float radius, int slices=10, int stacks=10, bool wire=false) {
-		assert(slices > 0 && stacks > 0 && radius > 0);
-		int dualslices = slices * 2;
+	namespace detail {
+
+		// sin/cos values for the range of phi, shared by every primitive
+		// that uses the same number of (dual) slices
+		struct trig_table {
+			std::vector<float> sin_phi;
+			std::vector<float> cos_phi;
+		};
+
+		// Tables are built lazily on first use and never freed.
+		// Not thread safe, only call from the thread that owns the GL context.
+		inline const trig_table & trigTable(int dualslices) {
+			static std::map<int, trig_table> tables;
+
+			auto it = tables.find(dualslices);
+			if (it != tables.end()) return it->second;
 
-		// precompute sin/cos values for the range of phi
-		std::vector<float> sin_phi_vector;
-		std::vector<float> cos_phi_vector;
+			trig_table &t = tables[dualslices];
+			t.sin_phi.reserve(dualslices + 1);
+			t.cos_phi.reserve(dualslices + 1);
+			for (int slice_count = 0; slice_count <= dualslices; ++slice_count) {
+				float phi = 2 * math::pi<float>() * float(slice_count)/dualslices;
+				t.sin_phi.push_back(std::sin(phi));
+				t.cos_phi.push_back(std::cos(phi));
+			}
+			return t;
+		}
 
-		for (int slice_count = 0; slice_count <= dualslices; ++slice_count) {
-			float phi = 2 * math::pi() * float(slice_count)/dualslices;
-			sin_phi_vector.push_back(std::sin(phi));
-			cos_phi_vector.push_back(std::cos(phi));
+		// normalized coordinates of a unit sphere (also its normals),
+		// cached per slices/stacks pair
+		inline const std::vector<vec3> & unitSphere(int slices, int stacks) {
+			static std::map<std::pair<int, int>, std::vector<vec3>> spheres;
+
+			auto key = std::make_pair(slices, stacks);
+			auto it = spheres.find(key);
+			if (it != spheres.end()) return it->second;
+
+			int dualslices = slices * 2;
+			const trig_table &t = trigTable(dualslices);
+
+			std::vector<vec3> &verts = spheres[key];
+			verts.reserve((stacks + 1) * (dualslices + 1));
+			for (int stack_count = 0; stack_count <= stacks; ++stack_count) {
+				float theta = math::pi<float>() * float(stack_count)/stacks;
+				float sin_theta = std::sin(theta);
+				float cos_theta = std::cos(theta);
+
+				for (int slice_count = 0; slice_count <= dualslices; ++slice_count) {
+					verts.push_back(vec3(
+						sin_theta*t.cos_phi[slice_count],
+						sin_theta*t.sin_phi[slice_count],
+						cos_theta));
+				}
+			}
+			return verts;
 		}
+	}
+
+	// Tessellation levels picked from by the LOD variants below,
+	// as {slices, stacks}, coarsest first
+	const int tessellation_levels[][2] = {
+		{ 3, 2 },
+		{ 5, 4 },
+		{ 10, 10 },
+		{ 16, 14 },
+		{ 24, 20 }
+	};
+
+	const int tessellation_level_count = sizeof(tessellation_levels) / sizeof(tessellation_levels[0]);
+
+	// Running count of vertices submitted by the primitives in this file,
+	// reset it at the start of a frame to measure that frame
+	inline unsigned long & cgraVertexCount() {
+		static unsigned long count = 0;
+		return count;
+	}
 
+	// The parts of the projection and viewport the LOD variants need, set
+	// once per pass (eg. with the camera) rather than read back from GL for
+	// every primitive. Only use from the thread that owns the GL context.
+	struct lod_projection {
+		float pixelScale = 1; // projection[1][1] * viewport height / 2
+		float wz = 0;         // clip w = wz * eye z + w1 (-1, 0 for a perspective projection)
+		float w1 = 1;
+	};
+
+	inline lod_projection & lodProjection() {
+		static lod_projection p;
+		return p;
+	}
 
-		// precompute the normalized coordinates of sphere
-		std::vector<vec3> verts;
+	inline void setLodProjection(const mat4 &projection, int viewportHeight) {
+		lod_projection &p = lodProjection();
+		p.pixelScale = projection[1][1] * viewportHeight * 0.5f;
+		p.wz = projection[2][3];
+		p.w1 = projection[3][3];
+	}
 
-		for (int stack_count = 0; stack_count <= stacks; ++stack_count) {
-			float theta = math::pi() * float(stack_count)/stacks;
-			float sin_theta = std::sin(theta);
-			float cos_theta = std::cos(theta);
+	// Radius in pixels of a sphere of the given radius, centered at the
+	// origin of the given modelview matrix
+	inline float projectedRadius(float radius, const mat4 &modelview) {
+		const lod_projection &p = lodProjection();
 
-			for (int slice_count = 0; slice_count <= dualslices; ++slice_count) {
+		// account for any scale in the modelview
+		float scale = length(vec3(modelview[0][0], modelview[0][1], modelview[0][2]));
+		float r = radius * scale * p.pixelScale;
 
+		// perspective divide (w is -z for a perspective projection, 1 for orthographic)
+		float w = p.wz * modelview[3][2] + p.w1;
+		return r / std::max(std::abs(w), 1e-6f);
+	}
 
-				verts.push_back(vec3(
-					sin_theta*cos_phi_vector[slice_count],
-					sin_theta*sin_phi_vector[slice_count],
-					cos_theta));
-			}
-		}
+	// Index into tessellation_levels for a primitive covering the given
+	// radius in pixels
+	inline int tessellationLevel(float pixel_radius) {
+		if (pixel_radius < 2) return 0;
+		if (pixel_radius < 8) return 1;
+		if (pixel_radius < 32) return 2;
+		if (pixel_radius < 128) return 3;
+		return tessellation_level_count - 1;
+	}
+
+	inline void cgraSphere(float radius, int slices=10, int stacks=10, bool wire=false) {
+		assert(slices > 0 && stacks > 0 && radius > 0);
+		int dualslices = slices * 2;
+
+		const std::vector<vec3> &verts = detail::unitSphere(slices, stacks);
+		cgraVertexCount() += stacks * (dualslices+1) * 2;
 
 		// use triangle strips to display each stack of the sphere
 		for (int stack_count = 0; stack_count < stacks; ++stack_count) {
 			glBegin(GL_TRIANGLE_STRIP);
 
 			for (int slice_count = 0; slice_count <= dualslices; ++slice_count) {
-				
-				vec3 &h = verts[slice_count + stack_count*(dualslices+1)];
-				vec3 &l = verts[slice_count + (stack_count+1)*(dualslices+1)];
+
+				const vec3 &h = verts[slice_count + stack_count*(dualslices+1)];
+				const vec3 &l = verts[slice_count + (stack_count+1)*(dualslices+1)];
 
 				vec3 ph = h*radius;
 				vec3 pl = l*radius;
@@ -75,66 +175,38 @@ namespace cgra {
 		}
 	}
 
-	void cgraCylinder(float base_radius, float top_radius, float height, int slices=10, int stacks=10, bool wire=false) {
+	inline void cgraCylinder(float base_radius, float top_radius, float height, int slices=10, int stacks=10, bool wire=false) {
 		assert(slices > 0 && stacks > 0 && (base_radius > 0 || base_radius > 0) && height > 0);
 		int dualslices = slices * 2;
 
-		// precompute sin/cos values for the range of phi
-		std::vector<float> sin_phi_vector;
-		std::vector<float> cos_phi_vector;
-
-		for (int slice_count = 0; slice_count <= dualslices; ++slice_count) {
-			float phi = 2 * math::pi() * float(slice_count)/dualslices;
-			sin_phi_vector.push_back(std::sin(phi));
-			cos_phi_vector.push_back(std::cos(phi));
-		}
-
-
-		// precompute the coordinates and normals of cylinder
-		std::vector<vec3> verts;
-		std::vector<vec3> norms;
+		const detail::trig_table &t = detail::trigTable(dualslices);
+		cgraVertexCount() += stacks * (dualslices+1) * 2;
+		cgraVertexCount() += ((base_radius > 0) + (top_radius > 0)) * (dualslices+2);
 
 		// thanks ben, you shall forever be immortalized
-		float bens_theta = math::pi()/2 * std::atan((base_radius-top_radius)/height);
+		float bens_theta = math::pi<float>()/2 * std::atan((base_radius-top_radius)/height);
 		float sin_bens_theta = std::sin(bens_theta);
 		float cos_bens_theta = std::cos(bens_theta);
 
-		for (int stack_count = 0; stack_count <= stacks; ++stack_count) {
-			float t = float(stack_count)/stacks;
-			float z = height * t;
-			float width = base_radius + (top_radius-base_radius) * t;
-
-			for (int slice_count = 0; slice_count <= dualslices; ++slice_count) {
-				verts.push_back(vec3(
-					width * cos_phi_vector[slice_count],
-					width * sin_phi_vector[slice_count],
-					z));
-
-				norms.push_back(vec3(
-					cos_bens_theta * cos_phi_vector[slice_count],
-					cos_bens_theta * sin_phi_vector[slice_count],
-					sin_bens_theta));
-
-			}
-		}
-
 		// use triangle strips to display each stack of the cylinder
+		// (the normal only depends on the slice, so it is shared by both rows)
 		for (int stack_count = 0; stack_count < stacks; ++stack_count) {
+			float th = float(stack_count)/stacks;
+			float tl = float(stack_count+1)/stacks;
+			float zh = height * th;
+			float zl = height * tl;
+			float wh = base_radius + (top_radius-base_radius) * th;
+			float wl = base_radius + (top_radius-base_radius) * tl;
+
 			glBegin(GL_TRIANGLE_STRIP);
 
 			for (int slice_count = 0; slice_count <= dualslices; ++slice_count) {
-				
-				vec3 &ph = verts[slice_count + stack_count*(dualslices+1)];
-				vec3 &pl = verts[slice_count + (stack_count+1)*(dualslices+1)];
-
-				vec3 &nh = norms[slice_count + stack_count*(dualslices+1)];
-				vec3 &nl = norms[slice_count + (stack_count+1)*(dualslices+1)];
-
-				glNormal3f(nh.x, nh.y, nh.z);
-				glVertex3f(ph.x, ph.y, ph.z);
+				float c = t.cos_phi[slice_count];
+				float s = t.sin_phi[slice_count];
 
-				glNormal3f(nl.x, nl.y, nl.z);
-				glVertex3f(pl.x, pl.y, pl.z);
+				glNormal3f(cos_bens_theta * c, cos_bens_theta * s, sin_bens_theta);
+				glVertex3f(wh * c, wh * s, zh);
+				glVertex3f(wl * c, wl * s, zl);
 			}
 
 			glEnd();
@@ -147,8 +219,7 @@ namespace cgra {
 			glVertex3f(0,0,0);
 
 			for (int slice_count = 0; slice_count <= dualslices; ++slice_count) {
-				vec3 &p = verts[slice_count];
-				glVertex3f(p.x, p.y, p.z);
+				glVertex3f(base_radius * t.cos_phi[slice_count], base_radius * t.sin_phi[slice_count], 0);
 			}
 			glEnd();
 		}
@@ -159,14 +230,33 @@ namespace cgra {
 			glVertex3f(0,0,height);
 
 			for (int slice_count = dualslices; slice_count >= 0; --slice_count) {
-				vec3 &p = verts[slice_count + (stacks)*(dualslices+1)];
-				glVertex3f(p.x, p.y, p.z);
+				glVertex3f(top_radius * t.cos_phi[slice_count], top_radius * t.sin_phi[slice_count], height);
 			}
 			glEnd();
 		}
 	}
 
-	void cgraCone(float base_radius, float height, int slices=10, int stacks=10, bool wire=false) {
+	inline void cgraCone(float base_radius, float height, int slices=10, int stacks=10, bool wire=false) {
 		cgraCylinder(base_radius, 0, height, slices, stacks, wire);
 	}
-}
\ No newline at end of file
+
+	// Level of detail variants
+	// Picks the slice/stack count from the projected size of the
+	// primitive under the given modelview (a CPU-side copy of the GL one,
+	// rotations about the origin can be left out) and lodProjection()
+	//
+	inline void cgraSphereLOD(float radius, const mat4 &modelview, bool wire=false) {
+		const int *level = tessellation_levels[tessellationLevel(projectedRadius(radius, modelview))];
+		cgraSphere(radius, level[0], level[1], wire);
+	}
+
+	inline void cgraCylinderLOD(float base_radius, float top_radius, float height, const mat4 &modelview, bool wire=false) {
+		// cylinders are long and thin, so only the slices follow the radius
+		const int *level = tessellation_levels[tessellationLevel(projectedRadius(std::max(base_radius, top_radius), modelview))];
+		cgraCylinder(base_radius, top_radius, height, level[0], 1, wire);
+	}
+
+	inline void cgraConeLOD(float base_radius, float height, const mat4 &modelview, bool wire=false) {
+		cgraCylinderLOD(base_radius, 0, height, modelview, wire);
+	}
+}
@@ -58,6 +58,7 @@
 #include <cassert>
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <iomanip>
 #include <iostream>
 #include <limits>
@@ -101,41 +102,171 @@ namespace cgra {
 	using  mat4 = matrix4<float>;
 	using dmat4 = matrix4<double>;
 
+	template <typename> class affine3x4;
+	using  affine3 = affine3x4<float>;
+	using daffine3 = affine3x4<double>;
+
 	namespace math {
 
-		// random
+		// Pseudo-random number stream (xoshiro256**, Blackman and Vigna)
+		// 
+		// Small and fast, with 256 bits of state. Streams built from the same
+		// seed and stream number give the same sequence. Different stream
+		// numbers start 2^128 draws apart, so they never overlap, and each
+		// thread can have its own. Satisfies the standard uniform random bit
+		// generator requirements, so it also works with <random> distributions.
+		class random_stream {
+		private:
+			uint64_t s[4];
+
+			static uint64_t rotl(uint64_t x, int k) {
+				return (x << k) | (x >> (64 - k));
+			}
+
+			// 24 random bits to a float in [0, 1)
+			static float toFloat(uint64_t bits) {
+				return float(bits) * (1.f / 16777216.f);
+			}
+
+		public:
+			using result_type = uint64_t;
+
+			explicit random_stream(uint64_t seed = 0, uint64_t stream = 0) {
+				// splitmix64 spreads the seed over the whole state
+				for (int i = 0; i < 4; i++) {
+					uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+					z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+					z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+					s[i] = z ^ (z >> 31);
+				}
+				for (uint64_t i = 0; i < stream; i++) jump();
+			}
+
+			static constexpr result_type min() { return 0; }
+			static constexpr result_type max() { return UINT64_MAX; }
+
+			// next 64 random bits
+			result_type operator()() {
+				const uint64_t result = rotl(s[1] * 5, 7) * 9;
+				const uint64_t t = s[1] << 17;
+				s[2] ^= s[0];
+				s[3] ^= s[1];
+				s[1] ^= s[2];
+				s[0] ^= s[3];
+				s[2] ^= t;
+				s[3] = rotl(s[3], 45);
+				return result;
+			}
+
+			// advances 2^128 draws
+			void jump() {
+				static const uint64_t j[4] = { 0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull, 0xa9582618e03fc9aaull, 0x39abdc4529b1661cull };
+				uint64_t t[4] = { 0, 0, 0, 0 };
+				for (int i = 0; i < 4; i++) {
+					for (int b = 0; b < 64; b++) {
+						if (j[i] & (uint64_t(1) << b)) {
+							for (int k = 0; k < 4; k++) t[k] ^= s[k];
+						}
+						(*this)();
+					}
+				}
+				for (int k = 0; k < 4; k++) s[k] = t[k];
+			}
+
+			// float in [0, 1)
+			float nextFloat() {
+				return toFloat((*this)() >> 40);
+			}
+
+			// double in [0, 1)
+			double nextDouble() {
+				return double((*this)() >> 11) * (1.0 / 9007199254740992.0);
+			}
+
+			// real types are drawn in their own precision, others through double
+			template <typename T>
+			T uniform(T lower = 0, T upper = 1) {
+				using real_t = std::conditional_t<std::is_floating_point<T>::value, T, double>;
+				real_t u = std::is_same<real_t, float>::value ? real_t(nextFloat()) : real_t(nextDouble());
+				return T(real_t(lower) + (real_t(upper) - real_t(lower)) * u);
+			}
+
+			// fills out with n floats in [lower, upper), two for every 64 bits drawn
+			void fill(float *out, size_t n, float lower = 0, float upper = 1) {
+				const float scale = upper - lower;
+				size_t i = 0;
+				for (; i + 2 <= n; i += 2) {
+					uint64_t r = (*this)();
+					out[i] = lower + scale * toFloat(r >> 40);
+					out[i + 1] = lower + scale * toFloat((r >> 8) & 0xffffff);
+				}
+				if (i < n) out[i] = uniform<float>(lower, upper);
+			}
+
+			// fills out with n vectors with each element in [lower, upper)
+			void fill(vec3 *out, size_t n, float lower = 0, float upper = 1);
+		};
+
+		// This thread's stream, seeded from std::random_device unless seedRandom
+		// was called on this thread
+		inline random_stream & threadStream() {
+			thread_local random_stream rs = [] {
+				std::random_device rd;
+				return random_stream(uint64_t(rd()) << 32 | rd());
+			}();
+			return rs;
+		}
+
+		// Restarts this thread's stream at the given seed and stream number,
+		// so what it draws next can be reproduced
+		inline void seedRandom(uint64_t seed, uint64_t stream = 0) {
+			threadStream() = random_stream(seed, stream);
+		}
+
+		// random, from this thread's stream
 		template <typename T> inline T random(T lower = 0, T upper = 1) {
-			static std::default_random_engine re { std::random_device()() };
-			std::uniform_real_distribution<double> dist(lower, upper);
-			return T(dist(re));
+			return threadStream().uniform<T>(lower, upper);
 		}
 
+		// Constants are given in the precision asked for,
+		// use like: math::pi<float>()
+
 		// pi
-		inline double pi() {
-			return 3.1415926535897932384626433832795;
+		template <typename T = double> constexpr T pi() {
+			return T(3.1415926535897932384626433832795L);
 		}
 
 		// natural log base
-		inline double e() {
-			return 2.7182818284590452353602874713527;
+		template <typename T = double> constexpr T e() {
+			return T(2.7182818284590452353602874713527L);
 		}
 
 		// golden ratio
-		inline double phi() {
-			return 1.61803398874989484820458683436563811;
+		template <typename T = double> constexpr T phi() {
+			return T(1.61803398874989484820458683436563811L);
 		}
 	}
 
-	template <typename T> inline T radians(T val) {
-		return val * math::pi() / 180.0;
+	// Angle conversions stay in the precision of the argument
+	// (float angles are not converted through double); integer
+	// angles are promoted to double and truncated back to T
+	namespace math {
+		template <typename T>
+		using angle_t = typename std::conditional<std::is_floating_point<T>::value, T, double>::type;
+	}
+
+	template <typename T> constexpr T radians(T val) {
+		using A = math::angle_t<T>;
+		return T(A(val) * (math::pi<A>() / A(180)));
 	}
 
-	template <typename T> inline T degrees(T val) {
-		return val / math::pi() * 180.0;
+	template <typename T> constexpr T degrees(T val) {
+		using A = math::angle_t<T>;
+		return T(A(val) * (A(180) / math::pi<A>()));
 	}
 
 	template <typename T> inline T log2(const T &a) {
-		return std::log(a) * 1.4426950408889634073599246810019;
+		return std::log(a) * T(1.4426950408889634073599246810019L);
 	}
 
 	template <typename T> inline T exp2(const T &a) {
@@ -191,21 +322,23 @@ namespace cgra {
 		union{ T y; T g;};
 
 		// T constructors
-		vector2() : x(0), y(0) {}
-		explicit vector2(T v) : x(v), y(v) {}
-		vector2(T _x, T _y) : x(_x), y(_y) {}
+		constexpr vector2() : x(0), y(0) {}
+		constexpr explicit vector2(T v) : x(v), y(v) {}
+		constexpr vector2(T _x, T _y) : x(_x), y(_y) {}
 
 		template <typename U>
-		vector2(const vector2<U> &other) : x(other.x), y(other.y) { }
+		constexpr vector2(const vector2<U> &other) : x(other.x), y(other.y) { }
 
 		static vector2 random(T lower = 0, T upper = 1) { 
-			return vector2(math::random<T>(lower, upper), math::random<T>(lower, upper));
+			math::random_stream &rs = math::threadStream();
+			T x = rs.uniform<T>(lower, upper), y = rs.uniform<T>(lower, upper);
+			return vector2(x, y);
 		}
 
-		static vector2 i() {return vector2(1, 0);}
-		static vector2 j() {return vector2(0, 1);}
+		static constexpr vector2 i() {return vector2(1, 0);}
+		static constexpr vector2 j() {return vector2(0, 1);}
 
-		static vector2 checknan(const vector2 &v) {
+		static constexpr vector2 checknan(const vector2 &v) {
 			T sum = v.x + v.y;
 			assert(sum == sum);
 			return v;
@@ -244,7 +377,7 @@ namespace cgra {
 
 		// assign
 		template <typename U>
-		vector2 & operator=(const vector2<U> &other) {
+		constexpr vector2 & operator=(const vector2<U> &other) {
 			x = other.x;
 			y = other.y;
 			return *this;
@@ -252,14 +385,14 @@ namespace cgra {
 
 		// add-assign
 		template <typename U>
-		vector2 & operator+=(const vector2<U> &rhs) {
+		constexpr vector2 & operator+=(const vector2<U> &rhs) {
 			x += rhs.x;
 			y += rhs.y;
 			return *this;
 		}
 		
 		// add-assign
-		vector2 & operator+=(T rhs) {
+		constexpr vector2 & operator+=(T rhs) {
 			x += rhs;
 			y += rhs;
 			return *this;
@@ -267,14 +400,14 @@ namespace cgra {
 
 		// subtract-assign
 		template <typename U>
-		vector2 & operator-=(const vector2<U> &rhs) {
+		constexpr vector2 & operator-=(const vector2<U> &rhs) {
 			x -= rhs.x;
 			y -= rhs.y;
 			return *this;
 		}
 
 		// subtract-assign
-		vector2 & operator-=(T rhs) {
+		constexpr vector2 & operator-=(T rhs) {
 			x -= rhs;
 			y -= rhs;
 			return *this;
@@ -282,14 +415,14 @@ namespace cgra {
 
 		// mulitply-assign
 		template <typename U>
-		vector2 & operator*=(const vector2<U> &rhs) {
+		constexpr vector2 & operator*=(const vector2<U> &rhs) {
 			x *= rhs.x;
 			y *= rhs.y;
 			return *this;
 		}
 
 		// mulitply-assign
-		vector2 & operator*=(T rhs) {
+		constexpr vector2 & operator*=(T rhs) {
 			x *= rhs;
 			y *= rhs;
 			return *this;
@@ -297,7 +430,7 @@ namespace cgra {
 
 		// divide-assign
 		template <typename U>
-		vector2 & operator/=(const vector2<U> &rhs) {
+		constexpr vector2 & operator/=(const vector2<U> &rhs) {
 			x /= rhs.x;
 			y /= rhs.y;
 			vector2::checknan(*this);
@@ -305,7 +438,7 @@ namespace cgra {
 		}
 
 		// divide-assign
-		vector2 & operator/=(T rhs) {
+		constexpr vector2 & operator/=(T rhs) {
 			x /= rhs;
 			y /= rhs;
 			vector2::checknan(*this);
@@ -320,46 +453,46 @@ namespace cgra {
 
 	// equality
 	template <typename T>
-	inline bool operator==(const vector2<T> &lhs, const vector2<T> &rhs) {
+	constexpr bool operator==(const vector2<T> &lhs, const vector2<T> &rhs) {
 		return lhs.x == rhs.x && lhs.y == rhs.y;
 	}
 
 	// inequality
 	template <typename T>
-	inline bool operator!=(const vector2<T> &lhs, const vector2<T> &rhs) {
+	constexpr bool operator!=(const vector2<T> &lhs, const vector2<T> &rhs) {
 		return !(lhs == rhs);
 	}
 
 	// negate
 	template <typename T>
-	inline vector2<T> operator-(const vector2<T> &rhs) {
+	constexpr vector2<T> operator-(const vector2<T> &rhs) {
 		return vector2<T>(-rhs.x, -rhs.y);
 	}
 
 	// add
 	template <typename T1, typename T2>
-	inline auto operator+(const vector2<T1> &lhs, const vector2<T2> &rhs) {
+	constexpr auto operator+(const vector2<T1> &lhs, const vector2<T2> &rhs) {
 		vector2<std::common_type_t<T1, T2>> v = lhs;
 		return v += rhs;
 	}
 
 	// subtract
 	template <typename T1, typename T2>
-	inline auto operator-(const vector2<T1> &lhs, const vector2<T2> &rhs) {
+	constexpr auto operator-(const vector2<T1> &lhs, const vector2<T2> &rhs) {
 		vector2<std::common_type_t<T1, T2>> v = lhs;
 		return v -= rhs;
 	}
 
 	// multiply
 	template <typename T1, typename T2>
-	inline auto operator*(const vector2<T1> &lhs, const vector2<T2> &rhs) {
+	constexpr auto operator*(const vector2<T1> &lhs, const vector2<T2> &rhs) {
 		vector2<std::common_type_t<T1, T2>> v = lhs;
 		return v *= rhs;
 	}
 
 	// divide
 	template <typename T1, typename T2>
-	inline auto operator/(const vector2<T1> &lhs, const vector2<T2> &rhs) {
+	constexpr auto operator/(const vector2<T1> &lhs, const vector2<T2> &rhs) {
 		vector2<std::common_type_t<T1, T2>> v = lhs;
 		return v /= rhs;
 	}
@@ -370,56 +503,56 @@ namespace cgra {
 
 	// add right
 	template <typename T1, typename T2>
-	inline auto operator+(const vector2<T1> &lhs, T2 rhs) {
+	constexpr auto operator+(const vector2<T1> &lhs, T2 rhs) {
 		vector2<std::common_type_t<T1, T2>> v = lhs;
 		return v += rhs;
 	}
 
 	// add left
 	template <typename T1, typename T2>
-	inline auto operator+(T1 lhs, const vector2<T2> &rhs) {
+	constexpr auto operator+(T1 lhs, const vector2<T2> &rhs) {
 		vector2<std::common_type_t<T1, T2>> v = rhs;
 		return v += lhs;
 	}
 
 	// subtract right
 	template <typename T1, typename T2>
-	inline auto operator-(const vector2<T1> &lhs, T2 rhs) {
+	constexpr auto operator-(const vector2<T1> &lhs, T2 rhs) {
 		vector2<std::common_type_t<T1, T2>> v = lhs;
 		return v -= rhs;
 	}
 
 	// subtract left
 	template <typename T1, typename T2>
-	inline auto operator-(T1 lhs, const vector2<T2> &rhs) {
+	constexpr auto operator-(T1 lhs, const vector2<T2> &rhs) {
 		vector2<std::common_type_t<T1, T2>> v(lhs);
 		return v -= rhs;
 	}
 
 	// multiply right
 	template <typename T1, typename T2>
-	inline auto operator*(const vector2<T1> &lhs, T2 rhs) {
+	constexpr auto operator*(const vector2<T1> &lhs, T2 rhs) {
 		vector2<std::common_type_t<T1, T2>> v = lhs;
 		return v *= rhs;
 	}
 
 	// multiply left
 	template <typename T1, typename T2>
-	inline auto operator*(T1 lhs, const vector2<T2> &rhs) {
+	constexpr auto operator*(T1 lhs, const vector2<T2> &rhs) {
 		vector2<std::common_type_t<T1, T2>> v = rhs;
 		return v *= lhs;
 	}
 
 	// divide right
 	template <typename T1, typename T2>
-	inline auto operator/(const vector2<T1> &lhs, T2 rhs) {
+	constexpr auto operator/(const vector2<T1> &lhs, T2 rhs) {
 		vector2<std::common_type_t<T1, T2>> v = lhs;
 		return v /= rhs;
 	}
 
 	// divide left
 	template <typename T1, typename T2>
-	inline auto operator/(T1 lhs, const vector2<T2> &rhs) {
+	constexpr auto operator/(T1 lhs, const vector2<T2> &rhs) {
 		vector2<std::common_type_t<T1, T2>> v(lhs);
 		return v /= rhs;
 	}
@@ -689,7 +822,7 @@ namespace cgra {
 
 	// dot product
 	template <typename T1, typename T2>
-	inline auto dot(const vector2<T1> &lhs, const vector2<T2> &rhs) {
+	constexpr auto dot(const vector2<T1> &lhs, const vector2<T2> &rhs) {
 		return lhs.x * rhs.x +  lhs.y * rhs.y;
 	}
 
@@ -797,32 +930,34 @@ namespace cgra {
 		union{ T z; T b;};
 
 		// T constructors
-		vector3() : x(0), y(0), z(0) {}
-		explicit vector3(T v) : x(v), y(v), z(v) {}
-		vector3(T _x, T _y, T _z) : x(_x), y(_y), z(_z) {}
+		constexpr vector3() : x(0), y(0), z(0) {}
+		constexpr explicit vector3(T v) : x(v), y(v), z(v) {}
+		constexpr vector3(T _x, T _y, T _z) : x(_x), y(_y), z(_z) {}
 
 		template <typename U>
-		vector3(const vector3<U> &other) : x(other.x), y(other.y), z(other.z) {}
+		constexpr vector3(const vector3<U> &other) : x(other.x), y(other.y), z(other.z) {}
 
 		// vector2 constructors
 		template <typename U>
-		vector3(const vector2<U> &v, T _z) : x(v.x), y(v.y), z(_z) {}
+		constexpr vector3(const vector2<U> &v, T _z) : x(v.x), y(v.y), z(_z) {}
 
 		template <typename U>
-		vector3(T _x, const vector2<U> &v) : x(_x), y(v.x), z(v.y) {}
+		constexpr vector3(T _x, const vector2<U> &v) : x(_x), y(v.x), z(v.y) {}
 
 		// vector2 down-cast consctructor
-		explicit operator vector2<T>() const {return vector2<T>(x, y);}
+		explicit constexpr operator vector2<T>() const {return vector2<T>(x, y);}
 
 		static vector3 random(T lower = 0, T upper = 1) { 
-			return vector3(math::random<T>(lower, upper), math::random<T>(lower, upper), math::random<T>(lower, upper));
+			math::random_stream &rs = math::threadStream();
+			T x = rs.uniform<T>(lower, upper), y = rs.uniform<T>(lower, upper), z = rs.uniform<T>(lower, upper);
+			return vector3(x, y, z);
 		}
 
-		static vector3 i() {return vector3(1, 0, 0);}
-		static vector3 j() {return vector3(0, 1, 0);}
-		static vector3 k() {return vector3(0, 0, 1);}
+		static constexpr vector3 i() {return vector3(1, 0, 0);}
+		static constexpr vector3 j() {return vector3(0, 1, 0);}
+		static constexpr vector3 k() {return vector3(0, 0, 1);}
 
-		static vector3 checknan(const vector3 &v) {
+		static constexpr vector3 checknan(const vector3 &v) {
 			T sum = v.x + v.y + v.z;
 			assert(sum == sum);
 			return v;
@@ -860,7 +995,7 @@ namespace cgra {
 
 		// assign
 		template <typename U>
-		vector3 & operator=(const vector3<U> &other) {
+		constexpr vector3 & operator=(const vector3<U> &other) {
 			x = other.x;
 			y = other.y;
 			z = other.z;
@@ -869,7 +1004,7 @@ namespace cgra {
 
 		// add-assign
 		template <typename U>
-		vector3 & operator+=(const vector3<U> &rhs) {
+		constexpr vector3 & operator+=(const vector3<U> &rhs) {
 			x += rhs.x;
 			y += rhs.y;
 			z += rhs.z;
@@ -877,7 +1012,7 @@ namespace cgra {
 		}
 
 		// add-assign
-		vector3 & operator+=(T rhs) {
+		constexpr vector3 & operator+=(T rhs) {
 			x += rhs;
 			y += rhs;
 			z += rhs;
@@ -886,7 +1021,7 @@ namespace cgra {
 
 		// subtract-assign
 		template <typename U>
-		vector3 & operator-=(const vector3<U> &rhs) {
+		constexpr vector3 & operator-=(const vector3<U> &rhs) {
 			x -= rhs.x;
 			y -= rhs.y;
 			z -= rhs.z;
@@ -894,7 +1029,7 @@ namespace cgra {
 		}
 
 		// subtract-assign
-		vector3 & operator-=(T rhs) {
+		constexpr vector3 & operator-=(T rhs) {
 			x -= rhs;
 			y -= rhs;
 			z -= rhs;
@@ -903,7 +1038,7 @@ namespace cgra {
 
 		// mulitply-assign
 		template <typename U>
-		vector3 & operator*=(const vector3<U> &rhs) {
+		constexpr vector3 & operator*=(const vector3<U> &rhs) {
 			x *= rhs.x;
 			y *= rhs.y;
 			z *= rhs.z;
@@ -911,7 +1046,7 @@ namespace cgra {
 		}
 
 		// mulitply-assign
-		vector3 & operator*=(T rhs) {
+		constexpr vector3 & operator*=(T rhs) {
 			x *= rhs;
 			y *= rhs;
 			z *= rhs;
@@ -920,7 +1055,7 @@ namespace cgra {
 
 		// divide-assign
 		template <typename U>
-		vector3 & operator/=(const vector3<U> &rhs) {
+		constexpr vector3 & operator/=(const vector3<U> &rhs) {
 			x /= rhs.x;
 			y /= rhs.y;
 			z /= rhs.z;
@@ -929,7 +1064,7 @@ namespace cgra {
 		}
 
 		// divide-assign
-		vector3 & operator/=(T rhs) {
+		constexpr vector3 & operator/=(T rhs) {
 			x /= rhs;
 			y /= rhs;
 			z /= rhs;
@@ -944,46 +1079,46 @@ namespace cgra {
 
 	// equality
 	template <typename T>
-	inline bool operator==(const vector3<T> &lhs, const vector3<T> &rhs) {
+	constexpr bool operator==(const vector3<T> &lhs, const vector3<T> &rhs) {
 		return lhs.x == rhs.x && lhs.y == rhs.y && lhs.z == rhs.z;
 	}
 
 	// inequality
 	template <typename T>
-	inline bool operator!=(const vector3<T> &lhs, const vector3<T> &rhs) {
+	constexpr bool operator!=(const vector3<T> &lhs, const vector3<T> &rhs) {
 		return !(lhs == rhs);
 	}
 
 	// negate
 	template <typename T>
-	inline vector3<T> operator-(const vector3<T> &rhs) {
+	constexpr vector3<T> operator-(const vector3<T> &rhs) {
 		return vector3<T>(-rhs.x, -rhs.y, -rhs.z);
 	}
 
 	// add
 	template <typename T1, typename T2>
-	inline auto operator+(const vector3<T1> &lhs, const vector3<T2> &rhs) {
+	constexpr auto operator+(const vector3<T1> &lhs, const vector3<T2> &rhs) {
 		vector3<std::common_type_t<T1, T2>> v = lhs;
 		return v += rhs;
 	}
 
 	// subtract
 	template <typename T1, typename T2>
-	inline auto operator-(const vector3<T1> &lhs, const vector3<T2> &rhs) {
+	constexpr auto operator-(const vector3<T1> &lhs, const vector3<T2> &rhs) {
 		vector3<std::common_type_t<T1, T2>> v = lhs;
 		return v -= rhs;
 	}
 
 	// multiply
 	template <typename T1, typename T2>
-	inline auto operator*(const vector3<T1> &lhs, const vector3<T2> &rhs) {
+	constexpr auto operator*(const vector3<T1> &lhs, const vector3<T2> &rhs) {
 		vector3<std::common_type_t<T1, T2>> v = lhs;
 		return v *= rhs;
 	}
 
 	// divide
 	template <typename T1, typename T2>
-	inline auto operator/(const vector3<T1> &lhs, const vector3<T2> &rhs) {
+	constexpr auto operator/(const vector3<T1> &lhs, const vector3<T2> &rhs) {
 		vector3<std::common_type_t<T1, T2>> v = lhs;
 		return v /= rhs;
 	}
@@ -994,56 +1129,56 @@ namespace cgra {
 
 	// add right
 	template <typename T1, typename T2>
-	inline auto operator+(const vector3<T1> &lhs, T2 rhs) {
+	constexpr auto operator+(const vector3<T1> &lhs, T2 rhs) {
 		vector3<std::common_type_t<T1, T2>> v = lhs;
 		return v += rhs;
 	}
 
 	// add left
 	template <typename T1, typename T2>
-	inline auto operator+(T1 lhs, const vector3<T2> &rhs) {
+	constexpr auto operator+(T1 lhs, const vector3<T2> &rhs) {
 		vector3<std::common_type_t<T1, T2>> v = rhs;
 		return v += lhs;
 	}
 
 	// subtract right
 	template <typename T1, typename T2>
-	inline auto operator-(const vector3<T1> &lhs, T2 rhs) {
+	constexpr auto operator-(const vector3<T1> &lhs, T2 rhs) {
 		vector3<std::common_type_t<T1, T2>> v = lhs;
 		return v -= rhs;
 	}
 
 	// subtract left
 	template <typename T1, typename T2>
-	inline auto operator-(T1 lhs, const vector3<T2> &rhs) {
+	constexpr auto operator-(T1 lhs, const vector3<T2> &rhs) {
 		vector3<std::common_type_t<T1, T2>> v(lhs);
 		return v -= rhs;
 	}
 
 	// multiply right
 	template <typename T1, typename T2>
-	inline auto operator*(const vector3<T1> &lhs, T2 rhs) {
+	constexpr auto operator*(const vector3<T1> &lhs, T2 rhs) {
 		vector3<std::common_type_t<T1, T2>> v = lhs;
 		return v *= rhs;
 	}
 
 	// multiply left
 	template <typename T1, typename T2>
-	inline auto operator*(T1 lhs, const vector3<T2> &rhs) {
+	constexpr auto operator*(T1 lhs, const vector3<T2> &rhs) {
 		vector3<std::common_type_t<T1, T2>> v = rhs;
 		return v *= lhs;
 	}
 
 	// divide right
 	template <typename T1, typename T2>
-	inline auto operator/(const vector3<T1> &lhs, T2 rhs) {
+	constexpr auto operator/(const vector3<T1> &lhs, T2 rhs) {
 		vector3<std::common_type_t<T1, T2>> v = lhs;
 		return v /= rhs;
 	}
 
 	// divide left
 	template <typename T1, typename T2>
-	inline auto operator/(T1 lhs, const vector3<T2> &rhs) {
+	constexpr auto operator/(T1 lhs, const vector3<T2> &rhs) {
 		vector3<std::common_type_t<T1, T2>> v(lhs);
 		return v /= rhs;
 	}
@@ -1313,13 +1448,13 @@ namespace cgra {
 
 	// dot product
 	template <typename T1, typename T2>
-	inline auto dot(const vector3<T1> &lhs, const vector3<T2> &rhs) {
+	constexpr auto dot(const vector3<T1> &lhs, const vector3<T2> &rhs) {
 		return lhs.x * rhs.x +  lhs.y * rhs.y + lhs.z * rhs.z;
 	}
 
 	// cross product
 	template <typename T1, typename T2>
-	inline  auto cross(const vector3<T1> &lhs, const vector3<T2> &rhs){
+	constexpr  auto cross(const vector3<T1> &lhs, const vector3<T2> &rhs){
 		return vector3<std::common_type_t<T1, T2>>(lhs.y * rhs.z - lhs.z * rhs.y, lhs.z * rhs.x - lhs.x * rhs.z, lhs.x * rhs.y - lhs.y * rhs.x);
 	}
 
@@ -1427,44 +1562,46 @@ namespace cgra {
 		union{ T w; T a;};
 
 		// T constructors
-		vector4() : x(0), y(0), z(0), w(0) {}
-		explicit vector4(T v) : x(v), y(v), z(v), w(v) {}
-		vector4(T _x, T _y, T _z, T _w) : x(_x), y(_y), z(_z), w(_w) {}
+		constexpr vector4() : x(0), y(0), z(0), w(0) {}
+		constexpr explicit vector4(T v) : x(v), y(v), z(v), w(v) {}
+		constexpr vector4(T _x, T _y, T _z, T _w) : x(_x), y(_y), z(_z), w(_w) {}
 
 		template <typename U>
-		vector4(const vector2<U> &other) : x(other.x), y(other.y), z(other.z), w(other.w) {}
+		constexpr vector4(const vector2<U> &other) : x(other.x), y(other.y), z(other.z), w(other.w) {}
 
 		// vector2 constructors
 		template <typename U>
-		vector4(const vector2<U> &v, T _z, T _w) : x(v.x), y(v.y), z(_z), w(_w) {}
+		constexpr vector4(const vector2<U> &v, T _z, T _w) : x(v.x), y(v.y), z(_z), w(_w) {}
 		template <typename U>
-		vector4(T _x, const vector2<U> &v, T _w) : x(_x), y(v.x), z(v.y), w(_w) {}
+		constexpr vector4(T _x, const vector2<U> &v, T _w) : x(_x), y(v.x), z(v.y), w(_w) {}
 		template <typename U>
-		vector4(T _x, T _y, const vector2<U> &v) : x(_x), y(_y), z(v.x), w(v.y) {}
+		constexpr vector4(T _x, T _y, const vector2<U> &v) : x(_x), y(_y), z(v.x), w(v.y) {}
 		template <typename U1, typename U2>
-		vector4(const vector2<U1> &v0, const vector2<U2> &v1) : x(v0.x), y(v0.y), z(v1.x), w(v1.y) {}
+		constexpr vector4(const vector2<U1> &v0, const vector2<U2> &v1) : x(v0.x), y(v0.y), z(v1.x), w(v1.y) {}
 
 		// vector3 constructors
 		template <typename U>
-		vector4(const vector3<U> &v, T _w) : x(v.x), y(v.y), z(v.z), w(_w) {}
+		constexpr vector4(const vector3<U> &v, T _w) : x(v.x), y(v.y), z(v.z), w(_w) {}
 		template <typename U>
-		vector4(T _x, const vector3<U> &v) : x(_x), y(v.x), z(v.y), w(v.z) {}
+		constexpr vector4(T _x, const vector3<U> &v) : x(_x), y(v.x), z(v.y), w(v.z) {}
 
 		// vector2, vector3 down-cast constructors
-		explicit operator vector2<T>() const {return vector2<T>(x, y);}
-		explicit operator vector3<T>() const {return vector3<T>(x, y, z);}
+		explicit constexpr operator vector2<T>() const {return vector2<T>(x, y);}
+		explicit constexpr operator vector3<T>() const {return vector3<T>(x, y, z);}
 
 		static vector4 random(T lower = 0, T upper = 1) { 
-			return vector4(math::random<T>(lower, upper), math::random<T>(lower, upper),
-				math::random<T>(lower, upper), math::random<T>(lower, upper));
+			math::random_stream &rs = math::threadStream();
+			T x = rs.uniform<T>(lower, upper), y = rs.uniform<T>(lower, upper);
+			T z = rs.uniform<T>(lower, upper), w = rs.uniform<T>(lower, upper);
+			return vector4(x, y, z, w);
 		}
 
-		static vector4 i() {return vector4(1, 0, 0, 0);}
-		static vector4 j() {return vector4(0, 1, 0, 0);}
-		static vector4 k() {return vector4(0, 0, 1, 0);}
-		static vector4 l() {return vector4(0, 0, 0, 1);}
+		static constexpr vector4 i() {return vector4(1, 0, 0, 0);}
+		static constexpr vector4 j() {return vector4(0, 1, 0, 0);}
+		static constexpr vector4 k() {return vector4(0, 0, 1, 0);}
+		static constexpr vector4 l() {return vector4(0, 0, 0, 1);}
 
-		static vector4 checknan(const vector4 &v) {
+		static constexpr vector4 checknan(const vector4 &v) {
 			T sum = v.x + v.y + v.z + v.w;
 			assert(sum == sum);
 			return v;
@@ -1502,7 +1639,7 @@ namespace cgra {
 
 		// assign
 		template <typename U>
-		vector4 & operator=(const vector4<U> &other) {
+		constexpr vector4 & operator=(const vector4<U> &other) {
 			x = other.x;
 			y = other.y;
 			z = other.z;
@@ -1512,7 +1649,7 @@ namespace cgra {
 
 		// add-assign
 		template <typename U>
-		vector4 & operator+=(const vector4<U> &rhs) {
+		constexpr vector4 & operator+=(const vector4<U> &rhs) {
 			x += rhs.x;
 			y += rhs.y;
 			z += rhs.z;
@@ -1521,7 +1658,7 @@ namespace cgra {
 		}
 
 		// add-assign
-		vector4 & operator+=(T rhs) {
+		constexpr vector4 & operator+=(T rhs) {
 			x += rhs;
 			y += rhs;
 			z += rhs;
@@ -1531,7 +1668,7 @@ namespace cgra {
 
 		// subtract-assign
 		template <typename U>
-		vector4 & operator-=(const vector4<U> &rhs) {
+		constexpr vector4 & operator-=(const vector4<U> &rhs) {
 			x -= rhs.x;
 			y -= rhs.y;
 			z -= rhs.z;
@@ -1540,7 +1677,7 @@ namespace cgra {
 		}
 
 		// subtract-assign
-		vector4 & operator-=(T rhs) {
+		constexpr vector4 & operator-=(T rhs) {
 			x -= rhs;
 			y -= rhs;
 			z -= rhs;
@@ -1550,7 +1687,7 @@ namespace cgra {
 
 		// mulitply-assign
 		template <typename U>
-		vector4 & operator*=(const vector4<U> &rhs) {
+		constexpr vector4 & operator*=(const vector4<U> &rhs) {
 			x *= rhs.x;
 			y *= rhs.y;
 			z *= rhs.z;
@@ -1559,7 +1696,7 @@ namespace cgra {
 		}
 
 		// mulitply-assign
-		vector4 & operator*=(T rhs) {
+		constexpr vector4 & operator*=(T rhs) {
 			x *= rhs;
 			y *= rhs;
 			z *= rhs;
@@ -1569,7 +1706,7 @@ namespace cgra {
 
 		// divide-assign
 		template <typename U>
-		vector4 & operator/=(const vector4<U> &rhs) {
+		constexpr vector4 & operator/=(const vector4<U> &rhs) {
 			x /= rhs.x;
 			y /= rhs.y;
 			z /= rhs.z;
@@ -1579,7 +1716,7 @@ namespace cgra {
 		}
 
 		// divide-assign
-		vector4 & operator/=(T rhs) {
+		constexpr vector4 & operator/=(T rhs) {
 			x /= rhs;
 			y /= rhs;
 			z /= rhs;
@@ -1596,46 +1733,46 @@ namespace cgra {
 
 	// equality
 	template <typename T>
-	inline bool operator==(const vector4<T> &lhs, const vector4<T> &rhs) {
+	constexpr bool operator==(const vector4<T> &lhs, const vector4<T> &rhs) {
 		return lhs.x == rhs.x && lhs.y == rhs.y && lhs.z == rhs.z && lhs.w == rhs.w;
 	}
 
 	// inequality
 	template <typename T>
-	inline bool operator!=(const vector4<T> &lhs, const vector4<T> &rhs) {
+	constexpr bool operator!=(const vector4<T> &lhs, const vector4<T> &rhs) {
 		return !(lhs == rhs);
 	}
 
 	// negate
 	template <typename T>
-	inline vector4<T> operator-(const vector4<T> &rhs) {
+	constexpr vector4<T> operator-(const vector4<T> &rhs) {
 		return vector4<T>(-rhs.x, -rhs.y, -rhs.z, -rhs.w);
 	}
 
 	// add
 	template <typename T1, typename T2>
-	inline auto operator+(const vector4<T1> &lhs, const vector4<T2> &rhs) {
+	constexpr auto operator+(const vector4<T1> &lhs, const vector4<T2> &rhs) {
 		vector4<std::common_type_t<T1, T2>> v = lhs;
 		return v += rhs;
 	}
 
 	// subtract
 	template <typename T1, typename T2>
-	inline auto operator-(const vector4<T1> &lhs, const vector4<T2> &rhs) {
+	constexpr auto operator-(const vector4<T1> &lhs, const vector4<T2> &rhs) {
 		vector4<std::common_type_t<T1, T2>> v = lhs;
 		return v -= rhs;
 	}
 
 	// multiply
 	template <typename T1, typename T2>
-	inline auto operator*(const vector4<T1> &lhs, const vector4<T2> &rhs) {
+	constexpr auto operator*(const vector4<T1> &lhs, const vector4<T2> &rhs) {
 		vector4<std::common_type_t<T1, T2>> v = lhs;
 		return v *= rhs;
 	}
 
 	// divide
 	template <typename T1, typename T2>
-	inline auto operator/(const vector4<T1> &lhs, const vector4<T2> &rhs) {
+	constexpr auto operator/(const vector4<T1> &lhs, const vector4<T2> &rhs) {
 		vector4<std::common_type_t<T1, T2>> v = lhs;
 		return v /= rhs;
 	}
@@ -1646,56 +1783,56 @@ namespace cgra {
 
 	// add right
 	template <typename T1, typename T2>
-	inline auto operator+(const vector4<T1> &lhs, T2 rhs) {
+	constexpr auto operator+(const vector4<T1> &lhs, T2 rhs) {
 		vector4<std::common_type_t<T1, T2>> v = lhs;
 		return v += rhs;
 	}
 
 	// add left
 	template <typename T1, typename T2>
-	inline auto operator+(T1 lhs, const vector4<T2> &rhs) {
+	constexpr auto operator+(T1 lhs, const vector4<T2> &rhs) {
 		vector4<std::common_type_t<T1, T2>> v = rhs;
 		return v += lhs;
 	}
 
 	// subtract right
 	template <typename T1, typename T2>
-	inline auto operator-(const vector4<T1> &lhs, T2 rhs) {
+	constexpr auto operator-(const vector4<T1> &lhs, T2 rhs) {
 		vector4<std::common_type_t<T1, T2>> v = lhs;
 		return v -= rhs;
 	}
 
 	// subtract left
 	template <typename T1, typename T2>
-	inline auto operator-(T1 lhs, const vector4<T2> &rhs) {
+	constexpr auto operator-(T1 lhs, const vector4<T2> &rhs) {
 		vector4<std::common_type_t<T1, T2>> v(lhs);
 		return v -= rhs;
 	}
 
 	// multiply right
 	template <typename T1, typename T2>
-	inline auto operator*(const vector4<T1> &lhs, T2 rhs) {
+	constexpr auto operator*(const vector4<T1> &lhs, T2 rhs) {
 		vector4<std::common_type_t<T1, T2>> v = lhs;
 		return v *= rhs;
 	}
 
 	// multiply left
 	template <typename T1, typename T2>
-	inline auto operator*(T1 lhs, const vector4<T2> &rhs) {
+	constexpr auto operator*(T1 lhs, const vector4<T2> &rhs) {
 		vector4<std::common_type_t<T1, T2>> v = rhs;
 		return v *= lhs;
 	}
 
 	// divide right
 	template <typename T1, typename T2>
-	inline auto operator/(const vector4<T1> &lhs, T2 rhs) {
+	constexpr auto operator/(const vector4<T1> &lhs, T2 rhs) {
 		vector4<std::common_type_t<T1, T2>> v = lhs;
 		return v /= rhs;
 	}
 
 	// divide left
 	template <typename T1, typename T2>
-	inline auto operator/(T1 lhs, const vector4<T2> &rhs) {
+	constexpr auto operator/(T1 lhs, const vector4<T2> &rhs) {
 		vector4<std::common_type_t<T1, T2>> v(lhs);
 		return v /= rhs;
 	}
@@ -1965,7 +2102,7 @@ namespace cgra {
 
 	// dot product
 	template <typename T1, typename T2>
-	inline auto dot(const vector4<T1> &lhs, const vector4<T2> &rhs) {
+	constexpr auto dot(const vector4<T1> &lhs, const vector4<T2> &rhs) {
 		return lhs.x * rhs.x +  lhs.y * rhs.y + lhs.z * rhs.z + lhs.w * rhs.w;
 	}
 
@@ -2070,27 +2207,27 @@ namespace cgra {
 	private:
 		vector2<T> data[2];
 
-		void clear(T i=0) {
+		constexpr void clear(T i=0) {
 			data[0] = vector2<T>(i, 0);
 			data[1] = vector2<T>(0, i);
 		}
 
 	public:
-		matrix2() {
+		constexpr matrix2() {
 			clear();
 		}
 
-		explicit matrix2(T i) {
+		constexpr explicit matrix2(T i) {
 			clear(i);
 		}
 
 		template <typename U1, typename U2>
-		matrix2(const vector2<U1> &a, const vector2<U2> &b) {
+		constexpr matrix2(const vector2<U1> &a, const vector2<U2> &b) {
 			data[0] = a;
 			data[1] = b;
 		}
 
-		matrix2(
+		constexpr matrix2(
 			T e00, T e10, 
 			T e01, T e11
 		) {
@@ -2099,16 +2236,17 @@ namespace cgra {
 		}
 
 		template <typename U>
-		matrix2(const matrix2<U> &other) {
+		constexpr matrix2(const matrix2<U> &other) {
 			data[0] = other.data[0];
 			data[1] = other.data[1];
 		}
 
 		static matrix2 random(T lower = 0, T upper = 1) { 
-			return matrix2(vector2<T>::random(lower, upper), vector2<T>::random(lower, upper));
+			vector2<T> c0 = vector2<T>::random(lower, upper), c1 = vector2<T>::random(lower, upper);
+			return matrix2(c0, c1);
 		}
 
-		static matrix2 identity() {return matrix2(1);}
+		static constexpr matrix2 identity() {return matrix2(1);}
 
 		explicit operator T *() {
 			return &(data[0].x);
@@ -2122,12 +2260,12 @@ namespace cgra {
 			return &(data[0].x);
 		}
 
-		const vector2<T> & operator[](size_t i) const {
+		constexpr const vector2<T> & operator[](size_t i) const {
 			assert(i < 2);
 			return data[i];
 		}
 
-		vector2<T> & operator[](size_t i) {
+		constexpr vector2<T> & operator[](size_t i) {
 			assert(i < 2);
 			return data[i];
 		}
@@ -2147,7 +2285,7 @@ namespace cgra {
 
 		// assign
 		template <typename U>
-		matrix2 & operator=(const matrix2<U> &other) {
+		constexpr matrix2 & operator=(const matrix2<U> &other) {
 			data[0] = other.data[0];
 			data[1] = other.data[1];
 			return *this;
@@ -2155,14 +2293,14 @@ namespace cgra {
 
 		// add-assign
 		template <typename U>
-		matrix2 & operator+=(const matrix2<U> &rhs) {
+		constexpr matrix2 & operator+=(const matrix2<U> &rhs) {
 			data[0] += rhs[0];
 			data[1] += rhs[1];
 			return *this;
 		}
 
 		// add-assign
-		matrix2 & operator+=(T rhs) {
+		constexpr matrix2 & operator+=(T rhs) {
 			data[0] += rhs;
 			data[1] += rhs;
 			return *this;
@@ -2170,14 +2308,14 @@ namespace cgra {
 
 		// subtract-assign
 		template <typename U>
-		matrix2 & operator-=(const matrix2<U> &rhs) {
+		constexpr matrix2 & operator-=(const matrix2<U> &rhs) {
 			data[0] -= rhs[0];
 			data[1] -= rhs[1];
 			return *this;
 		}
 
 		// subtract-assign
-		matrix2 & operator-=(T rhs) {
+		constexpr matrix2 & operator-=(T rhs) {
 			data[0] -= rhs;
 			data[1] -= rhs;
 			return *this;
@@ -2188,19 +2326,17 @@ namespace cgra {
 		// 
 		// mulitply-assign
 		template <typename U>
-		matrix2 & operator*=(const matrix2<U> &rhs) {
+		constexpr matrix2 & operator*=(const matrix2<U> &rhs) {
 			const matrix2 lhs = *this;
 			for (int i = 0; i < 2; i++) {
-				(*this)[i] = vector2<T>(0);
-				for (int j = 0; j < 2; j++) {
-					(*this)[i] += lhs[j] * rhs[i][j];
-				}
+				const vector2<U> &r = rhs[i];
+				(*this)[i] = lhs[0] * r.x + lhs[1] * r.y;
 			}
 			return *this;
 		}
 
 		// mulitply-assign
-		matrix2 & operator*=(T rhs) {
+		constexpr matrix2 & operator*=(T rhs) {
 			data[0] *= rhs;
 			data[1] *= rhs;
 			return *this;
@@ -2208,14 +2344,14 @@ namespace cgra {
 
 		// divide-assign
 		template <typename U>
-		matrix2 & operator/=(const matrix2<U> &rhs) {
+		constexpr matrix2 & operator/=(const matrix2<U> &rhs) {
 			data[0] /= rhs[0];
 			data[1] /= rhs[1];
 			return *this;
 		}
 
 		// divide-assign
-		matrix2 & operator/=(T rhs) {
+		constexpr matrix2 & operator/=(T rhs) {
 			data[0] /= rhs;
 			data[1] /= rhs;
 			return *this;
@@ -2229,7 +2365,7 @@ namespace cgra {
 
 	// negate
 	template <typename T>
-	inline matrix2<T> operator-(const matrix2<T> &rhs) {
+	constexpr matrix2<T> operator-(const matrix2<T> &rhs) {
 		matrix2<T> m;
 		m[0] = -rhs[0];
 		m[1] = -rhs[1];
@@ -2238,14 +2374,14 @@ namespace cgra {
 
 	// add
 	template <typename T1, typename T2>
-	inline auto operator+(const matrix2<T1> &lhs, const matrix2<T2> &rhs) {
+	constexpr auto operator+(const matrix2<T1> &lhs, const matrix2<T2> &rhs) {
 		matrix2<std::common_type_t<T1, T2>> m = lhs;
 		return m += rhs;
 	}
 
 	// subtract
 	template <typename T1, typename T2>
-	inline auto operator-(const matrix2<T1> &lhs, const matrix2<T2> &rhs) {
+	constexpr auto operator-(const matrix2<T1> &lhs, const matrix2<T2> &rhs) {
 		matrix2<std::common_type_t<T1, T2>> m = lhs;
 		return m -= rhs;
 	}
@@ -2255,7 +2391,7 @@ namespace cgra {
 	// 
 	// multiply
 	template <typename T1, typename T2>
-	inline auto operator*(const matrix2<T1> &lhs, const matrix2<T2> &rhs) {
+	constexpr auto operator*(const matrix2<T1> &lhs, const matrix2<T2> &rhs) {
 		matrix2<std::common_type_t<T1, T2>> m = lhs;
 		return m *= rhs;
 	}
@@ -2264,12 +2400,8 @@ namespace cgra {
 	// 
 	// multiply
 	template <typename T1, typename T2>
-	inline auto operator*(const matrix2<T1> &lhs, const vector2<T2> &rhs) {
-		vector2<std::common_type_t<T1, T2>> v(0);
-		for (int j = 0; j < 2; j++) {
-			v += lhs[j] * rhs[j];
-		}
-		return v;
+	constexpr auto operator*(const matrix2<T1> &lhs, const vector2<T2> &rhs) {
+		return lhs[0] * rhs.x + lhs[1] * rhs.y;
 	}
 
 	// Right multiply vector2<T> v with matrix2<T> m
@@ -2277,20 +2409,20 @@ namespace cgra {
 	// 
 	// mulitply-assign
 	template <typename T1, typename T2>
-	inline auto operator*=(vector2<T1> &lhs, const matrix2<T2> &rhs) {
+	constexpr auto operator*=(vector2<T1> &lhs, const matrix2<T2> &rhs) {
 		return lhs = vector2<std::common_type_t<T1, T2>>(dot(lhs, rhs[0]), dot(lhs, rhs[1]));
 	}
 
 	// multiply
 	template <typename T1, typename T2>
-	inline auto operator*(const vector2<T1> &lhs, const matrix2<T2> &rhs) {
+	constexpr auto operator*(const vector2<T1> &lhs, const matrix2<T2> &rhs) {
 		vector2<std::common_type_t<T1, T2>> v = lhs;
 		return v *= rhs;
 	}
 
 	// divide
 	template <typename T1, typename T2>
-	inline auto operator/(const matrix2<T1> &lhs, const matrix2<T2> &rhs) {
+	constexpr auto operator/(const matrix2<T1> &lhs, const matrix2<T2> &rhs) {
 		matrix2<std::common_type_t<T1, T2>> m = lhs;
 		return m /= rhs;
 	}
@@ -2301,28 +2433,28 @@ namespace cgra {
 
 	// add right
 	template <typename T1, typename T2>
-	inline auto operator+(const matrix2<T1> &lhs, T2 rhs) {
+	constexpr auto operator+(const matrix2<T1> &lhs, T2 rhs) {
 		matrix2<std::common_type_t<T1, T2>> m = lhs;
 		return m += rhs;
 	}
 
 	// add left
 	template <typename T1, typename T2>
-	inline auto operator+(T1 lhs, const matrix2<T2> &rhs) {
+	constexpr auto operator+(T1 lhs, const matrix2<T2> &rhs) {
 		matrix2<std::common_type_t<T1, T2>> m = rhs;
 		return m += lhs;
 	}
 
 	// subtract right
 	template <typename T1, typename T2>
-	inline auto operator-(const matrix2<T1> &lhs, T2 rhs) {
+	constexpr auto operator-(const matrix2<T1> &lhs, T2 rhs) {
 		matrix2<std::common_type_t<T1, T2>> m = lhs;
 		return m -= rhs;
 	}
 
 	// subtract left
 	template <typename T1, typename T2>
-	inline auto operator-(T1 lhs, const matrix2<T2> &rhs) {
+	constexpr auto operator-(T1 lhs, const matrix2<T2> &rhs) {
 		vector2<std::common_type_t<T1, T2>> v(lhs);
 		matrix2<std::common_type_t<T1, T2>> m(v, v);
 		return m -= rhs;
@@ -2330,28 +2462,28 @@ namespace cgra {
 
 	// multiply right
 	template <typename T1, typename T2>
-	inline auto operator*(const matrix2<T1> &lhs, T2 rhs) {
+	constexpr auto operator*(const matrix2<T1> &lhs, T2 rhs) {
 		matrix2<std::common_type_t<T1, T2>> m = lhs;
 		return m *= rhs;
 	}
 
 	// multiply left
 	template <typename T1, typename T2>
-	inline auto operator*(T1 lhs, const matrix2<T2> &rhs) {
+	constexpr auto operator*(T1 lhs, const matrix2<T2> &rhs) {
 		matrix2<std::common_type_t<T1, T2>> m = rhs;
 		return m *= lhs;
 	}
 
 	// divide right
 	template <typename T1, typename T2>
-	inline auto operator/(const matrix2<T1> &lhs, T2 rhs) {
+	constexpr auto operator/(const matrix2<T1> &lhs, T2 rhs) {
 		matrix2<std::common_type_t<T1, T2>> m = lhs;
 		return m /= rhs;
 	}
 
 	// divide left
 	template <typename T1, typename T2>
-	inline auto operator/(T1 lhs, const matrix2<T2> &rhs) {
+	constexpr auto operator/(T1 lhs, const matrix2<T2> &rhs) {
 		vector2<std::common_type_t<T1, T2>> v(lhs);
 		matrix2<std::common_type_t<T1, T2>> m(v, v);
 		return m /= rhs;
@@ -2362,7 +2494,7 @@ namespace cgra {
 
 	// determinant of matrix
 	template <typename T>
-	inline T determinant(const matrix2<T> &m) {
+	constexpr T determinant(const matrix2<T> &m) {
 		return m[0].x * m[1].y - m[1].x * m[0].y;
 	}
 
@@ -2377,17 +2509,17 @@ namespace cgra {
 
 	// transpose of matrix
 	template <typename T>
-	inline matrix2<T> transpose(const matrix2<T> &m) {
+	constexpr matrix2<T> transpose(const matrix2<T> &m) {
 		return matrix2<T>(
-			m[0][0], m[1][0],
-			m[0][1], m[1][1]
+			m[0].x, m[1].x,
+			m[0].y, m[1].y
 		);
 	}
 
 	// component-wise multiplication 
 	// see (*) and (*=) operator overload for matrix product
 	template <typename T1, typename T2>
-	inline auto matrixCompMult(const matrix2<T1> &lhs, const matrix2<T2> &rhs) {
+	constexpr auto matrixCompMult(const matrix2<T1> &lhs, const matrix2<T2> &rhs) {
 		matrix2<std::common_type_t<T1, T2>> m = lhs;
 		m[0] *= rhs[0];
 		m[1] *= rhs[1];
@@ -2395,7 +2527,7 @@ namespace cgra {
 	}
 
 	template <typename T1, typename T2>
-	inline auto outerProduct(const vector2<T1> &lhs, const vector2<T2> &rhs){
+	constexpr auto outerProduct(const vector2<T1> &lhs, const vector2<T2> &rhs){
 		matrix2<std::common_type_t<T1, T2>> m;
 		m[0] = lhs * rhs[0];
 		m[1] = lhs * rhs[1];
@@ -2423,29 +2555,29 @@ namespace cgra {
 	private:
 		vector3<T> data[3];
 
-		void clear(T i=0) {
+		constexpr void clear(T i=0) {
 			data[0] = vector3<T>(i, 0, 0);
 			data[1] = vector3<T>(0, i, 0);
 			data[2] = vector3<T>(0, 0, i);
 		}
 
 	public:
-		matrix3() {
+		constexpr matrix3() {
 			clear();
 		}
 
-		explicit matrix3(T i) {
+		constexpr explicit matrix3(T i) {
 			clear(i);
 		}
 
 		template <typename U1, typename U2, typename U3>
-		matrix3(const vector3<U1> &a, const vector3<U2> &b, const vector3<U3> &c) {
+		constexpr matrix3(const vector3<U1> &a, const vector3<U2> &b, const vector3<U3> &c) {
 			data[0] = a;
 			data[1] = b;
 			data[2] = c;
 		}
 
-		matrix3(
+		constexpr matrix3(
 			T e00, T e10, T e20,
 			T e01, T e11, T e21,
 			T e02, T e12, T e22
@@ -2456,17 +2588,18 @@ namespace cgra {
 		}
 
 		template <typename U>
-		matrix3(const matrix3<U> &other) {
+		constexpr matrix3(const matrix3<U> &other) {
 			data[0] = other.data[0];
 			data[1] = other.data[1];
 			data[2] = other.data[2];
 		}
 
 		static matrix3 random(T lower = 0, T upper = 1) { 
-			return matrix3(vector3<T>::random(lower, upper), vector3<T>::random(lower, upper), vector3<T>::random(lower, upper));
+			vector3<T> c0 = vector3<T>::random(lower, upper), c1 = vector3<T>::random(lower, upper), c2 = vector3<T>::random(lower, upper);
+			return matrix3(c0, c1, c2);
 		}
 
-		static matrix3 identity() {return matrix3(1);}
+		static constexpr matrix3 identity() {return matrix3(1);}
 
 		explicit operator T *() {
 			return &(data[0].x);
@@ -2480,12 +2613,12 @@ namespace cgra {
 			return &(data[0].x);
 		}
 
-		const vector3<T> & operator[](size_t i) const {
+		constexpr const vector3<T> & operator[](size_t i) const {
 			assert(i < 3);
 			return data[i];
 		}
 
-		vector3<T> & operator[](size_t i) {
+		constexpr vector3<T> & operator[](size_t i) {
 			assert(i < 3);
 			return data[i];
 		}
@@ -2504,7 +2637,7 @@ namespace cgra {
 			return out << oss.str();
 		}
 
-		static T det2x2(
+		static constexpr T det2x2(
 			T e00, T e01,
 			T e10, T e11
 		) {
@@ -2516,7 +2649,7 @@ namespace cgra {
 
 		// assign
 		template <typename U>
-		matrix3 & operator=(const matrix3<U> &other) {
+		constexpr matrix3 & operator=(const matrix3<U> &other) {
 			data[0] = other.data[0];
 			data[1] = other.data[1];
 			data[2] = other.data[2];
@@ -2525,7 +2658,7 @@ namespace cgra {
 
 		// add-assign
 		template <typename U>
-		matrix3 & operator+=(const matrix3<U> &rhs) {
+		constexpr matrix3 & operator+=(const matrix3<U> &rhs) {
 			data[0] += rhs[0];
 			data[1] += rhs[1];
 			data[2] += rhs[2];
@@ -2533,7 +2666,7 @@ namespace cgra {
 		}
 
 		// add-assign
-		matrix3 & operator+=(T rhs) {
+		constexpr matrix3 & operator+=(T rhs) {
 			data[0] += rhs;
 			data[1] += rhs;
 			data[2] += rhs;
@@ -2542,7 +2675,7 @@ namespace cgra {
 
 		// subtract-assign
 		template <typename U>
-		matrix3 & operator-=(const matrix3<U> &rhs) {
+		constexpr matrix3 & operator-=(const matrix3<U> &rhs) {
 			data[0] -= rhs[0];
 			data[1] -= rhs[1];
 			data[2] -= rhs[2];
@@ -2550,7 +2683,7 @@ namespace cgra {
 		}
 
 		// subtract-assign
-		matrix3 & operator-=(T rhs) {
+		constexpr matrix3 & operator-=(T rhs) {
 			data[0] -= rhs;
 			data[1] -= rhs;
 			data[2] -= rhs;
@@ -2562,19 +2695,17 @@ namespace cgra {
 		// 
 		// mulitply-assign
 		template <typename U>
-		matrix3 & operator*=(const matrix3<U> &rhs) {
+		constexpr matrix3 & operator*=(const matrix3<U> &rhs) {
 			const matrix3 lhs = *this;
 			for (int i = 0; i < 3; i++) {
-				(*this)[i] = vector3<T>(0);
-				for (int j = 0; j < 3; j++) {
-					(*this)[i] += lhs[j] * rhs[i][j];
-				}
+				const vector3<U> &r = rhs[i];
+				(*this)[i] = lhs[0] * r.x + lhs[1] * r.y + lhs[2] * r.z;
 			}
 			return *this;
 		}
 
 		// mulitply-assign
-		matrix3 & operator*=(T rhs) {
+		constexpr matrix3 & operator*=(T rhs) {
 			data[0] *= rhs;
 			data[1] *= rhs;
 			data[2] *= rhs;
@@ -2583,7 +2714,7 @@ namespace cgra {
 
 		// divide-assign
 		template <typename U>
-		matrix3 & operator/=(const matrix3<U> &rhs) {
+		constexpr matrix3 & operator/=(const matrix3<U> &rhs) {
 			data[0] /= rhs[0];
 			data[1] /= rhs[1];
 			data[2] /= rhs[2];
@@ -2591,7 +2722,7 @@ namespace cgra {
 		}
 
 		// divide-assign
-		matrix3 & operator/=(T rhs) {
+		constexpr matrix3 & operator/=(T rhs) {
 			data[0] /= rhs;
 			data[1] /= rhs;
 			data[2] /= rhs;
@@ -2606,7 +2737,7 @@ namespace cgra {
 
 	// negate
 	template <typename T>
-	inline matrix3<T> operator-(const matrix3<T> &rhs) {
+	constexpr matrix3<T> operator-(const matrix3<T> &rhs) {
 		matrix3<T> m;
 		m[0] = -rhs[0];
 		m[1] = -rhs[1];
@@ -2616,14 +2747,14 @@ namespace cgra {
 
 	// add
 	template <typename T1, typename T2>
-	inline auto operator+(const matrix3<T1> &lhs, const matrix3<T2> &rhs) {
+	constexpr auto operator+(const matrix3<T1> &lhs, const matrix3<T2> &rhs) {
 		matrix3<std::common_type_t<T1, T2>> m = lhs;
 		return m += rhs;
 	}
 
 	// subtract
 	template <typename T1, typename T2>
-	inline auto operator-(const matrix3<T1> &lhs, const matrix3<T2> &rhs) {
+	constexpr auto operator-(const matrix3<T1> &lhs, const matrix3<T2> &rhs) {
 		matrix3<std::common_type_t<T1, T2>> m = lhs;
 		return m -= rhs;
 	}
@@ -2633,7 +2764,7 @@ namespace cgra {
 	// 
 	// multiply
 	template <typename T1, typename T2>
-	inline auto operator*(const matrix3<T1> &lhs, const matrix3<T2> &rhs) {
+	constexpr auto operator*(const matrix3<T1> &lhs, const matrix3<T2> &rhs) {
 		matrix3<std::common_type_t<T1, T2>> m = lhs;
 		return m *= rhs;
 	}
@@ -2642,12 +2773,8 @@ namespace cgra {
 	// 
 	// multiply
 	template <typename T1, typename T2>
-	inline auto operator*(const matrix3<T1> &lhs, const vector3<T2> &rhs) {
-		vector3<std::common_type_t<T1, T2>> v(0);
-		for (int j = 0; j < 3; j++) {
-			v += lhs[j] * rhs[j];
-		}
-		return v;
+	constexpr auto operator*(const matrix3<T1> &lhs, const vector3<T2> &rhs) {
+		return lhs[0] * rhs.x + lhs[1] * rhs.y + lhs[2] * rhs.z;
 	}
 
 	// Right multiply vector3<T> v with matrix3<T> m
@@ -2655,20 +2782,20 @@ namespace cgra {
 	// 
 	// mulitply-assign
 	template <typename T1, typename T2>
-	inline auto operator*=(vector3<T1> &lhs, const matrix3<T2> &rhs) {
+	constexpr auto operator*=(vector3<T1> &lhs, const matrix3<T2> &rhs) {
 		return vector3<std::common_type_t<T1, T2>>(dot(lhs, rhs[0]), dot(lhs, rhs[1]), dot(lhs, rhs[2]));
 	}
 
 	// multiply
 	template <typename T1, typename T2>
-	inline auto operator*(const vector3<T1> &lhs, const matrix3<T2> &rhs) {
+	constexpr auto operator*(const vector3<T1> &lhs, const matrix3<T2> &rhs) {
 		vector3<std::common_type_t<T1, T2>> v = lhs;
 		return v*=rhs;
 	}
 
 	// divide
 	template <typename T1, typename T2>
-	inline auto operator/(const matrix3<T1> &lhs, const matrix3<T2> &rhs) {
+	constexpr auto operator/(const matrix3<T1> &lhs, const matrix3<T2> &rhs) {
 		matrix3<std::common_type_t<T1, T2>> m = lhs;
 		return m /= rhs;
 	}
@@ -2679,28 +2806,28 @@ namespace cgra {
 
 	// add right
 	template <typename T1, typename T2>
-	inline auto operator+(const matrix3<T1> &lhs, T2 rhs) {
+	constexpr auto operator+(const matrix3<T1> &lhs, T2 rhs) {
 		matrix3<std::common_type_t<T1, T2>> m = lhs;
 		return m += rhs;
 	}
 
 	// add left
 	template <typename T1, typename T2>
-	inline auto operator+(T1 lhs, const matrix3<T2> &rhs) {
+	constexpr auto operator+(T1 lhs, const matrix3<T2> &rhs) {
 		matrix3<std::common_type_t<T1, T2>> m = rhs;
 		return m += lhs;
 	}
 
 	// subtract right
 	template <typename T1, typename T2>
-	inline auto operator-(const matrix3<T1> &lhs, T2 rhs) {
+	constexpr auto operator-(const matrix3<T1> &lhs, T2 rhs) {
 		matrix3<std::common_type_t<T1, T2>> m = lhs;
 		return m -= rhs;
 	}
 
 	// subtract left
 	template <typename T1, typename T2>
-	inline auto operator-(T1 lhs, const matrix3<T2> &rhs) {
+	constexpr auto operator-(T1 lhs, const matrix3<T2> &rhs) {
 		vector3<std::common_type_t<T1, T2>> v(lhs);
 		matrix3<std::common_type_t<T1, T2>> m(v, v, v);
 		return m -= rhs;
@@ -2708,28 +2835,28 @@ namespace cgra {
 
 	// multiply right
 	template <typename T1, typename T2>
-	inline auto operator*(const matrix3<T1> &lhs, T2 rhs) {
+	constexpr auto operator*(const matrix3<T1> &lhs, T2 rhs) {
 		matrix3<std::common_type_t<T1, T2>> m = lhs;
 		return m *= rhs;
 	}
 
 	// multiply left
 	template <typename T1, typename T2>
-	inline auto operator*(T1 lhs, const matrix3<T2> &rhs) {
+	constexpr auto operator*(T1 lhs, const matrix3<T2> &rhs) {
 		matrix3<std::common_type_t<T1, T2>> m = rhs;
 		return m *= lhs;
 	}
 
 	// divide right
 	template <typename T1, typename T2>
-	inline auto operator/(const matrix3<T1> &lhs, T2 rhs) {
+	constexpr auto operator/(const matrix3<T1> &lhs, T2 rhs) {
 		matrix3<std::common_type_t<T1, T2>> m = lhs;
 		return m /= rhs;
 	}
 
 	// divide left
 	template <typename T1, typename T2>
-	inline auto operator/(T1 lhs, const matrix3<T2> &rhs) {
+	constexpr auto operator/(T1 lhs, const matrix3<T2> &rhs) {
 		vector3<std::common_type_t<T1, T2>> v(lhs);
 		matrix3<std::common_type_t<T1, T2>> m(v, v, v);
 		return m /= rhs;
@@ -2740,14 +2867,14 @@ namespace cgra {
 
 	// determinant of matrix
 	template <typename T>
-	inline T determinant(const matrix3<T> &m) {
+	constexpr T determinant(const matrix3<T> &m) {
 		T d = 0;
-		d += m[0][0] * m[1][1] * m[2][2];
-		d += m[0][1] * m[1][2] * m[2][0];
-		d += m[0][2] * m[1][0] * m[2][1];
-		d -= m[0][0] * m[1][2] * m[2][1];
-		d -= m[0][1] * m[1][0] * m[2][2];
-		d -= m[0][2] * m[1][1] * m[2][0];
+		d += m[0].x * m[1].y * m[2].z;
+		d += m[0].y * m[1].z * m[2].x;
+		d += m[0].z * m[1].x * m[2].y;
+		d -= m[0].x * m[1].z * m[2].y;
+		d -= m[0].y * m[1].x * m[2].z;
+		d -= m[0].z * m[1].y * m[2].x;
 		return d;
 	}
 
@@ -2778,18 +2905,18 @@ namespace cgra {
 
 	// transpose of matrix
 	template <typename T>
-	inline matrix3<T> transpose(const matrix3<T> &m) {
+	constexpr matrix3<T> transpose(const matrix3<T> &m) {
 		return matrix3<T>(
-			m[0][0], m[1][0], m[2][0],
-			m[0][1], m[1][1], m[2][1],
-			m[0][2], m[1][2], m[2][2]
+			m[0].x, m[1].x, m[2].x,
+			m[0].y, m[1].y, m[2].y,
+			m[0].z, m[1].z, m[2].z
 		);
 	}
 
 	// component-wise multiplication 
 	// see (*) operator overload for matrix product
 	template <typename T1, typename T2>
-	inline auto matrixCompMult(const matrix3<T1> &lhs, const matrix3<T2> &rhs) {
+	constexpr auto matrixCompMult(const matrix3<T1> &lhs, const matrix3<T2> &rhs) {
 		matrix3<std::common_type_t<T1, T2>> m = lhs;
 		m[0] *= rhs[0];
 		m[1] *= rhs[1];
@@ -2798,7 +2925,7 @@ namespace cgra {
 	}
 
 	template <typename T1, typename T2>
-	inline auto outerProduct(const vector3<T1> &lhs, const vector3<T2> &rhs){
+	constexpr auto outerProduct(const vector3<T1> &lhs, const vector3<T2> &rhs){
 		matrix3<std::common_type_t<T1, T2>> m;
 		m[0] = lhs * rhs[0];
 		m[1] = lhs * rhs[1];
@@ -2826,7 +2953,7 @@ namespace cgra {
 	private:
 		vector4<T> data[4];
 
-		void clear(T i=0) {
+		constexpr void clear(T i=0) {
 			data[0] = vector4<T>(i, 0, 0, 0);
 			data[1] = vector4<T>(0, i, 0, 0);
 			data[2] = vector4<T>(0, 0, i, 0);
@@ -2834,23 +2961,23 @@ namespace cgra {
 		}
 
 	public:
-		matrix4() {
+		constexpr matrix4() {
 			clear();
 		}
 
-		explicit matrix4(T i) {
+		constexpr explicit matrix4(T i) {
 			clear(i);
 		}
 
 		template <typename U1, typename U2, typename U3, typename U4>
-		matrix4(const vector4<U1> &a, const vector4<U2> &b, const vector4<U3> &c, const vector4<U4> &d) {
+		constexpr matrix4(const vector4<U1> &a, const vector4<U2> &b, const vector4<U3> &c, const vector4<U4> &d) {
 			data[0] = a;
 			data[1] = b;
 			data[2] = c;
 			data[3] = d;
 		}
 
-		matrix4(
+		constexpr matrix4(
 			T e00, T e10, T e20, T e30, 
 			T e01, T e11, T e21, T e31, 
 			T e02, T e12, T e22, T e32, 
@@ -2863,7 +2990,7 @@ namespace cgra {
 		}
 
 		template <typename U>
-		matrix4(const matrix4<U> &other) {
+		constexpr matrix4(const matrix4<U> &other) {
 			data[0] = other.data[0];
 			data[1] = other.data[1];
 			data[2] = other.data[2];
@@ -2871,11 +2998,12 @@ namespace cgra {
 		}
 
 		static matrix4 random(T lower = 0, T upper = 1) { 
-			return matrix4(vector4<T>::random(lower, upper), vector4<T>::random(lower, upper),
-				vector4<T>::random(lower, upper), vector4<T>::random(lower, upper));
+			vector4<T> c0 = vector4<T>::random(lower, upper), c1 = vector4<T>::random(lower, upper);
+			vector4<T> c2 = vector4<T>::random(lower, upper), c3 = vector4<T>::random(lower, upper);
+			return matrix4(c0, c1, c2, c3);
 		}
 
-		static matrix4 identity() {return matrix4(1);}
+		static constexpr matrix4 identity() {return matrix4(1);}
 
 		template <typename U1, typename U2, typename U3>
 		static matrix4 lookAt(const vector3<U1> &eye,  const vector3<U2> &lookAt, const vector3<U3> &up) {
@@ -2887,7 +3015,7 @@ namespace cgra {
 				vector4<T>(vy, 0),
 				vector4<T>(vz, 0),
 				vector4<T>(eye, 1));
-			return inverse(m);
+			return inverseRigid(m);
 		}
 
 		static matrix4 lookAt(T ex, T ey, T ez, T lx, T ly, T lz, T ux, T uy, T uz) {
@@ -2919,39 +3047,41 @@ namespace cgra {
 			return m;
 		}
 
-		static matrix4 shear(int t_dim, int s_dim, T f) {
+		static constexpr matrix4 shear(int t_dim, int s_dim, T f) {
+			// named members, vector4::operator[] is not constexpr
 			matrix4 m;
-			m[t_dim][s_dim] = f;
+			vector4<T> &c = m[t_dim];
+			(s_dim == 0 ? c.x : s_dim == 1 ? c.y : s_dim == 2 ? c.z : c.w) = f;
 			return m;
 		}
 
-		static matrix4 translate(T dx, T dy, T dz) {
+		static constexpr matrix4 translate(T dx, T dy, T dz) {
 			matrix4 m(1);
-			m[3][0] = dx;
-			m[3][1] = dy;
-			m[3][2] = dz;
+			m[3].x = dx;
+			m[3].y = dy;
+			m[3].z = dz;
 			return m;
 		}
 
 		template <typename U>
-		static matrix4 translate(const vector3<U> & d) {
+		static constexpr matrix4 translate(const vector3<U> & d) {
 			return matrix4::translate(d.x, d.y, d.z);
 		}
 
-		static matrix4 scale(T fx, T fy, T fz) {
+		static constexpr matrix4 scale(T fx, T fy, T fz) {
 			matrix4 m(1);
-			m[0][0] = fx;
-			m[1][1] = fy;
-			m[2][2] = fz;
+			m[0].x = fx;
+			m[1].y = fy;
+			m[2].z = fz;
 			return m;
 		}
 		
 		template <typename U>
-		static matrix4 scale(const vector3<U> & f) {
-			return matrix4::scale(f.x(), f.y(), f.z());
+		static constexpr matrix4 scale(const vector3<U> & f) {
+			return matrix4::scale(f.x, f.y, f.z);
 		}
 		
-		static matrix4 scale(T f) {
+		static constexpr matrix4 scale(T f) {
 			return matrix4::scale(f, f, f);
 		}
 
@@ -2994,12 +3124,12 @@ namespace cgra {
 			return &(data[0].x);
 		}
 
-		const vector4<T> & operator[](size_t i) const {
+		constexpr const vector4<T> & operator[](size_t i) const {
 			assert(i < 4);
 			return data[i];
 		}
 
-		vector4<T> & operator[](size_t i) {
+		constexpr vector4<T> & operator[](size_t i) {
 			assert(i < 4);
 			return data[i];
 		}
@@ -3020,7 +3150,7 @@ namespace cgra {
 			return out << oss.str();
 		}
 
-		static T det3x3(
+		static constexpr T det3x3(
 			T e00, T e01, T e02,
 			T e10, T e11, T e12,
 			T e20, T e21, T e22
@@ -3040,7 +3170,7 @@ namespace cgra {
 
 		// assign
 		template <typename U>
-		matrix4 & operator=(const matrix4<U> &other) {
+		constexpr matrix4 & operator=(const matrix4<U> &other) {
 			data[0] = other.data[0];
 			data[1] = other.data[1];
 			data[2] = other.data[2];
@@ -3050,7 +3180,7 @@ namespace cgra {
 
 		// add-assign
 		template <typename U>
-		matrix4 & operator+=(const matrix4<U> &rhs) {
+		constexpr matrix4 & operator+=(const matrix4<U> &rhs) {
 			data[0] += rhs[0];
 			data[1] += rhs[1];
 			data[2] += rhs[2];
@@ -3059,7 +3189,7 @@ namespace cgra {
 		}
 
 		// add-assign
-		matrix4 & operator+=(T rhs) {
+		constexpr matrix4 & operator+=(T rhs) {
 			data[0] += rhs;
 			data[1] += rhs;
 			data[2] += rhs;
@@ -3069,7 +3199,7 @@ namespace cgra {
 
 		// subtract-assign
 		template <typename U>
-		matrix4 & operator-=(const matrix4<U> &rhs) {
+		constexpr matrix4 & operator-=(const matrix4<U> &rhs) {
 			data[0] -= rhs[0];
 			data[1] -= rhs[1];
 			data[2] -= rhs[2];
@@ -3078,7 +3208,7 @@ namespace cgra {
 		}
 
 		// subtract-assign
-		matrix4 & operator-=(T rhs) {
+		constexpr matrix4 & operator-=(T rhs) {
 			data[0] -= rhs;
 			data[1] -= rhs;
 			data[2] -= rhs;
@@ -3091,19 +3221,17 @@ namespace cgra {
 		// 
 		// mulitply-assign
 		template <typename U>
-		matrix4 & operator*=(const matrix4<U> &rhs) {
+		constexpr matrix4 & operator*=(const matrix4<U> &rhs) {
 			const matrix4 lhs = *this;
 			for (int i = 0; i < 4; i++) {
-				(*this)[i] = vector4<T>(0);
-				for (int j = 0; j < 4; j++) {
-					(*this)[i] += lhs[j] * rhs[i][j];
-				}
+				const vector4<U> &r = rhs[i];
+				(*this)[i] = lhs[0] * r.x + lhs[1] * r.y + lhs[2] * r.z + lhs[3] * r.w;
 			}
 			return *this;
 		}
 
 		// mulitply-assign
-		matrix4 & operator*=(T rhs) {
+		constexpr matrix4 & operator*=(T rhs) {
 			data[0] *= rhs;
 			data[1] *= rhs;
 			data[2] *= rhs;
@@ -3113,7 +3241,7 @@ namespace cgra {
 
 		// divide-assign
 		template <typename U>
-		matrix4 & operator/=(const matrix4<U> &rhs) {
+		constexpr matrix4 & operator/=(const matrix4<U> &rhs) {
 			data[0] /= rhs[0];
 			data[1] /= rhs[1];
 			data[2] /= rhs[2];
@@ -3122,7 +3250,7 @@ namespace cgra {
 		}
 
 		// divide-assign
-		matrix4 & operator/=(T rhs) {
+		constexpr matrix4 & operator/=(T rhs) {
 			data[0] /= rhs;
 			data[1] /= rhs;
 			data[2] /= rhs;
@@ -3138,7 +3266,7 @@ namespace cgra {
 
 	// negate
 	template <typename T>
-	inline matrix4<T> operator-(const matrix4<T> &rhs) {
+	constexpr matrix4<T> operator-(const matrix4<T> &rhs) {
 		matrix4<T> m;
 		m[0] = -rhs[0];
 		m[1] = -rhs[1];
@@ -3149,14 +3277,14 @@ namespace cgra {
 
 	// add
 	template <typename T1, typename T2>
-	inline auto operator+(const matrix4<T1> &lhs, const matrix4<T2> &rhs) {
+	constexpr auto operator+(const matrix4<T1> &lhs, const matrix4<T2> &rhs) {
 		matrix4<std::common_type_t<T1, T2>> m = lhs;
 		return m += rhs;
 	}
 
 	// subtract
 	template <typename T1, typename T2>
-	inline auto operator-(const matrix4<T1> &lhs, const matrix4<T2> &rhs) {
+	constexpr auto operator-(const matrix4<T1> &lhs, const matrix4<T2> &rhs) {
 		matrix4<std::common_type_t<T1, T2>> m = lhs;
 		return m -= rhs;
 	}
@@ -3166,21 +3294,18 @@ namespace cgra {
 	// 
 	// multiply
 	template <typename T1, typename T2>
-	inline auto operator*(const matrix4<T1> &lhs, const matrix4<T2> &rhs) {
+	constexpr auto operator*(const matrix4<T1> &lhs, const matrix4<T2> &rhs) {
 		matrix4<std::common_type_t<T1, T2>> m = lhs;
-		return m *= rhs;
+		// the member, so this stays the generic (constexpr) product
+		return m.operator*=(rhs);
 	}
 
 	// Left multiply matrix4<T> m with vector4<T> v
 	// 
 	// multiply
 	template <typename T1, typename T2>
-	inline auto operator*(const matrix4<T1> &lhs, const vector4<T2> &rhs) {
-		vector4<std::common_type_t<T1, T2>> v(0);
-		for (int j = 0; j < 4; j++) {
-			v += lhs[j] * rhs[j];
-		}
-		return v;
+	constexpr auto operator*(const matrix4<T1> &lhs, const vector4<T2> &rhs) {
+		return lhs[0] * rhs.x + lhs[1] * rhs.y + lhs[2] * rhs.z + lhs[3] * rhs.w;
 	}
 
 	// Right multiply vector4<T> v with matrix4<T> m
@@ -3188,20 +3313,20 @@ namespace cgra {
 	// 
 	// mulitply-assign
 	template <typename T1, typename T2>
-	inline auto operator*=(vector4<T1> &lhs, const matrix4<T2> &rhs) {
+	constexpr auto operator*=(vector4<T1> &lhs, const matrix4<T2> &rhs) {
 		return vector4<std::common_type_t<T1, T2>>(dot(lhs, rhs[0]), dot(lhs, rhs[1]), dot(lhs, rhs[2]), dot(lhs, rhs[3]));
 	}
 
 	// multiply
 	template <typename T1, typename T2>
-	inline auto operator*(const vector4<T1> &lhs, const matrix4<T2> &rhs) {
+	constexpr auto operator*(const vector4<T1> &lhs, const matrix4<T2> &rhs) {
 		vector4<std::common_type_t<T1, T2>> v = lhs;
 		return v*=rhs;
 	}
 
 	// divide
 	template <typename T1, typename T2>
-	inline auto operator/(const matrix4<T1> &lhs, const matrix4<T2> &rhs) {
+	constexpr auto operator/(const matrix4<T1> &lhs, const matrix4<T2> &rhs) {
 		matrix4<std::common_type_t<T1, T2>> m = lhs;
 		return m /= rhs;
 	}
@@ -3212,28 +3337,28 @@ namespace cgra {
 
 	// add right
 	template <typename T1, typename T2>
-	inline auto operator+(const matrix4<T1> &lhs, T2 rhs) {
+	constexpr auto operator+(const matrix4<T1> &lhs, T2 rhs) {
 		matrix4<std::common_type_t<T1, T2>> m = lhs;
 		return m += rhs;
 	}
 
 	// add left
 	template <typename T1, typename T2>
-	inline auto operator+(T1 lhs, const matrix4<T2> &rhs) {
+	constexpr auto operator+(T1 lhs, const matrix4<T2> &rhs) {
 		matrix4<std::common_type_t<T1, T2>> m = rhs;
 		return m += lhs;
 	}
 
 	// subtract right
 	template <typename T1, typename T2>
-	inline auto operator-(const matrix4<T1> &lhs, T2 rhs) {
+	constexpr auto operator-(const matrix4<T1> &lhs, T2 rhs) {
 		matrix4<std::common_type_t<T1, T2>> m = lhs;
 		return m -= rhs;
 	}
 
 	// subtract left
 	template <typename T1, typename T2>
-	inline auto operator-(T1 lhs, const matrix4<T2> &rhs) {
+	constexpr auto operator-(T1 lhs, const matrix4<T2> &rhs) {
 		vector4<std::common_type_t<T1, T2>> v(lhs);
 		matrix4<std::common_type_t<T1, T2>> m(v, v, v, v);
 		return m -= rhs;
@@ -3241,28 +3366,28 @@ namespace cgra {
 
 	// multiply right
 	template <typename T1, typename T2>
-	inline auto operator*(const matrix4<T1> &lhs, T2 rhs) {
+	constexpr auto operator*(const matrix4<T1> &lhs, T2 rhs) {
 		matrix4<std::common_type_t<T1, T2>> m = lhs;
 		return m *= rhs;
 	}
 
 	// multiply left
 	template <typename T1, typename T2>
-	inline auto operator*(T1 lhs, const matrix4<T2> &rhs) {
+	constexpr auto operator*(T1 lhs, const matrix4<T2> &rhs) {
 		matrix4<std::common_type_t<T1, T2>> m = rhs;
 		return m *= lhs;
 	}
 
 	// divide right
 	template <typename T1, typename T2>
-	inline auto operator/(const matrix4<T1> &lhs, T2 rhs) {
+	constexpr auto operator/(const matrix4<T1> &lhs, T2 rhs) {
 		matrix4<std::common_type_t<T1, T2>> m = lhs;
 		return m /= rhs;
 	}
 
 	// divide left
 	template <typename T1, typename T2>
-	inline auto operator/(T1 lhs, const matrix4<T2> &rhs) {
+	constexpr auto operator/(T1 lhs, const matrix4<T2> &rhs) {
 		vector4<std::common_type_t<T1, T2>> v(lhs);
 		matrix4<std::common_type_t<T1, T2>> m(v, v, v, v);
 		return m /= rhs;
@@ -3273,13 +3398,13 @@ namespace cgra {
 
 	// determinant of matrix
 	template <typename T>
-	inline T determinant(const matrix4<T> &m) {
+	constexpr T determinant(const matrix4<T> &m) {
 		T d = 0;
 		// expand about first column
-		d += m[0][0] * matrix4<T>::det3x3(m[1][1], m[1][2], m[1][3], m[2][1], m[2][2], m[2][3], m[3][1], m[3][2], m[3][3]);
-		d -= m[0][1] * matrix4<T>::det3x3(m[1][0], m[1][2], m[1][3], m[2][0], m[2][2], m[2][3], m[3][0], m[3][2], m[3][3]);
-		d += m[0][2] * matrix4<T>::det3x3(m[1][0], m[1][1], m[1][3], m[2][0], m[2][1], m[2][3], m[3][0], m[3][1], m[3][3]);
-		d -= m[0][3] * matrix4<T>::det3x3(m[1][0], m[1][1], m[1][2], m[2][0], m[2][1], m[2][2], m[3][0], m[3][1], m[3][2]);
+		d += m[0].x * matrix4<T>::det3x3(m[1].y, m[1].z, m[1].w, m[2].y, m[2].z, m[2].w, m[3].y, m[3].z, m[3].w);
+		d -= m[0].y * matrix4<T>::det3x3(m[1].x, m[1].z, m[1].w, m[2].x, m[2].z, m[2].w, m[3].x, m[3].z, m[3].w);
+		d += m[0].z * matrix4<T>::det3x3(m[1].x, m[1].y, m[1].w, m[2].x, m[2].y, m[2].w, m[3].x, m[3].y, m[3].w);
+		d -= m[0].w * matrix4<T>::det3x3(m[1].x, m[1].y, m[1].z, m[2].x, m[2].y, m[2].z, m[3].x, m[3].y, m[3].z);
 		return d;
 	}
 
@@ -3316,21 +3441,61 @@ namespace cgra {
 		return mi;
 	}
 
+	// inverse of an affine matrix, where the last row is (0, 0, 0, 1)
+	// (m must be invertible, a singular upper 3x3 is only caught by assert)
+	// The upper 3x3 is inverted with cross products and applied to the
+	// negated translation, about a third of the work of inverse()
+	template <typename T>
+	inline matrix4<T> inverseAffine(const matrix4<T> &m) {
+		assert(m[0][3] == 0 && m[1][3] == 0 && m[2][3] == 0 && m[3][3] == 1);
+		vector3<T> c0(m[0]), c1(m[1]), c2(m[2]), t(m[3]);
+		// rows of the inverse of the upper 3x3
+		vector3<T> r0 = cross(c1, c2);
+		vector3<T> r1 = cross(c2, c0);
+		vector3<T> r2 = cross(c0, c1);
+		T invdet = 1 / dot(c0, r0);
+		assert(!isinf(invdet) && invdet == invdet && invdet != 0);
+		r0 *= invdet;
+		r1 *= invdet;
+		r2 *= invdet;
+		return matrix4<T>(
+			r0.x, r1.x, r2.x, 0,
+			r0.y, r1.y, r2.y, 0,
+			r0.z, r1.z, r2.z, 0,
+			-dot(r0, t), -dot(r1, t), -dot(r2, t), 1
+		);
+	}
+
+	// inverse of a rigid transform, a rotation followed by a translation
+	// The rotation is transposed and applied to the negated translation,
+	// the upper 3x3 must be orthonormal (no scale or shear)
+	template <typename T>
+	inline matrix4<T> inverseRigid(const matrix4<T> &m) {
+		assert(m[0][3] == 0 && m[1][3] == 0 && m[2][3] == 0 && m[3][3] == 1);
+		vector3<T> t(m[3]);
+		return matrix4<T>(
+			m[0][0], m[1][0], m[2][0], 0,
+			m[0][1], m[1][1], m[2][1], 0,
+			m[0][2], m[1][2], m[2][2], 0,
+			-dot(vector3<T>(m[0]), t), -dot(vector3<T>(m[1]), t), -dot(vector3<T>(m[2]), t), 1
+		);
+	}
+
 	// transpose of matrix
 	template <typename T>
-	inline matrix4<T> transpose(const matrix4<T> &m) {
+	constexpr matrix4<T> transpose(const matrix4<T> &m) {
 		return matrix4<T>(
-			m[0][0], m[1][0], m[2][0], m[3][0],
-			m[0][1], m[1][1], m[2][1], m[3][1],
-			m[0][2], m[1][2], m[2][2], m[3][2],
-			m[0][3], m[1][3], m[2][3], m[3][3]
+			m[0].x, m[1].x, m[2].x, m[3].x,
+			m[0].y, m[1].y, m[2].y, m[3].y,
+			m[0].z, m[1].z, m[2].z, m[3].z,
+			m[0].w, m[1].w, m[2].w, m[3].w
 		);
 	}
 
 	// component-wise multiplication 
 	// see (*) operator overload for matrix product
 	template <typename T1, typename T2>
-	inline auto matrixCompMult(const matrix4<T1> &lhs, const matrix4<T2> &rhs) {
+	constexpr auto matrixCompMult(const matrix4<T1> &lhs, const matrix4<T2> &rhs) {
 		matrix4<std::common_type_t<T1, T2>> m = lhs;
 		m[0] *= rhs[0];
 		m[1] *= rhs[1];
@@ -3340,7 +3505,7 @@ namespace cgra {
 	}
 
 	template <typename T1, typename T2>
-	inline auto outerProduct(const vector4<T1> &lhs, const vector4<T2> &rhs){
+	constexpr auto outerProduct(const vector4<T1> &lhs, const vector4<T2> &rhs){
 		matrix4<std::common_type_t<T1, T2>> m;
 		m[0] = lhs * rhs[0];
 		m[1] = lhs * rhs[1];
@@ -3349,4 +3514,193 @@ namespace cgra {
 		return m;
 	}
 
+
+
+	///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	////  ____           _  _     __  __       _______ _____  _______   __                                                 ////
+	//// |___ \         | || |   |  \/  |   /\|__   __|  __ \|_   _\ \ / /                                                 ////
+	////   __) | __  __ | || |_  | \  / |  /  \  | |  | |__) | | |  \ V /                                                  ////
+	////  |__ <  \ \/ / |__   _| | |\/| | / /\ \ | |  |  _  /  | |   > <                                                   ////
+	////  ___) |  >  <     | |   | |  | |/ ____ \| |  | | \ \ _| |_ / . \                                                  ////
+	//// |____/  /_/\_\    |_|   |_|  |_/_/    \_\_|  |_|  \_\_____/_/ \_\                                                 ////
+	////                                                                                                                   ////
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	// Affine transform stored as the top three rows of a 4x4 matrix, the
+	// bottom row is always (0, 0, 0, 1) and is not stored (48 bytes instead
+	// of 64 for floats). Unlike the matrix classes it is stored and accessed
+	// by row, a.row(row)[column], so points transform with a dot product per
+	// row and transforms compose one row at a time.
+	template <typename T>
+	class affine3x4 {
+	private:
+		vector4<T> data[3];
+
+	public:
+		constexpr affine3x4() {
+			data[0] = vector4<T>(1, 0, 0, 0);
+			data[1] = vector4<T>(0, 1, 0, 0);
+			data[2] = vector4<T>(0, 0, 1, 0);
+		}
+
+		template <typename U1, typename U2, typename U3>
+		constexpr affine3x4(const vector4<U1> &r0, const vector4<U2> &r1, const vector4<U3> &r2) {
+			data[0] = r0;
+			data[1] = r1;
+			data[2] = r2;
+		}
+
+		// linear part m followed by translation t
+		template <typename U1, typename U2>
+		constexpr affine3x4(const matrix3<U1> &m, const vector3<U2> &t) {
+			data[0] = vector4<T>(m[0].x, m[1].x, m[2].x, t.x);
+			data[1] = vector4<T>(m[0].y, m[1].y, m[2].y, t.y);
+			data[2] = vector4<T>(m[0].z, m[1].z, m[2].z, t.z);
+		}
+
+		// drops the bottom row of m, which must be (0, 0, 0, 1)
+		template <typename U>
+		constexpr explicit affine3x4(const matrix4<U> &m) {
+			assert(m[0].w == 0 && m[1].w == 0 && m[2].w == 0 && m[3].w == 1);
+			data[0] = vector4<T>(m[0].x, m[1].x, m[2].x, m[3].x);
+			data[1] = vector4<T>(m[0].y, m[1].y, m[2].y, m[3].y);
+			data[2] = vector4<T>(m[0].z, m[1].z, m[2].z, m[3].z);
+		}
+
+		template <typename U>
+		constexpr affine3x4(const affine3x4<U> &other) {
+			data[0] = other.row(0);
+			data[1] = other.row(1);
+			data[2] = other.row(2);
+		}
+
+		explicit constexpr operator matrix4<T>() const {
+			return matrix4<T>(
+				data[0].x, data[1].x, data[2].x, 0,
+				data[0].y, data[1].y, data[2].y, 0,
+				data[0].z, data[1].z, data[2].z, 0,
+				data[0].w, data[1].w, data[2].w, 1
+			);
+		}
+
+		static constexpr affine3x4 identity() {return affine3x4();}
+
+		static constexpr affine3x4 translate(T dx, T dy, T dz) {
+			affine3x4 a;
+			a.data[0].w = dx;
+			a.data[1].w = dy;
+			a.data[2].w = dz;
+			return a;
+		}
+
+		template <typename U>
+		static constexpr affine3x4 translate(const vector3<U> & d) {
+			return affine3x4::translate(d.x, d.y, d.z);
+		}
+
+		constexpr vector3<T> translation() const {
+			return vector3<T>(data[0].w, data[1].w, data[2].w);
+		}
+
+		T * dataPointer() {
+			return &(data[0].x);
+		}
+
+		const T * dataPointer() const{
+			return &(data[0].x);
+		}
+
+		constexpr const vector4<T> & row(size_t i) const {
+			assert(i < 3);
+			return data[i];
+		}
+
+		constexpr vector4<T> & row(size_t i) {
+			assert(i < 3);
+			return data[i];
+		}
+
+		// stream insertion
+		inline friend std::ostream & operator<<(std::ostream &out, const affine3x4 &a) {
+			const size_t field_width = 10;
+			std::ostringstream oss;
+			oss << std::setprecision(4);
+			for (size_t i = 0; i < 3; i++) {
+				oss << '[' << std::setw(field_width) << a.data[i].x << ", " << std::setw(field_width) << a.data[i].y << ", "
+					<< std::setw(field_width) << a.data[i].z << ", " << std::setw(field_width) << a.data[i].w << ']';
+				if (i < 2) oss << std::endl;
+			}
+			return out << oss.str();
+		}
+
+		// Operator overload - assign
+		// 
+
+		// assign
+		template <typename U>
+		constexpr affine3x4 & operator=(const affine3x4<U> &other) {
+			data[0] = other.row(0);
+			data[1] = other.row(1);
+			data[2] = other.row(2);
+			return *this;
+		}
+
+		// mulitply-assign
+		template <typename U>
+		constexpr affine3x4 & operator*=(const affine3x4<U> &rhs) {
+			return *this = *this * rhs;
+		}
+	};
+
+	// Transform / Transform Operator Overloads
+	// Transform / Vector Operator Overloads
+	//
+
+	// Composition, the same as the matrix product of the 4x4 matrices
+	// Each row is a combination of the rows of rhs, plus the translation
+	// 
+	// multiply
+	template <typename T1, typename T2>
+	constexpr auto operator*(const affine3x4<T1> &lhs, const affine3x4<T2> &rhs) {
+		affine3x4<std::common_type_t<T1, T2>> a;
+		for (size_t i = 0; i < 3; i++) {
+			const vector4<T1> &r = lhs.row(i);
+			a.row(i) = r.x * rhs.row(0) + r.y * rhs.row(1) + r.z * rhs.row(2)
+				+ vector4<std::common_type_t<T1, T2>>(0, 0, 0, r.w);
+		}
+		return a;
+	}
+
+	// Left multiply affine3x4<T> a with vector4<T> v
+	// 
+	// multiply
+	template <typename T1, typename T2>
+	constexpr auto operator*(const affine3x4<T1> &lhs, const vector4<T2> &rhs) {
+		return vector4<std::common_type_t<T1, T2>>(dot(lhs.row(0), rhs), dot(lhs.row(1), rhs), dot(lhs.row(2), rhs), rhs.w);
+	}
+
+	// transform point p, which is translated
+	template <typename T1, typename T2>
+	inline auto transformPoint(const affine3x4<T1> &a, const vector3<T2> &p) {
+		return vector3<std::common_type_t<T1, T2>>(a * vector4<T2>(p, 1));
+	}
+
+	// transform direction v, which is not translated
+	template <typename T1, typename T2>
+	inline auto transformVector(const affine3x4<T1> &a, const vector3<T2> &v) {
+		return vector3<std::common_type_t<T1, T2>>(a * vector4<T2>(v, 0));
+	}
+
+
+	// needs vector3 to be complete
+	inline void math::random_stream::fill(vec3 *out, size_t n, float lower, float upper) {
+		static_assert(sizeof(vec3) == 3 * sizeof(float), "vec3 must be three packed floats");
+		if (n > 0) fill(out->dataPointer(), 3 * n, lower, upper);
+	}
+
 }
+
+// SSE specializations of the hottest matrix4<float> functions
+#include "cgra_math_simd.hpp"
@@ -0,0 +1,323 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------
+//
+// CGRA Math Library - SSE specializations
+//
+// Non-template overloads of the hottest matrix4<float> functions (matrix
+// product, matrix/vector products, transpose and inverses) and of the
+// affine3x4<float> composition, using SSE intrinsics. Being exact
+// matches, they are preferred over the generic
+// templates in cgra_math.hpp, so no calling code needs to change. The
+// generic versions are still reachable with explicit template arguments,
+// eg. inverse<float>(m) or operator*<float, float>(a, b). These overloads
+// cannot be constexpr, so constant expressions on matrix4<float> must also
+// name the generic templates this way.
+//
+// Matrices keep their usual layout: each column (or row, for affine3x4)
+// is a vector4<float> and is loaded into one SSE register with an
+// unaligned load.
+//
+// Products sum their terms in the same order as the generic templates and
+// give identical results; the inverse uses a different (block-wise)
+// formulation and agrees to within rounding.
+//
+// Define CGRA_NO_SIMD to use only the generic templates.
+//
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#if !defined(CGRA_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define CGRA_SIMD_SSE
+#endif
+
+#ifdef CGRA_SIMD_SSE
+
+#include <xmmintrin.h>
+
+#include "cgra_math.hpp"
+
+// Shuffle with the lanes given in x, y, z, w order (_MM_SHUFFLE is reversed)
+#define CGRA_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps((a), (b), _MM_SHUFFLE(w, z, y, x))
+#define CGRA_SWIZZLE(a, x, y, z, w) CGRA_SHUFFLE(a, a, x, y, z, w)
+
+namespace cgra {
+
+	namespace simd {
+
+		static_assert(sizeof(vector4<float>) == 4 * sizeof(float), "vector4<float> must be tightly packed");
+		static_assert(sizeof(matrix4<float>) == 4 * sizeof(vector4<float>), "matrix4<float> must be tightly packed");
+		static_assert(sizeof(affine3x4<float>) == 3 * sizeof(vector4<float>), "affine3x4<float> must be tightly packed");
+
+		inline __m128 load(const vector4<float> &v) {
+			return _mm_loadu_ps(&v.x);
+		}
+
+		inline void store(vector4<float> &v, __m128 r) {
+			_mm_storeu_ps(&v.x, r);
+		}
+
+		// sum of c[j] * v[j], in the same order as the generic matrix * vector
+		inline __m128 combine(__m128 c0, __m128 c1, __m128 c2, __m128 c3, __m128 v) {
+			__m128 r = _mm_mul_ps(c0, CGRA_SWIZZLE(v, 0, 0, 0, 0));
+			r = _mm_add_ps(r, _mm_mul_ps(c1, CGRA_SWIZZLE(v, 1, 1, 1, 1)));
+			r = _mm_add_ps(r, _mm_mul_ps(c2, CGRA_SWIZZLE(v, 2, 2, 2, 2)));
+			r = _mm_add_ps(r, _mm_mul_ps(c3, CGRA_SWIZZLE(v, 3, 3, 3, 3)));
+			return r;
+		}
+
+		// cross product of the xyz of a and b, w is 0 if either w is 0
+		inline __m128 cross(__m128 a, __m128 b) {
+			return _mm_sub_ps(
+				_mm_mul_ps(CGRA_SWIZZLE(a, 1, 2, 0, 3), CGRA_SWIZZLE(b, 2, 0, 1, 3)),
+				_mm_mul_ps(CGRA_SWIZZLE(a, 2, 0, 1, 3), CGRA_SWIZZLE(b, 1, 2, 0, 3)));
+		}
+
+		// affine matrix from the columns of its upper 3x3 (w = 0) and
+		// its translation applied after them, -(c0 * t.x + c1 * t.y + c2 * t.z)
+		inline matrix4<float> affineInverse(__m128 c0, __m128 c1, __m128 c2, __m128 t) {
+			__m128 r = _mm_mul_ps(c0, CGRA_SWIZZLE(t, 0, 0, 0, 0));
+			r = _mm_add_ps(r, _mm_mul_ps(c1, CGRA_SWIZZLE(t, 1, 1, 1, 1)));
+			r = _mm_add_ps(r, _mm_mul_ps(c2, CGRA_SWIZZLE(t, 2, 2, 2, 2)));
+			matrix4<float> mi;
+			store(mi[0], c0);
+			store(mi[1], c1);
+			store(mi[2], c2);
+			store(mi[3], _mm_sub_ps(_mm_setr_ps(0, 0, 0, 1), r));
+			return mi;
+		}
+
+		// 2x2 matrices packed as (m00, m01, m10, m11)
+		//
+
+		// a * b
+		inline __m128 mat2Mul(__m128 a, __m128 b) {
+			return _mm_add_ps(
+				_mm_mul_ps(a, CGRA_SWIZZLE(b, 0, 3, 0, 3)),
+				_mm_mul_ps(CGRA_SWIZZLE(a, 1, 0, 3, 2), CGRA_SWIZZLE(b, 2, 1, 2, 1)));
+		}
+
+		// adjugate(a) * b
+		inline __m128 mat2AdjMul(__m128 a, __m128 b) {
+			return _mm_sub_ps(
+				_mm_mul_ps(CGRA_SWIZZLE(a, 3, 3, 0, 0), b),
+				_mm_mul_ps(CGRA_SWIZZLE(a, 1, 1, 2, 2), CGRA_SWIZZLE(b, 2, 3, 0, 1)));
+		}
+
+		// a * adjugate(b)
+		inline __m128 mat2MulAdj(__m128 a, __m128 b) {
+			return _mm_sub_ps(
+				_mm_mul_ps(a, CGRA_SWIZZLE(b, 3, 0, 3, 0)),
+				_mm_mul_ps(CGRA_SWIZZLE(a, 1, 0, 3, 2), CGRA_SWIZZLE(b, 2, 1, 2, 1)));
+		}
+	}
+
+
+	// Matrix / Matrix Operator Overloads
+	// Matrix / Vector Operator Overloads
+	//
+
+	// multiply-assign
+	inline matrix4<float> & operator*=(matrix4<float> &lhs, const matrix4<float> &rhs) {
+		__m128 c0 = simd::load(lhs[0]);
+		__m128 c1 = simd::load(lhs[1]);
+		__m128 c2 = simd::load(lhs[2]);
+		__m128 c3 = simd::load(lhs[3]);
+		__m128 r0 = simd::combine(c0, c1, c2, c3, simd::load(rhs[0]));
+		__m128 r1 = simd::combine(c0, c1, c2, c3, simd::load(rhs[1]));
+		__m128 r2 = simd::combine(c0, c1, c2, c3, simd::load(rhs[2]));
+		__m128 r3 = simd::combine(c0, c1, c2, c3, simd::load(rhs[3]));
+		simd::store(lhs[0], r0);
+		simd::store(lhs[1], r1);
+		simd::store(lhs[2], r2);
+		simd::store(lhs[3], r3);
+		return lhs;
+	}
+
+	// multiply
+	inline matrix4<float> operator*(const matrix4<float> &lhs, const matrix4<float> &rhs) {
+		matrix4<float> m = lhs;
+		return m *= rhs;
+	}
+
+	// Left multiply matrix4<float> m with vector4<float> v
+	//
+	// multiply
+	inline vector4<float> operator*(const matrix4<float> &lhs, const vector4<float> &rhs) {
+		vector4<float> v;
+		simd::store(v, simd::combine(
+			simd::load(lhs[0]), simd::load(lhs[1]), simd::load(lhs[2]), simd::load(lhs[3]), simd::load(rhs)));
+		return v;
+	}
+
+	// Right multiply vector4<float> v with matrix4<float> m
+	// Equvilent to transpose(m) * v
+	//
+	// multiply
+	inline vector4<float> operator*(const vector4<float> &lhs, const matrix4<float> &rhs) {
+		__m128 c0 = simd::load(rhs[0]);
+		__m128 c1 = simd::load(rhs[1]);
+		__m128 c2 = simd::load(rhs[2]);
+		__m128 c3 = simd::load(rhs[3]);
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+		vector4<float> v;
+		simd::store(v, simd::combine(c0, c1, c2, c3, simd::load(lhs)));
+		return v;
+	}
+
+
+	// Matrix functions
+	//
+
+	// transpose of matrix
+	inline matrix4<float> transpose(const matrix4<float> &m) {
+		__m128 c0 = simd::load(m[0]);
+		__m128 c1 = simd::load(m[1]);
+		__m128 c2 = simd::load(m[2]);
+		__m128 c3 = simd::load(m[3]);
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+		matrix4<float> mt;
+		simd::store(mt[0], c0);
+		simd::store(mt[1], c1);
+		simd::store(mt[2], c2);
+		simd::store(mt[3], c3);
+		return mt;
+	}
+
+	// inverse of matrix (m must be invertible, a singular matrix is only
+	// caught by assert)
+	//
+	// Cramer's rule applied to the 2x2 blocks of the matrix, so that the
+	// cofactors are built from a few 2x2 products instead of sixteen 3x3
+	// determinants. Works on columns, which gives inverse(transpose(m))
+	// as rows, which is the inverse we want as columns.
+	inline matrix4<float> inverse(const matrix4<float> &m) {
+		using namespace simd;
+
+		__m128 c0 = load(m[0]);
+		__m128 c1 = load(m[1]);
+		__m128 c2 = load(m[2]);
+		__m128 c3 = load(m[3]);
+
+		// 2x2 blocks | A B |
+		//            | C D |
+		__m128 a = _mm_movelh_ps(c0, c1);
+		__m128 b = _mm_movehl_ps(c1, c0);
+		__m128 c = _mm_movelh_ps(c2, c3);
+		__m128 d = _mm_movehl_ps(c3, c2);
+
+		// determinants of the blocks as (|A|, |B|, |C|, |D|)
+		__m128 detSub = _mm_sub_ps(
+			_mm_mul_ps(CGRA_SHUFFLE(c0, c2, 0, 2, 0, 2), CGRA_SHUFFLE(c1, c3, 1, 3, 1, 3)),
+			_mm_mul_ps(CGRA_SHUFFLE(c0, c2, 1, 3, 1, 3), CGRA_SHUFFLE(c1, c3, 0, 2, 0, 2)));
+		__m128 detA = CGRA_SWIZZLE(detSub, 0, 0, 0, 0);
+		__m128 detB = CGRA_SWIZZLE(detSub, 1, 1, 1, 1);
+		__m128 detC = CGRA_SWIZZLE(detSub, 2, 2, 2, 2);
+		__m128 detD = CGRA_SWIZZLE(detSub, 3, 3, 3, 3);
+
+		// inverse is 1/|M| * | X Y |
+		//                    | Z W |
+		// with the adjugates of the blocks computed first
+		__m128 adjDC = mat2AdjMul(d, c);
+		__m128 adjAB = mat2AdjMul(a, b);
+		__m128 x = _mm_sub_ps(_mm_mul_ps(detD, a), mat2Mul(b, adjDC));
+		__m128 w = _mm_sub_ps(_mm_mul_ps(detA, d), mat2Mul(c, adjAB));
+		__m128 y = _mm_sub_ps(_mm_mul_ps(detB, c), mat2MulAdj(d, adjAB));
+		__m128 z = _mm_sub_ps(_mm_mul_ps(detC, b), mat2MulAdj(a, adjDC));
+
+		// |M| = |A||D| + |B||C| - trace(adj(A)B adj(D)C)
+		__m128 tr = _mm_mul_ps(adjAB, CGRA_SWIZZLE(adjDC, 0, 2, 1, 3));
+		tr = _mm_add_ps(tr, CGRA_SWIZZLE(tr, 2, 3, 0, 1));
+		tr = _mm_add_ps(tr, CGRA_SWIZZLE(tr, 1, 0, 3, 2));
+		__m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr);
+
+		assert(_mm_cvtss_f32(det) != 0 && !isinf(1 / _mm_cvtss_f32(det)));
+
+		// (1/|M|, -1/|M|, -1/|M|, 1/|M|) applies the sign of the adjugate
+		__m128 invdet = _mm_div_ps(_mm_setr_ps(1.f, -1.f, -1.f, 1.f), det);
+		x = _mm_mul_ps(x, invdet);
+		y = _mm_mul_ps(y, invdet);
+		z = _mm_mul_ps(z, invdet);
+		w = _mm_mul_ps(w, invdet);
+
+		// the adjugate swaps the diagonal of each block, combined with the store
+		matrix4<float> mi;
+		store(mi[0], CGRA_SHUFFLE(x, y, 3, 1, 3, 1));
+		store(mi[1], CGRA_SHUFFLE(x, y, 2, 0, 2, 0));
+		store(mi[2], CGRA_SHUFFLE(z, w, 3, 1, 3, 1));
+		store(mi[3], CGRA_SHUFFLE(z, w, 2, 0, 2, 0));
+		return mi;
+	}
+
+	// inverse of an affine matrix, where the last row is (0, 0, 0, 1)
+	// (m must be invertible, a singular upper 3x3 is only caught by assert)
+	inline matrix4<float> inverseAffine(const matrix4<float> &m) {
+		assert(m[0][3] == 0 && m[1][3] == 0 && m[2][3] == 0 && m[3][3] == 1);
+		__m128 c0 = simd::load(m[0]);
+		__m128 c1 = simd::load(m[1]);
+		__m128 c2 = simd::load(m[2]);
+
+		// rows of the inverse of the upper 3x3
+		__m128 r0 = simd::cross(c1, c2);
+		__m128 r1 = simd::cross(c2, c0);
+		__m128 r2 = simd::cross(c0, c1);
+		__m128 r3 = _mm_setzero_ps();
+
+		__m128 det = _mm_mul_ps(c0, r0);
+		det = _mm_add_ps(det, CGRA_SWIZZLE(det, 2, 3, 0, 1));
+		det = _mm_add_ps(det, CGRA_SWIZZLE(det, 1, 0, 3, 2));
+		assert(_mm_cvtss_f32(det) != 0 && !isinf(1 / _mm_cvtss_f32(det)));
+		__m128 invdet = _mm_div_ps(_mm_set1_ps(1), det);
+
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		return simd::affineInverse(
+			_mm_mul_ps(r0, invdet), _mm_mul_ps(r1, invdet), _mm_mul_ps(r2, invdet), simd::load(m[3]));
+	}
+
+	// inverse of a rigid transform, a rotation followed by a translation
+	// (the upper 3x3 must be orthonormal)
+	inline matrix4<float> inverseRigid(const matrix4<float> &m) {
+		assert(m[0][3] == 0 && m[1][3] == 0 && m[2][3] == 0 && m[3][3] == 1);
+		__m128 c0 = simd::load(m[0]);
+		__m128 c1 = simd::load(m[1]);
+		__m128 c2 = simd::load(m[2]);
+		__m128 c3 = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+		return simd::affineInverse(c0, c1, c2, simd::load(m[3]));
+	}
+
+
+	// Transform / Transform Operator Overloads
+	//
+
+	// multiply
+	inline affine3x4<float> operator*(const affine3x4<float> &lhs, const affine3x4<float> &rhs) {
+		__m128 r0 = simd::load(rhs.row(0));
+		__m128 r1 = simd::load(rhs.row(1));
+		__m128 r2 = simd::load(rhs.row(2));
+		__m128 r3 = _mm_setr_ps(0, 0, 0, 1);
+		affine3x4<float> a;
+		simd::store(a.row(0), simd::combine(r0, r1, r2, r3, simd::load(lhs.row(0))));
+		simd::store(a.row(1), simd::combine(r0, r1, r2, r3, simd::load(lhs.row(1))));
+		simd::store(a.row(2), simd::combine(r0, r1, r2, r3, simd::load(lhs.row(2))));
+		return a;
+	}
+}
+
+#undef CGRA_SWIZZLE
+#undef CGRA_SHUFFLE
+
+#endif // CGRA_SIMD_SSE
@@ -0,0 +1,323 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------
+//
+// CGRA Math Library - structure of arrays
+//
+// Batched kernels for large arrays of 3D vectors stored as separate x, y
+// and z arrays (structure of arrays), so that four vectors are processed
+// at a time with SSE where cgra_math_simd.hpp enables it. The leftover
+// vectors (when the count is not a multiple of four) are processed one at
+// a time, using the same arithmetic as the vector3 functions, so results
+// match those of the vector3 functions exactly.
+//
+// Any float pointers work; arrays from aligned_allocator (eg. in vec3_soa)
+// are aligned to a cache line.
+//
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include "cgra_math.hpp"
+
+#ifdef CGRA_SIMD_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace cgra {
+
+	// Aligned allocation
+	//
+
+	// Allocates bytes aligned to alignment (a power of two), must be
+	// released with alignedFree
+	inline void * alignedAlloc(size_t bytes, size_t alignment) {
+		assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+		// over-allocate and keep the original pointer just before the aligned block
+		void *raw = ::operator new(bytes + alignment + sizeof(void *));
+		uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + sizeof(void *) + alignment - 1) & ~uintptr_t(alignment - 1);
+		reinterpret_cast<void **>(aligned)[-1] = raw;
+		return reinterpret_cast<void *>(aligned);
+	}
+
+	inline void alignedFree(void *p) {
+		if (p) ::operator delete(reinterpret_cast<void **>(p)[-1]);
+	}
+
+	// Allocator for standard containers (eg. std::vector) with aligned storage
+	template <typename T, size_t Alignment = 64>
+	class aligned_allocator {
+	public:
+		using value_type = T;
+
+		template <typename U>
+		struct rebind { using other = aligned_allocator<U, Alignment>; };
+
+		aligned_allocator() { }
+
+		template <typename U>
+		aligned_allocator(const aligned_allocator<U, Alignment> &) { }
+
+		T * allocate(size_t n) {
+			return static_cast<T *>(alignedAlloc(n * sizeof(T), Alignment));
+		}
+
+		void deallocate(T *p, size_t) {
+			alignedFree(p);
+		}
+
+		template <typename U>
+		bool operator==(const aligned_allocator<U, Alignment> &) const { return true; }
+
+		template <typename U>
+		bool operator!=(const aligned_allocator<U, Alignment> &) const { return false; }
+	};
+
+	template <typename T>
+	using aligned_vector = std::vector<T, aligned_allocator<T>>;
+
+
+	// Views and storage
+	//
+
+	// Non-owning view of size vectors stored as separate x, y and z arrays
+	template <typename T>
+	struct vec3_span_t {
+		T *x = nullptr;
+		T *y = nullptr;
+		T *z = nullptr;
+		size_t size = 0;
+
+		vec3_span_t() { }
+		vec3_span_t(T *_x, T *_y, T *_z, size_t _size) : x(_x), y(_y), z(_z), size(_size) { }
+
+		// mutable to const view
+		template <typename U>
+		vec3_span_t(const vec3_span_t<U> &other) : x(other.x), y(other.y), z(other.z), size(other.size) { }
+
+		vector3<std::remove_const_t<T>> operator[](size_t i) const {
+			assert(i < size);
+			return vector3<std::remove_const_t<T>>(x[i], y[i], z[i]);
+		}
+	};
+
+	using vec3_span = vec3_span_t<float>;
+	using const_vec3_span = vec3_span_t<const float>;
+
+
+	// Growable array of vectors stored as aligned x, y and z arrays
+	class vec3_soa {
+	private:
+		aligned_vector<float> m_x, m_y, m_z;
+
+	public:
+		vec3_soa() { }
+
+		explicit vec3_soa(size_t n) : m_x(n), m_y(n), m_z(n) { }
+
+		explicit vec3_soa(const std::vector<vec3> &v) {
+			reserve(v.size());
+			for (const vec3 &p : v) push_back(p);
+		}
+
+		size_t size() const { return m_x.size(); }
+
+		void resize(size_t n) {
+			m_x.resize(n);
+			m_y.resize(n);
+			m_z.resize(n);
+		}
+
+		void reserve(size_t n) {
+			m_x.reserve(n);
+			m_y.reserve(n);
+			m_z.reserve(n);
+		}
+
+		void push_back(const vec3 &v) {
+			m_x.push_back(v.x);
+			m_y.push_back(v.y);
+			m_z.push_back(v.z);
+		}
+
+		vec3 get(size_t i) const {
+			return vec3(m_x[i], m_y[i], m_z[i]);
+		}
+
+		void set(size_t i, const vec3 &v) {
+			m_x[i] = v.x;
+			m_y[i] = v.y;
+			m_z[i] = v.z;
+		}
+
+		float * x() { return m_x.data(); }
+		float * y() { return m_y.data(); }
+		float * z() { return m_z.data(); }
+		const float * x() const { return m_x.data(); }
+		const float * y() const { return m_y.data(); }
+		const float * z() const { return m_z.data(); }
+
+		operator vec3_span() {
+			return vec3_span(x(), y(), z(), size());
+		}
+
+		operator const_vec3_span() const {
+			return const_vec3_span(x(), y(), z(), size());
+		}
+	};
+
+
+	// Kernels
+	// Outputs may be the same arrays as the inputs
+	//
+
+	// transforms the points in by a into out
+	inline void transformPoints(const affine3 &a, const_vec3_span in, vec3_span out) {
+		assert(out.size >= in.size);
+		const vec4 &r0 = a.row(0), &r1 = a.row(1), &r2 = a.row(2);
+		size_t i = 0;
+#ifdef CGRA_SIMD_SSE
+		const __m128 r0x = _mm_set1_ps(r0.x), r0y = _mm_set1_ps(r0.y), r0z = _mm_set1_ps(r0.z), r0w = _mm_set1_ps(r0.w);
+		const __m128 r1x = _mm_set1_ps(r1.x), r1y = _mm_set1_ps(r1.y), r1z = _mm_set1_ps(r1.z), r1w = _mm_set1_ps(r1.w);
+		const __m128 r2x = _mm_set1_ps(r2.x), r2y = _mm_set1_ps(r2.y), r2z = _mm_set1_ps(r2.z), r2w = _mm_set1_ps(r2.w);
+		for (; i + 4 <= in.size; i += 4) {
+			__m128 x = _mm_loadu_ps(in.x + i), y = _mm_loadu_ps(in.y + i), z = _mm_loadu_ps(in.z + i);
+			__m128 ox = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, r0x), _mm_mul_ps(y, r0y)), _mm_mul_ps(z, r0z)), r0w);
+			__m128 oy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, r1x), _mm_mul_ps(y, r1y)), _mm_mul_ps(z, r1z)), r1w);
+			__m128 oz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, r2x), _mm_mul_ps(y, r2y)), _mm_mul_ps(z, r2z)), r2w);
+			_mm_storeu_ps(out.x + i, ox);
+			_mm_storeu_ps(out.y + i, oy);
+			_mm_storeu_ps(out.z + i, oz);
+		}
+#endif
+		for (; i < in.size; i++) {
+			float x = in.x[i], y = in.y[i], z = in.z[i];
+			out.x[i] = x * r0.x + y * r0.y + z * r0.z + r0.w;
+			out.y[i] = x * r1.x + y * r1.y + z * r1.z + r1.w;
+			out.z[i] = x * r2.x + y * r2.y + z * r2.z + r2.w;
+		}
+	}
+
+	// transforms the directions in by a (without translation) into out
+	inline void transformVectors(const affine3 &a, const_vec3_span in, vec3_span out) {
+		assert(out.size >= in.size);
+		const vec4 &r0 = a.row(0), &r1 = a.row(1), &r2 = a.row(2);
+		size_t i = 0;
+#ifdef CGRA_SIMD_SSE
+		const __m128 r0x = _mm_set1_ps(r0.x), r0y = _mm_set1_ps(r0.y), r0z = _mm_set1_ps(r0.z);
+		const __m128 r1x = _mm_set1_ps(r1.x), r1y = _mm_set1_ps(r1.y), r1z = _mm_set1_ps(r1.z);
+		const __m128 r2x = _mm_set1_ps(r2.x), r2y = _mm_set1_ps(r2.y), r2z = _mm_set1_ps(r2.z);
+		for (; i + 4 <= in.size; i += 4) {
+			__m128 x = _mm_loadu_ps(in.x + i), y = _mm_loadu_ps(in.y + i), z = _mm_loadu_ps(in.z + i);
+			_mm_storeu_ps(out.x + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, r0x), _mm_mul_ps(y, r0y)), _mm_mul_ps(z, r0z)));
+			_mm_storeu_ps(out.y + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, r1x), _mm_mul_ps(y, r1y)), _mm_mul_ps(z, r1z)));
+			_mm_storeu_ps(out.z + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, r2x), _mm_mul_ps(y, r2y)), _mm_mul_ps(z, r2z)));
+		}
+#endif
+		for (; i < in.size; i++) {
+			float x = in.x[i], y = in.y[i], z = in.z[i];
+			out.x[i] = x * r0.x + y * r0.y + z * r0.z;
+			out.y[i] = x * r1.x + y * r1.y + z * r1.z;
+			out.z[i] = x * r2.x + y * r2.y + z * r2.z;
+		}
+	}
+
+	// unit vectors of in into out
+	inline void normalize(const_vec3_span in, vec3_span out) {
+		assert(out.size >= in.size);
+		size_t i = 0;
+#ifdef CGRA_SIMD_SSE
+		for (; i + 4 <= in.size; i += 4) {
+			__m128 x = _mm_loadu_ps(in.x + i), y = _mm_loadu_ps(in.y + i), z = _mm_loadu_ps(in.z + i);
+			__m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+			_mm_storeu_ps(out.x + i, _mm_div_ps(x, len));
+			_mm_storeu_ps(out.y + i, _mm_div_ps(y, len));
+			_mm_storeu_ps(out.z + i, _mm_div_ps(z, len));
+		}
+#endif
+		for (; i < in.size; i++) {
+			float x = in.x[i], y = in.y[i], z = in.z[i];
+			float len = std::sqrt(x * x + y * y + z * z);
+			out.x[i] = x / len;
+			out.y[i] = y / len;
+			out.z[i] = z / len;
+		}
+	}
+
+	// dot products of lhs and rhs into out
+	inline void dot(const_vec3_span lhs, const_vec3_span rhs, float *out) {
+		assert(rhs.size >= lhs.size);
+		size_t i = 0;
+#ifdef CGRA_SIMD_SSE
+		for (; i + 4 <= lhs.size; i += 4) {
+			__m128 d = _mm_mul_ps(_mm_loadu_ps(lhs.x + i), _mm_loadu_ps(rhs.x + i));
+			d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(lhs.y + i), _mm_loadu_ps(rhs.y + i)));
+			d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(lhs.z + i), _mm_loadu_ps(rhs.z + i)));
+			_mm_storeu_ps(out + i, d);
+		}
+#endif
+		for (; i < lhs.size; i++) {
+			out[i] = lhs.x[i] * rhs.x[i] + lhs.y[i] * rhs.y[i] + lhs.z[i] * rhs.z[i];
+		}
+	}
+
+	// cross products of lhs and rhs into out
+	inline void cross(const_vec3_span lhs, const_vec3_span rhs, vec3_span out) {
+		assert(rhs.size >= lhs.size && out.size >= lhs.size);
+		size_t i = 0;
+#ifdef CGRA_SIMD_SSE
+		for (; i + 4 <= lhs.size; i += 4) {
+			__m128 lx = _mm_loadu_ps(lhs.x + i), ly = _mm_loadu_ps(lhs.y + i), lz = _mm_loadu_ps(lhs.z + i);
+			__m128 rx = _mm_loadu_ps(rhs.x + i), ry = _mm_loadu_ps(rhs.y + i), rz = _mm_loadu_ps(rhs.z + i);
+			_mm_storeu_ps(out.x + i, _mm_sub_ps(_mm_mul_ps(ly, rz), _mm_mul_ps(lz, ry)));
+			_mm_storeu_ps(out.y + i, _mm_sub_ps(_mm_mul_ps(lz, rx), _mm_mul_ps(lx, rz)));
+			_mm_storeu_ps(out.z + i, _mm_sub_ps(_mm_mul_ps(lx, ry), _mm_mul_ps(ly, rx)));
+		}
+#endif
+		for (; i < lhs.size; i++) {
+			float lx = lhs.x[i], ly = lhs.y[i], lz = lhs.z[i];
+			float rx = rhs.x[i], ry = rhs.y[i], rz = rhs.z[i];
+			out.x[i] = ly * rz - lz * ry;
+			out.y[i] = lz * rx - lx * rz;
+			out.z[i] = lx * ry - ly * rx;
+		}
+	}
+
+	// linear blend of lhs and rhs into out : lhs*(1-a) + rhs*a
+	inline void mix(const_vec3_span lhs, const_vec3_span rhs, float a, vec3_span out) {
+		assert(rhs.size >= lhs.size && out.size >= lhs.size);
+		const float b = 1 - a;
+		size_t i = 0;
+#ifdef CGRA_SIMD_SSE
+		const __m128 va = _mm_set1_ps(a), vb = _mm_set1_ps(b);
+		for (; i + 4 <= lhs.size; i += 4) {
+			_mm_storeu_ps(out.x + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(lhs.x + i), vb), _mm_mul_ps(_mm_loadu_ps(rhs.x + i), va)));
+			_mm_storeu_ps(out.y + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(lhs.y + i), vb), _mm_mul_ps(_mm_loadu_ps(rhs.y + i), va)));
+			_mm_storeu_ps(out.z + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(lhs.z + i), vb), _mm_mul_ps(_mm_loadu_ps(rhs.z + i), va)));
+		}
+#endif
+		for (; i < lhs.size; i++) {
+			out.x[i] = lhs.x[i] * b + rhs.x[i] * a;
+			out.y[i] = lhs.y[i] * b + rhs.y[i] * a;
+			out.z[i] = lhs.z[i] * b + rhs.z[i] * a;
+		}
+	}
+}
@@ -0,0 +1,131 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cmath>
+
+#include "cgra_math.hpp"
+#include "quat.hpp"
+
+namespace cgra {
+
+	// Rigid transform (rotation followed by translation) as a unit dual
+	// quaternion real + e dual, 8 floats instead of 12 for affine3. Blending
+	// dual quaternions and normalizing gives a rigid transform, which is what
+	// makes dual quaternion skinning free of the candy wrapper artefacts of
+	// blending matrices.
+	class dualquat {
+	public:
+		quat real;                      // rotation
+		quat dual = quat(0, 0, 0, 0);   // half the translation times the rotation
+
+		constexpr dualquat() { }
+		constexpr dualquat(const quat &_real, const quat &_dual) : real(_real), dual(_dual) { }
+
+		// rotation followed by translation
+		constexpr dualquat(const quat &rotation, const vec3 &translation)
+			: real(rotation), dual(quat(0, translation.x, translation.y, translation.z) * rotation * 0.5f) { }
+
+		// rigid transform (must be orthonormal, without scale)
+		explicit dualquat(const affine3 &a) : dualquat(quat(a), a.translation()) { }
+
+		explicit constexpr operator affine3() const {
+			return affine3(mat3(real), translation());
+		}
+
+		// translation of a unit dual quaternion : 2 dual conjugate(real)
+		constexpr vec3 translation() const {
+			quat t = dual * conjugate(real);
+			return vec3(2 * t.x, 2 * t.y, 2 * t.z);
+		}
+
+		// stream insertion
+		inline friend std::ostream & operator<<(std::ostream &out, const dualquat &q) {
+			return out << '(' << q.real << ", " << q.dual << ')';
+		}
+
+		// add-assign
+		constexpr dualquat & operator+=(const dualquat &rhs) {
+			real += rhs.real;
+			dual += rhs.dual;
+			return *this;
+		}
+
+		// mulitply-assign
+		constexpr dualquat & operator*=(float rhs) {
+			real *= rhs;
+			dual *= rhs;
+			return *this;
+		}
+	};
+
+	// add
+	constexpr dualquat operator+(const dualquat &lhs, const dualquat &rhs) {
+		dualquat q = lhs;
+		return q += rhs;
+	}
+
+	// multiply
+	constexpr dualquat operator*(const dualquat &lhs, float rhs) {
+		dualquat q = lhs;
+		return q *= rhs;
+	}
+
+	// multiply
+	constexpr dualquat operator*(float lhs, const dualquat &rhs) {
+		dualquat q = rhs;
+		return q *= lhs;
+	}
+
+	// composition, rhs is applied first
+	constexpr dualquat operator*(const dualquat &lhs, const dualquat &rhs) {
+		return dualquat(lhs.real * rhs.real, lhs.real * rhs.dual + lhs.dual * rhs.real);
+	}
+
+	// inverse of a unit dual quaternion
+	constexpr dualquat conjugate(const dualquat &q) {
+		return dualquat(conjugate(q.real), conjugate(q.dual));
+	}
+
+	// unit dual quaternion, divides by the length of the real part (the dual
+	// part of a blend is left as is, transformPoint does not depend on it
+	// being exactly orthogonal to the real part)
+	inline dualquat normalize(const dualquat &q) {
+		float len = length(q.real);
+		return dualquat(q.real / len, q.dual / len);
+	}
+
+	// transform point p (by a unit dual quaternion) : rotate then translate
+	constexpr vec3 transformPoint(const dualquat &q, const vec3 &p) {
+		return rotate(q.real, p) + q.translation();
+	}
+
+	// transform direction v (by a unit dual quaternion), which is only rotated
+	constexpr vec3 transformVector(const dualquat &q, const vec3 &v) {
+		return rotate(q.real, v);
+	}
+
+	// dual quaternion linear blending (Kavan et al.) of count transforms with
+	// the given weights. Each is flipped into the same hemisphere as q[0], as
+	// q and -q are the same rotation but would cancel out in the sum.
+	inline dualquat blend(const dualquat *q, const float *weights, size_t count) {
+		dualquat b(quat(0, 0, 0, 0), quat(0, 0, 0, 0));
+		for (size_t i = 0; i < count; i++) {
+			float w = std::signbit(dot(q[0].real, q[i].real)) ? -weights[i] : weights[i];
+			b += q[i] * w;
+		}
+		return normalize(b);
+	}
+}
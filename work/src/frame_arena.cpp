@@ -0,0 +1,165 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+#include "cgra_soa.hpp"
+#include "frame_arena.hpp"
+
+using namespace std;
+
+namespace cgra {
+
+	namespace {
+
+		// The two arenas of one thread, current holds frame's allocations
+		// and the other those of the frame before
+		struct thread_arenas {
+			frame_arena arenas[2];
+			int current = 0;
+			unsigned long frame = 0;
+			bool inUse = false;
+		};
+
+		atomic<unsigned long> g_frame { 0 };
+
+		// Arenas are kept when their thread exits and handed to the next new
+		// thread, so short lived threads do not each cost a pair
+		mutex g_mutex;
+		vector<unique_ptr<thread_arenas>> g_arenas;
+
+		struct thread_slot {
+			thread_arenas *arenas = nullptr;
+
+			~thread_slot() {
+				if (!arenas) return;
+				lock_guard<mutex> lock(g_mutex);
+				arenas->inUse = false;
+			}
+		};
+
+		thread_local thread_slot t_slot;
+
+		thread_arenas & threadArenas() {
+			if (t_slot.arenas) return *t_slot.arenas;
+
+			lock_guard<mutex> lock(g_mutex);
+			for (auto &a : g_arenas) {
+				if (!a->inUse) {
+					t_slot.arenas = a.get();
+					break;
+				}
+			}
+			if (!t_slot.arenas) {
+				g_arenas.emplace_back(new thread_arenas);
+				t_slot.arenas = g_arenas.back().get();
+			}
+
+			thread_arenas &t = *t_slot.arenas;
+			t.inUse = true;
+			t.arenas[0].reset();
+			t.arenas[1].reset();
+			t.frame = g_frame.load(memory_order_relaxed);
+			return t;
+		}
+
+		void printSize(ostream &out, size_t bytes) {
+			out << (bytes + 1023) / 1024 << " KB";
+		}
+	}
+
+
+	frame_arena::frame_arena(size_t capacity) : m_capacity(capacity) {
+		m_data = static_cast<char *>(alignedAlloc(capacity, alignment));
+		m_stats.capacity = capacity;
+	}
+
+
+	frame_arena::~frame_arena() {
+		reset();
+		alignedFree(m_data);
+	}
+
+
+	void * frame_arena::overflow(size_t bytes, size_t align) {
+		m_stats.overflows++;
+		m_overflowBytes += bytes;
+#ifdef CGRA_ARENA_DEBUG
+		if (m_stats.overflows == 1) {
+			cerr << "Warning: frame arena of " << m_capacity << " bytes overflowed by a request of "
+				<< bytes << " bytes, using the heap until the next frame" << endl;
+		}
+		if (m_used + m_overflowBytes > m_stats.highWater) m_stats.highWater = m_used + m_overflowBytes;
+#endif
+		void *p = alignedAlloc(bytes, align);
+		m_overflow.push_back(p);
+		return p;
+	}
+
+
+	void frame_arena::reset() {
+		for (void *p : m_overflow) alignedFree(p);
+		m_overflow.clear();
+		m_overflowBytes = 0;
+		m_used = 0;
+	}
+
+
+	frame_arena::stats frame_arena::statistics() const {
+		stats s = m_stats;
+		s.used = m_used + m_overflowBytes;
+		return s;
+	}
+
+
+	void advanceFrameArenas() {
+		g_frame.fetch_add(1, memory_order_release);
+	}
+
+
+	frame_arena & frameArena() {
+		thread_arenas &t = threadArenas();
+		unsigned long frame = g_frame.load(memory_order_acquire);
+		if (frame != t.frame) {
+			// The other arena holds the frame before the current one (or
+			// older), so nothing in it is still in use
+			t.current = 1 - t.current;
+			t.arenas[t.current].reset();
+			if (frame - t.frame > 1) t.arenas[1 - t.current].reset();
+			t.frame = frame;
+		}
+		return t.arenas[t.current];
+	}
+
+
+	void reportFrameArenas(ostream &out) {
+		lock_guard<mutex> lock(g_mutex);
+		for (size_t i = 0; i < g_arenas.size(); i++) {
+			for (const frame_arena &a : g_arenas[i]->arenas) {
+				frame_arena::stats s = a.statistics();
+				out << "Frame arena (thread " << i << "): ";
+#ifdef CGRA_ARENA_DEBUG
+				out << "high water ";
+				printSize(out, s.highWater);
+				out << " of ";
+#endif
+				printSize(out, s.capacity);
+				out << ", " << s.overflows << " overflows" << endl;
+			}
+		}
+	}
+}
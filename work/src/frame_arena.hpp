@@ -0,0 +1,146 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#pragma once
+
+// Bump allocators for data that only lives for a frame or two, eg. instance
+// lists and scratch arrays, so they cost a pointer increment rather than a
+// trip to the heap.
+//
+// Every thread that calls frameArena() gets a pair of arenas. When the main
+// loop calls advanceFrameArenas(), each thread's next allocation switches
+// to its other arena and resets it. Memory allocated during a frame
+// therefore stays valid until the end of the next frame, so it can be
+// handed to a thread that consumes it a frame later.
+//
+// Nothing in an arena is ever destroyed. alloc<T>() is limited to trivially
+// destructible types, and containers using arena_allocator must not
+// outlive their frame.
+
+#include <cstddef>
+#include <iosfwd>
+#include <type_traits>
+#include <vector>
+
+#ifndef NDEBUG
+#define CGRA_ARENA_DEBUG
+#endif
+
+namespace cgra {
+
+	// One linear arena, reset as a whole. Requests that do not fit fall
+	// back to the heap until the next reset, so running out is slow but
+	// never fatal. Debug builds also track the high water mark and warn on
+	// the first overflow, to size the arenas from real workloads.
+	class frame_arena {
+	public:
+		static const size_t alignment = 64;              // a cache line
+		static const size_t default_capacity = 256 * 1024;
+
+		struct stats {
+			size_t capacity = 0;
+			size_t used = 0;           // since the last reset
+			size_t highWater = 0;      // most used between resets, including overflow (debug builds)
+			unsigned long overflows = 0; // requests that went to the heap
+		};
+
+	private:
+		char *m_data = nullptr;
+		size_t m_capacity = 0;
+		size_t m_used = 0;
+		size_t m_overflowBytes = 0;
+		std::vector<void *> m_overflow; // heap blocks freed on reset
+		stats m_stats;
+
+		void * overflow(size_t bytes, size_t align);
+
+	public:
+		explicit frame_arena(size_t capacity = default_capacity);
+		~frame_arena();
+
+		frame_arena(const frame_arena &) = delete;
+		frame_arena & operator=(const frame_arena &) = delete;
+
+		// Bytes aligned to align (a power of two), alignments over a
+		// cache line are left to the heap
+		void * allocate(size_t bytes, size_t align = alignment) {
+			size_t start = (m_used + align - 1) & ~(align - 1);
+			if (start + bytes > m_capacity || align > alignment) return overflow(bytes, align);
+			m_used = start + bytes;
+#ifdef CGRA_ARENA_DEBUG
+			if (m_used + m_overflowBytes > m_stats.highWater) m_stats.highWater = m_used + m_overflowBytes;
+#endif
+			return m_data + start;
+		}
+
+		// Uninitialized storage for n values of T, aligned to a cache line
+		template <typename T>
+		T * alloc(size_t n) {
+			static_assert(std::is_trivially_destructible<T>::value, "frame_arena never runs destructors");
+			return static_cast<T *>(allocate(n * sizeof(T), alignment < alignof(T) ? alignof(T) : alignment));
+		}
+
+		// Releases everything allocated since the last reset
+		void reset();
+
+		stats statistics() const;
+	};
+
+
+	// Advances every thread's arenas to the next frame, call once per frame
+	// from the main loop
+	void advanceFrameArenas();
+
+	// The calling thread's arena for the current frame
+	frame_arena & frameArena();
+
+	// Prints the statistics of every thread's arenas (eg. at exit)
+	void reportFrameArenas(std::ostream &);
+
+
+	// Allocator for standard containers (eg. std::vector) in a frame arena.
+	// Deallocation is a no-op, the memory is reclaimed when the arena resets.
+	template <typename T>
+	class arena_allocator {
+		template <typename U> friend class arena_allocator;
+		frame_arena *m_arena;
+
+	public:
+		using value_type = T;
+
+		template <typename U>
+		struct rebind { using other = arena_allocator<U>; };
+
+		arena_allocator() : m_arena(&frameArena()) { }
+		explicit arena_allocator(frame_arena &arena) : m_arena(&arena) { }
+
+		template <typename U>
+		arena_allocator(const arena_allocator<U> &other) : m_arena(other.m_arena) { }
+
+		T * allocate(size_t n) {
+			return static_cast<T *>(m_arena->allocate(n * sizeof(T), alignof(T) < frame_arena::alignment ? frame_arena::alignment : alignof(T)));
+		}
+
+		void deallocate(T *, size_t) { }
+
+		template <typename U>
+		bool operator==(const arena_allocator<U> &other) const { return m_arena == other.m_arena; }
+
+		template <typename U>
+		bool operator!=(const arena_allocator<U> &other) const { return m_arena != other.m_arena; }
+	};
+
+	template <typename T>
+	using arena_vector = std::vector<T, arena_allocator<T>>;
+}
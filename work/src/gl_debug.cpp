@@ -0,0 +1,118 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+
+#include "gl_debug.hpp"
+
+using namespace std;
+
+namespace cgra {
+
+	bool parseDebugMode(const string &name, gl_debug_mode &mode) {
+		if (name == "off") mode = gl_debug_mode::off;
+		else if (name == "async") mode = gl_debug_mode::async;
+		else if (name == "sync") mode = gl_debug_mode::sync;
+		else return false;
+		return true;
+	}
+
+
+	gl_debug_log::gl_debug_log() : m_head(0), m_dropped(0) {
+		for (size_t i = 0; i < capacity; i++) {
+			m_slots[i].sequence.store(i, memory_order_relaxed);
+		}
+	}
+
+
+	void gl_debug_log::record(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *text) {
+		// Claim a slot, unless the main thread has not read it yet
+		uint64_t pos = m_head.load(memory_order_relaxed);
+		slot *s;
+		while (true) {
+			s = &m_slots[pos % capacity];
+			int64_t diff = int64_t(s->sequence.load(memory_order_acquire)) - int64_t(pos);
+			if (diff == 0) {
+				if (m_head.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) break;
+			} else if (diff < 0) {
+				m_dropped.fetch_add(1, memory_order_relaxed);
+				return;
+			} else {
+				pos = m_head.load(memory_order_relaxed);
+			}
+		}
+
+		s->source = source;
+		s->type = type;
+		s->id = id;
+		s->severity = severity;
+		// length is negative when the message is only null terminated
+		size_t n = length < 0 ? strlen(text) : size_t(length);
+		n = min(n, max_length - 1);
+		memcpy(s->text, text, n);
+		s->text[n] = '\0';
+
+		s->sequence.store(pos + 1, memory_order_release);
+	}
+
+
+	void gl_debug_log::drain(ostream *out) {
+		while (true) {
+			slot &s = m_slots[m_tail % capacity];
+			if (s.sequence.load(memory_order_acquire) != m_tail + 1) break;
+
+			m_total++;
+			if (s.type == GL_DEBUG_TYPE_PERFORMANCE_ARB) m_performance++;
+
+			auto key = make_tuple(s.source, s.type, s.id);
+			auto it = m_index.find(key);
+			if (it == m_index.end()) {
+				message m;
+				m.source = s.source;
+				m.type = s.type;
+				m.severity = s.severity;
+				m.id = s.id;
+				m.text = s.text;
+				m.count = 1;
+				if (out) *out << "GL debug (id " << m.id << "): " << m.text << endl;
+				m_index[key] = m_messages.size();
+				m_messages.push_back(move(m));
+			} else {
+				m_messages[it->second].count++;
+			}
+
+			// Hand the slot back to the writers for the next lap
+			s.sequence.store(m_tail + capacity, memory_order_release);
+			m_tail++;
+		}
+	}
+
+
+	void gl_debug_log::clear() {
+		m_messages.clear();
+		m_index.clear();
+		m_total = 0;
+		m_performance = 0;
+		m_dropped.store(0, memory_order_relaxed);
+	}
+
+
+	void APIENTRY gl_debug_log::callback(GLenum source, GLenum type, GLuint id, GLenum severity,
+		GLsizei length, const GLchar *text, GLvoid *userParam)
+	{
+		static_cast<gl_debug_log *>(userParam)->record(source, type, id, severity, length, text);
+	}
+}
@@ -0,0 +1,106 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "opengl.hpp"
+
+namespace cgra {
+
+	// How GL debug output is handled, chosen with --gl-debug=
+	//  - off: no callback is installed
+	//  - async: messages are recorded by gl_debug_log, output is not synchronous
+	//  - sync: synchronous output, each message is printed and errors throw
+	//    (so the failing call shows up in a stack trace)
+	enum class gl_debug_mode { off, async, sync };
+
+	// Parses "off", "async" or "sync", returns false for anything else
+	bool parseDebugMode(const std::string &, gl_debug_mode &);
+
+
+	// Collects GL debug messages without stalling the driver.
+	//
+	// The debug callback may be called on any driver thread, so it only
+	// copies the message into a bounded lock-free ring (messages are
+	// dropped when it is full). The main thread drains the ring once per
+	// frame, merging repeats of the same message and counting performance
+	// warnings.
+	class gl_debug_log {
+	public:
+		static const size_t capacity = 256;   // messages between drains
+		static const size_t max_length = 256; // longer messages are truncated
+
+		// A unique message (by source, type and id) and how often it was seen
+		struct message {
+			GLenum source = 0;
+			GLenum type = 0;
+			GLenum severity = 0;
+			GLuint id = 0;
+			std::string text;
+			unsigned long count = 0;
+		};
+
+	private:
+		// Slot i is free to write when its sequence is i, and ready to
+		// read when it is i + 1 (Vyukov's bounded queue)
+		struct slot {
+			std::atomic<uint64_t> sequence;
+			GLenum source, type, severity;
+			GLuint id;
+			char text[max_length];
+		};
+
+		slot m_slots[capacity];
+		std::atomic<uint64_t> m_head;
+		uint64_t m_tail = 0;
+		std::atomic<unsigned long> m_dropped;
+
+		std::vector<message> m_messages; // in the order they were first seen
+		std::map<std::tuple<GLenum, GLenum, GLuint>, size_t> m_index;
+		unsigned long m_total = 0;
+		unsigned long m_performance = 0;
+
+	public:
+		gl_debug_log();
+		gl_debug_log(const gl_debug_log &) = delete;
+		gl_debug_log & operator=(const gl_debug_log &) = delete;
+
+		// Copies a message into the ring, safe to call from any thread
+		void record(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *text);
+
+		// Merges recorded messages into the summary, from the main thread only.
+		// Messages not seen before are also written to out, if given.
+		void drain(std::ostream *out = nullptr);
+
+		// Forgets the summary (not the messages still in the ring)
+		void clear();
+
+		const std::vector<message> & messages() const { return m_messages; }
+		unsigned long total() const { return m_total; }
+		unsigned long performanceWarnings() const { return m_performance; }
+		unsigned long dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+		// Debug callback for async mode, userParam is the gl_debug_log
+		static void APIENTRY callback(GLenum source, GLenum type, GLuint id, GLenum severity,
+			GLsizei length, const GLchar *text, GLvoid *userParam);
+	};
+}
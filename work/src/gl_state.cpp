@@ -0,0 +1,162 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#include "gl_state.hpp"
+
+using namespace std;
+
+namespace cgra {
+
+	gl_state & glState() {
+		static gl_state state;
+		return state;
+	}
+
+
+	bool gl_state::changed(GLuint &shadow, GLuint value) {
+		if (shadow == value) {
+			m_frame.skipped++;
+			return false;
+		}
+		shadow = value;
+		m_frame.issued++;
+		return true;
+	}
+
+
+	GLuint & gl_state::texture2D() {
+		static GLuint untracked;
+		GLuint unit = m_activeTexture - GL_TEXTURE0;
+		if (unit < texture_units) return m_texture2D[unit];
+		untracked = unknown;
+		return untracked;
+	}
+
+
+	void gl_state::invalidate() {
+		m_program = m_vertexArray = m_arrayBuffer = m_activeTexture = unknown;
+		for (GLuint &t : m_texture2D) t = unknown;
+		m_elementBuffers.clear();
+		m_caps.clear();
+	}
+
+
+	void gl_state::useProgram(GLuint program) {
+		if (changed(m_program, program)) glUseProgram(program);
+	}
+
+
+	void gl_state::bindVertexArray(GLuint vao) {
+		if (changed(m_vertexArray, vao)) glBindVertexArray(vao);
+	}
+
+
+	void gl_state::bindBuffer(GLenum target, GLuint buffer) {
+		if (target == GL_ARRAY_BUFFER) {
+			if (changed(m_arrayBuffer, buffer)) glBindBuffer(target, buffer);
+		} else if (target == GL_ELEMENT_ARRAY_BUFFER && m_vertexArray != unknown) {
+			auto it = m_elementBuffers.emplace(m_vertexArray, unknown).first;
+			if (changed(it->second, buffer)) glBindBuffer(target, buffer);
+		} else {
+			m_frame.issued++;
+			glBindBuffer(target, buffer);
+		}
+	}
+
+
+	void gl_state::activeTexture(GLenum unit) {
+		if (changed(m_activeTexture, unit)) glActiveTexture(unit);
+	}
+
+
+	void gl_state::bindTexture(GLenum target, GLuint texture) {
+		if (target == GL_TEXTURE_2D) {
+			if (changed(texture2D(), texture)) glBindTexture(target, texture);
+		} else {
+			m_frame.issued++;
+			glBindTexture(target, texture);
+		}
+	}
+
+
+	void gl_state::setEnabled(GLenum cap, bool enabled) {
+		auto it = m_caps.find(cap);
+		if (it != m_caps.end() && it->second == enabled) {
+			m_frame.skipped++;
+			return;
+		}
+		m_caps[cap] = enabled;
+		m_frame.issued++;
+		if (enabled) glEnable(cap); else glDisable(cap);
+	}
+
+
+	void gl_state::deleteBuffer(GLuint buffer) {
+		if (buffer == 0) return;
+		glDeleteBuffers(1, &buffer);
+		if (m_arrayBuffer == buffer) m_arrayBuffer = 0;
+		// Only the bound vertex array is unbound from it, others are
+		// left pointing at a dead name
+		for (auto &e : m_elementBuffers) {
+			if (e.second == buffer) e.second = (e.first == m_vertexArray) ? 0 : unknown;
+		}
+	}
+
+
+	void gl_state::deleteVertexArray(GLuint vao) {
+		if (vao == 0) return;
+		glDeleteVertexArrays(1, &vao);
+		m_elementBuffers.erase(vao);
+		if (m_vertexArray == vao) m_vertexArray = 0;
+	}
+
+
+	void gl_state::deleteTexture(GLuint texture) {
+		if (texture == 0) return;
+		glDeleteTextures(1, &texture);
+		for (GLuint &t : m_texture2D) {
+			if (t == texture) t = 0;
+		}
+	}
+
+
+	gl_state::snapshot gl_state::save() const {
+		snapshot s;
+		s.program = m_program;
+		s.vertexArray = m_vertexArray;
+		s.arrayBuffer = m_arrayBuffer;
+		auto it = m_elementBuffers.find(m_vertexArray);
+		if (it != m_elementBuffers.end()) s.elementBuffer = it->second;
+		s.activeTexture = m_activeTexture;
+		GLuint unit = m_activeTexture - GL_TEXTURE0;
+		if (unit < texture_units) s.texture2D = m_texture2D[unit];
+		return s;
+	}
+
+
+	void gl_state::restore(const snapshot &s) {
+		if (s.program != unknown) useProgram(s.program);
+		if (s.vertexArray != unknown) bindVertexArray(s.vertexArray);
+		if (s.arrayBuffer != unknown) bindBuffer(GL_ARRAY_BUFFER, s.arrayBuffer);
+		if (s.elementBuffer != unknown) bindBuffer(GL_ELEMENT_ARRAY_BUFFER, s.elementBuffer);
+		if (s.activeTexture != unknown) activeTexture(s.activeTexture);
+		if (s.texture2D != unknown) bindTexture(GL_TEXTURE_2D, s.texture2D);
+	}
+
+
+	void gl_state::endFrame() {
+		m_lastFrame = m_frame;
+		m_frame = bind_stats();
+	}
+}
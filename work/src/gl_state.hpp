@@ -0,0 +1,104 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <map>
+
+#include "opengl.hpp"
+
+namespace cgra {
+
+	// Shadow copy of the GL bindings and capabilities that the renderers
+	// change every frame. Binding through it skips calls that would not
+	// change anything, and lets state be saved and restored without
+	// glGet round trips (which stall on many drivers).
+	//
+	// Values start out unknown, so the first bind is always issued. Code
+	// that changes tracked state behind its back (eg. GUI callbacks) must
+	// call invalidate afterwards.
+	class gl_state {
+	public:
+		static const GLuint unknown = GLuint(-1);
+		static const int texture_units = 16;
+
+		// Tracked bindings, as returned by save
+		struct snapshot {
+			GLuint program = unknown;
+			GLuint vertexArray = unknown;
+			GLuint arrayBuffer = unknown;
+			GLuint elementBuffer = unknown;
+			GLenum activeTexture = unknown;
+			GLuint texture2D = unknown; // on the active unit
+		};
+
+		struct bind_stats {
+			unsigned long issued = 0;
+			unsigned long skipped = 0;
+		};
+
+	private:
+		GLuint m_program = unknown;
+		GLuint m_vertexArray = unknown;
+		GLuint m_arrayBuffer = unknown;
+		GLenum m_activeTexture = unknown;
+		GLuint m_texture2D[texture_units];
+
+		// The element buffer binding belongs to the vertex array
+		std::map<GLuint, GLuint> m_elementBuffers;
+		std::map<GLenum, bool> m_caps;
+
+		bind_stats m_frame;
+		bind_stats m_lastFrame;
+
+		bool changed(GLuint &shadow, GLuint value);
+		GLuint & texture2D();
+
+	public:
+		gl_state() { invalidate(); }
+		gl_state(const gl_state &) = delete;
+		gl_state & operator=(const gl_state &) = delete;
+
+		// Forgets everything, so the next binds are issued
+		void invalidate();
+
+		void useProgram(GLuint);
+		void bindVertexArray(GLuint);
+		void bindBuffer(GLenum target, GLuint);
+		void activeTexture(GLenum unit);
+		void bindTexture(GLenum target, GLuint);
+		void enable(GLenum cap) { setEnabled(cap, true); }
+		void disable(GLenum cap) { setEnabled(cap, false); }
+		void setEnabled(GLenum cap, bool);
+
+		// Deleting an object unbinds it, these keep the shadow in step
+		void deleteBuffer(GLuint);
+		void deleteVertexArray(GLuint);
+		void deleteTexture(GLuint);
+
+		// Saves and restores the tracked bindings from the shadow copy.
+		// Bindings that are unknown when saved are left as they are.
+		snapshot save() const;
+		void restore(const snapshot &);
+
+		// Binds issued and skipped since the last call to endFrame, and
+		// in the frame before it
+		bind_stats frameStats() const { return m_frame; }
+		bind_stats lastFrameStats() const { return m_lastFrame; }
+		void endFrame();
+	};
+
+	// State of the (single) GL context
+	gl_state & glState();
+}
@@ -12,16 +12,30 @@
 //
 //----------------------------------------------------------------------------
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
+#include <ctime>
 #include <iostream>
 #include <string>
 #include <stdexcept>
+#include <vector>
 
+#include "animation_clock.hpp"
+#include "animator.hpp"
+#include "benchmark.hpp"
 #include "cgra_math.hpp"
 #include "cgra_geometry.hpp"
+#include "frame_arena.hpp"
+#include "gl_debug.hpp"
+#include "gl_state.hpp"
+#include "profiler.hpp"
 #include "opengl.hpp"
+#include "shader_cache.hpp"
 #include "simple_gui.hpp"
+#include "skeleton.hpp"
+#include "skeleton_renderer.hpp"
+#include "timeline.hpp"
 
 using namespace std;
 using namespace cgra;
@@ -37,6 +51,12 @@ float g_fovy = 20.0;
 float g_znear = 0.001;
 float g_zfar = 1000.0;
 
+// CPU copies of the camera matrices and viewport, set by setupCamera
+// so nothing has to read them back from GL
+mat4 g_projection;
+mat4 g_view;
+GLint g_viewport[4] = { 0, 0, 1, 1 };
+
 
 // Mouse controlled Camera values
 //
@@ -53,11 +73,96 @@ float g_zoom = 1.0;
 // vector of points
 vector<vec2> points;
 
+
+// Skeleton and its renderer
+//
+Skeleton *g_skeleton = nullptr;
+SkeletonRenderer g_skeletonRenderer;
+
+
+// Animation playback
+// The clock steps at a fixed rate independent of the display,
+// poses are evaluated on the animator's thread
+//
+Animator *g_animator = nullptr;
+AnimationClock g_clock;
+float g_requestedFrame = -1;
+Timeline g_timeline;
+
+
+// Timing of the animation thread against the main thread (ms),
+// kept for the last timing_history frames
+//
+const int timing_history = 120;
+float g_evalTimes[timing_history] = { 0 };
+float g_submitTimes[timing_history] = { 0 };
+float g_overlapTimes[timing_history] = { 0 };
+int g_timingOffset = 0;
+double g_submitStart = 0;
+double g_submitEnd = 0;
+
+
+// Redraw tracking
+// The window is only redrawn when something has changed (input, resizing,
+// a new pose or active playback), otherwise the loop sleeps in glfwWaitEvents
+//
+const int redraw_frames_after_input = 3; // lets IMGUI settle after input
+int g_redrawFrames = 1;
+unsigned long g_wakeups = 0;
+double g_idleTime = 0;    // Seconds spent waiting for events
+double g_idleCPUTime = 0; // Process CPU seconds used while waiting
+
+
+// Startup timing, seconds since glfwInit until the first frame was
+// presented and until the impostor shaders were ready (-1 if not yet)
+//
+double g_firstFrameTime = -1;
+double g_shadersReadyTime = -1;
+
+
+// GL debug output
+// In async mode messages are collected by the log and shown in a panel
+//
+gl_debug_mode g_debugMode = gl_debug_mode::async;
+gl_debug_log g_debugLog;
+
+
+// Trace recording
+// Written on exit when started with --trace=path, and on demand with F9
+//
+string g_tracePath;
+
+void writeTrace() {
+#ifdef CGRA_PROFILER
+	string path = g_tracePath.empty() ? "trace.json" : g_tracePath;
+	if (!traceRecorder().enabled()) {
+		// Nothing recorded yet, start now so the next F9 has something to write
+		traceRecorder().setEnabled(true);
+		cout << "Trace recording started" << endl;
+	} else if (traceRecorder().write(path)) {
+		cout << "Wrote " << traceRecorder().eventCount() << " trace events to " << path << endl;
+	} else {
+		cerr << "Error: Could not write trace to " << path << endl;
+	}
+#endif
+}
+
+const char * getStringForSource(GLenum source);
+const char * getStringForType(GLenum type);
+
+
+// Marks the window as needing to be redrawn
+//
+void damage(int frames = redraw_frames_after_input) {
+	g_redrawFrames = max(g_redrawFrames, frames);
+}
+
 // Mouse Button callback
 // Called for mouse movement event on since the last glfwPollEvents
 //
 void cursorPosCallback(GLFWwindow* win, double xpos, double ypos) {
 	// cout << "Mouse Movement Callback :: xpos=" << xpos << "ypos=" << ypos << endl;
+	damage();
 	if (g_leftMouseDown) {
 		g_yaw -= g_mousePosition.x - xpos;
 		g_pitch -= g_mousePosition.y - ypos;
@@ -72,6 +177,7 @@ void cursorPosCallback(GLFWwindow* win, double xpos, double ypos) {
 //
 void mouseButtonCallback(GLFWwindow *win, int button, int action, int mods) {
 	 cout << "Mouse Button Callback :: button=" << button << "action=" << action << "mods=" << mods << endl;
+	damage();
 	// send messages to the GUI manually
 	SimpleGUI::mouseButtonCallback(win, button, action, mods);
 
@@ -93,6 +199,7 @@ void mouseButtonCallback(GLFWwindow *win, int button, int action, int mods) {
 //
 void scrollCallback(GLFWwindow *win, double xoffset, double yoffset) {
 	// cout << "Scroll Callback :: xoffset=" << xoffset << "yoffset=" << yoffset << endl;
+	damage();
 	g_zoom -= yoffset * g_zoom * 0.2;
 }
 
@@ -109,8 +216,22 @@ void scrollCallback(GLFWwindow *win, double xoffset, double yoffset) {
 void keyCallback(GLFWwindow *win, int key, int scancode, int action, int mods) {
 	// cout << "Key Callback :: key=" << key << "scancode=" << scancode
 	// 	<< "action=" << action << "mods=" << mods << endl;
+	damage();
 	// YOUR CODE GOES HERE
 	// ...
+
+	// Toggle between tessellated and impostor skeleton rendering
+	if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+		if (g_skeletonRenderer.mode() == render_mode::tessellated)
+			g_skeletonRenderer.setMode(render_mode::impostor);
+		else
+			g_skeletonRenderer.setMode(render_mode::tessellated);
+	}
+
+	// Write (or start) the trace
+	if (key == GLFW_KEY_F9 && action == GLFW_PRESS) {
+		writeTrace();
+	}
 }
 
 
@@ -120,6 +241,23 @@ void keyCallback(GLFWwindow *win, int key, int scancode, int action, int mods) {
 void charCallback(GLFWwindow *win, unsigned int c) {
 	// cout << "Char Callback :: c=" << char(c) << endl;
 	// Not needed for this assignment, but useful to have later on
+	damage();
+}
+
+
+// Framebuffer size callback
+// Called when the window is resized
+//
+void framebufferSizeCallback(GLFWwindow *, int, int) {
+	damage();
+}
+
+
+// Window refresh callback
+// Called when the window contents were lost (eg. uncovered)
+//
+void windowRefreshCallback(GLFWwindow *) {
+	damage();
 }
 
 
@@ -139,44 +277,51 @@ void setupLight() {
 	glLightfv(GL_LIGHT0, GL_DIFFUSE,  diffuse.dataPointer());
 	glLightfv(GL_LIGHT0, GL_AMBIENT,  ambient.dataPointer());
 	
-	glEnable(GL_LIGHT0);
+	glState().enable(GL_LIGHT0);
 }
 
 
 // Sets up where the camera is in the scene
 // 
 void setupCamera(int width, int height) {
-	// Set up the projection matrix
+	g_viewport[2] = width;
+	g_viewport[3] = height;
+
+	// Set up the projection matrix (as gluPerspective)
+	float f = 1 / std::tan(radians(g_fovy) / 2);
+	g_projection = mat4(0);
+	g_projection[0][0] = f / (width / float(height));
+	g_projection[1][1] = f;
+	g_projection[2][2] = (g_zfar + g_znear) / (g_znear - g_zfar);
+	g_projection[3][2] = (2 * g_zfar * g_znear) / (g_znear - g_zfar);
+	g_projection[2][3] = -1;
 	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	gluPerspective(g_fovy, width / float(height), g_znear, g_zfar);
+	glLoadMatrixf(g_projection.dataPointer());
+	setLodProjection(g_projection, height);
 
 	// Set up the view part of the model view matrix
+	g_view = mat4::translate(0, 0, -5 * g_zoom) * mat4::rotateX(radians(g_pitch)) * mat4::rotateY(radians(g_yaw));
 	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
-
-	glTranslatef(0, 0, -5 * g_zoom);
-	glRotatef(g_pitch, 1, 0, 0);
-	glRotatef(g_yaw, 0, 1, 0);
+	glLoadMatrixf(g_view.dataPointer());
 }
 
 
 vec3 getWorldPos(vec2 pos){
-	GLint viewport[4];
+    // Unprojects at a fixed depth, from the camera's CPU-side matrices
     GLdouble modelview[16];
     GLdouble projection[16];
-    GLfloat winX, winY, winZ;
+    GLfloat winX, winY;
     GLdouble posX, posY, posZ;
- 
-    glGetDoublev( GL_MODELVIEW_MATRIX, modelview );
-    glGetDoublev( GL_PROJECTION_MATRIX, projection );
-    glGetIntegerv( GL_VIEWPORT, viewport );
- 
+
+    for (int i = 0; i < 16; i++) {
+        modelview[i] = g_view[i / 4][i % 4];
+        projection[i] = g_projection[i / 4][i % 4];
+    }
+
     winX = (float)pos.x;
-    winY = (float)viewport[3] - (float)pos.y;
-    glReadPixels( (int)winX, int(winY), 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &winZ );
- 
-    gluUnProject( winX, winY, 0.9f, modelview, projection, viewport, &posX, &posY, &posZ);
+    winY = (float)g_viewport[3] - (float)pos.y;
+
+    gluUnProject( winX, winY, 0.9f, modelview, projection, g_viewport, &posX, &posY, &posZ);
     return vec3(posX, posY, posZ);
 }
 
@@ -184,6 +329,8 @@ vec3 getWorldPos(vec2 pos){
 // Render one frame to the current window given width and height
 //
 void render(int width, int height) {
+	CGRA_PROFILE_SCOPE("Render");
+	CGRA_PROFILE_GPU("Scene");
 
 	// Set viewport to be the whole window
 	glViewport(0, 0, width, height);
@@ -199,10 +346,12 @@ void render(int width, int height) {
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	// Enable flags for normal rendering
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_LIGHTING);
-	glEnable(GL_NORMALIZE);
-	glEnable(GL_COLOR_MATERIAL);
+	gl_state &state = glState();
+	state.enable(GL_DEPTH_TEST);
+	state.enable(GL_LIGHTING);
+	state.enable(GL_NORMALIZE);
+	state.enable(GL_COLOR_MATERIAL);
+	state.useProgram(0);
 
 
 	// Render geometry
@@ -211,15 +360,20 @@ void render(int width, int height) {
 		glPushMatrix();
 		glTranslatef(pos.x, pos.y, pos.z);
 		//cout << pos.x << " " << pos.y << " " << pos.z << endl;
-		cgraSphere(0.00005);
+		cgraSphereLOD(0.00005, g_view * mat4::translate(pos));
 		glPopMatrix();
 	}
 
+	// Draw the skeleton with the latest pose from the animator
+	if (g_animator && !g_animator->current().world.empty()) {
+		g_skeletonRenderer.render(*g_skeleton, g_animator->current().world, g_view);
+	}
+
 	// Disable flags for cleanup (optional)
-	glDisable(GL_DEPTH_TEST);
-	glDisable(GL_LIGHTING);
-	glDisable(GL_NORMALIZE);
-	glDisable(GL_COLOR_MATERIAL);
+	state.disable(GL_DEPTH_TEST);
+	state.disable(GL_LIGHTING);
+	state.disable(GL_NORMALIZE);
+	state.disable(GL_COLOR_MATERIAL);
 }
 
 
@@ -242,6 +396,8 @@ void render(int width, int height) {
 // Renders IMGUI ontop of your render output
 //
 void renderGUI() {
+	CGRA_PROFILE_SCOPE("GUI");
+
 	// Start registering GUI components
 	SimpleGUI::newFrame();
 
@@ -250,44 +406,141 @@ void renderGUI() {
 
 	if (ImGui::BeginPopup("Player")) {
 		if (ImGui::Selectable("Play")) {
-			// YOUR CODE GOES HERE
-			// ...
-
+			g_clock.play();
 		}
 
 		if (ImGui::Selectable("Pause")) {
-			// YOUR CODE GOES HERE
-			// ...
-
+			g_clock.pause();
 		}
 
 		if (ImGui::Selectable("Stop")) {
-			// YOUR CODE GOES HERE
-			// ...
-
+			g_clock.stop();
 		}
 
 		if (ImGui::Selectable("Rewind")) {
-			// YOUR CODE GOES HERE
-			// ...
-
+			g_clock.rewind();
 		}
 
 		if (ImGui::Selectable("Fast Forward")) {
-			// YOUR CODE GOES HERE
-			// ...
-
+			g_clock.fastForward();
 		}
 
 		ImGui::EndPopup();
 	}
 
+	// Skeleton renderer settings
+	if (g_skeleton) {
+		ImGui::Begin("Renderer");
+		int mode = int(g_skeletonRenderer.mode());
+		ImGui::RadioButton("Tessellated", &mode, int(render_mode::tessellated));
+		if (g_skeletonRenderer.impostorsSupported()) {
+			ImGui::RadioButton("Impostor", &mode, int(render_mode::impostor));
+		} else {
+			ImGui::TextDisabled("Impostors not supported");
+		}
+		g_skeletonRenderer.setMode(render_mode(mode));
+		if (g_skeletonRenderer.mode() == render_mode::impostor && !g_skeletonRenderer.impostorsReady())
+			ImGui::TextDisabled("Compiling impostor shaders...");
+		ImGui::Text("Vertices submitted: %lu", g_skeletonRenderer.verticesSubmitted());
+		gl_state::bind_stats binds = glState().lastFrameStats();
+		ImGui::Text("State changes: %lu issued, %lu skipped", binds.issued, binds.skipped);
+		ImGui::End();
+	}
+
+	// Scrubbing seeks the clock, the animator picks up the new frame next loop
+	if (g_skeleton && g_skeleton->frameCount() > 0) {
+		ImGui::Begin("Timeline");
+		float frame = float(g_clock.frame());
+		if (g_timeline.draw(frame)) g_clock.seek(frame);
+		ImGui::End();
+	}
+
+	ImGui::Begin("Timing");
+
+	if (g_firstFrameTime >= 0) ImGui::Text("First frame after %.3f s", g_firstFrameTime);
+	if (g_shadersReadyTime >= 0) ImGui::Text("Shaders ready after %.3f s", g_shadersReadyTime);
+
+	// Time spent asleep waiting for events and the CPU used meanwhile,
+	// which should stay near zero
+	ImGui::Text("Idle %.1f s, %lu wakeups, CPU %.2f%%", g_idleTime, g_wakeups,
+		g_idleTime > 0 ? 100 * g_idleCPUTime / g_idleTime : 0.0);
+
+	// Animation thread timing
+	// Overlap is how much of the evaluation ran while the main thread was submitting
+	if (g_animator) {
+		int last = (g_timingOffset + timing_history - 1) % timing_history;
+		ImGui::Text("Frame %.1f / %d at %gx (%.0f Hz steps, %lu dropped)", g_clock.frame(), g_clock.length(),
+			g_clock.speed(), g_clock.stepRate(), g_clock.droppedSteps());
+		ImGui::PlotLines("Animation (ms)", g_evalTimes, timing_history, g_timingOffset);
+		ImGui::PlotLines("Submit (ms)", g_submitTimes, timing_history, g_timingOffset);
+		ImGui::PlotLines("Overlap (ms)", g_overlapTimes, timing_history, g_timingOffset);
+		ImGui::Text("Animation %.3f ms, submit %.3f ms, overlap %.3f ms",
+			g_evalTimes[last], g_submitTimes[last], g_overlapTimes[last]);
+	}
+
+	ImGui::End();
+
+	// GL debug messages, merged by id
+	if (g_debugMode == gl_debug_mode::async) {
+		g_debugLog.drain(&cerr);
+
+		ImGui::Begin("GL Debug");
+		ImGui::Text("%lu messages (%lu unique), %lu performance warnings, %lu dropped",
+			g_debugLog.total(), (unsigned long) g_debugLog.messages().size(),
+			g_debugLog.performanceWarnings(), g_debugLog.dropped());
+		if (ImGui::Button("Clear")) g_debugLog.clear();
+		for (const gl_debug_log::message &m : g_debugLog.messages()) {
+			ImGui::Separator();
+			ImGui::Text("%s, %s, id %u: x%lu", getStringForType(m.type),
+				getStringForSource(m.source), m.id, m.count);
+			ImGui::TextWrapped("%s", m.text.c_str());
+		}
+		ImGui::End();
+	}
+
+	// Keep drawing while IMGUI is animating (eg. a blinking text cursor)
+	if (ImGui::GetIO().WantTextInput || ImGui::IsAnyItemActive())
+		damage(1);
+
+#ifdef CGRA_PROFILER
+	frameProfiler().drawWindow();
+#endif
+
 	// Flush components and render
+	CGRA_PROFILE_SCOPE("GUI submit");
+	CGRA_PROFILE_GPU("GUI");
 	SimpleGUI::render();
 }
 
 
 
+// Records how the evaluation of a pose lined up with the main thread's
+// submission of the previous frame
+//
+void recordTiming(const pose_snapshot &snapshot) {
+	double overlap = min(snapshot.evalEnd, g_submitEnd) - max(snapshot.evalStart, g_submitStart);
+	g_evalTimes[g_timingOffset] = float(1000 * (snapshot.evalEnd - snapshot.evalStart));
+	g_submitTimes[g_timingOffset] = float(1000 * (g_submitEnd - g_submitStart));
+	g_overlapTimes[g_timingOffset] = float(1000 * max(overlap, 0.0));
+	g_timingOffset = (g_timingOffset + 1) % timing_history;
+}
+
+
+// Sleeps until the next event, accounting for the idle time
+// and the CPU time used by the whole process meanwhile
+//
+void waitEvents() {
+	clock_t cpuStart = clock();
+	double start = glfwGetTime();
+
+	glfwWaitEvents();
+
+	g_idleCPUTime += double(clock() - cpuStart) / CLOCKS_PER_SEC;
+	g_idleTime += glfwGetTime() - start;
+	g_wakeups++;
+}
+
+
 // Forward decleration for cleanliness (Ignore)
 void APIENTRY debugCallbackARB(GLenum, GLenum, GLuint, GLenum, GLsizei, const GLchar*, GLvoid*);
 
@@ -296,6 +549,38 @@ void APIENTRY debugCallbackARB(GLenum, GLenum, GLuint, GLenum, GLsizei, const GL
 // 
 int main(int argc, char **argv) {
 
+	CGRA_TRACE_THREAD("Main");
+
+	// Options start with --, the other arguments are the skeleton and motion files
+	// (or --bench and the benchmark name)
+	vector<string> files;
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg.compare(0, 8, "--trace=") == 0) {
+			g_tracePath = arg.substr(8);
+#ifdef CGRA_PROFILER
+			traceRecorder().setEnabled(true);
+#else
+			cerr << "Warning: --trace needs a build with CGRA_PROFILER" << endl;
+#endif
+			continue;
+		}
+		if (arg.compare(0, 11, "--gl-debug=") == 0) {
+			if (!parseDebugMode(arg.substr(11), g_debugMode)) {
+				cerr << "Error: --gl-debug must be off, async or sync" << endl;
+				return EXIT_FAILURE;
+			}
+		} else {
+			files.push_back(arg);
+		}
+	}
+
+	// Run the benchmarks instead of the viewer
+	if (!files.empty() && files[0] == "--bench") {
+		bool passed = Benchmark::run(files.size() > 1 ? files[1] : "");
+		if (!g_tracePath.empty()) writeTrace();
+		return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
 
 	// Initialize the GLFW library
 	if (!glfwInit()) {
@@ -344,17 +629,30 @@ int main(int argc, char **argv) {
 	glfwSetScrollCallback(g_window, scrollCallback);
 	glfwSetKeyCallback(g_window, keyCallback);
 	glfwSetCharCallback(g_window, charCallback);
+	glfwSetFramebufferSizeCallback(g_window, framebufferSizeCallback);
+	glfwSetWindowRefreshCallback(g_window, windowRefreshCallback);
+
+	// Wake the main loop when a shader file changes or a build may be done
+	fileWatcher().setCallback(glfwPostEmptyEvent);
 
 
 
 	// Enable GL_ARB_debug_output if available. Not nessesary, just helpful
-	if (glfwExtensionSupported("GL_ARB_debug_output")) {
-		// This allows the error location to be determined from a stacktrace
-		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
-		// Set the up callback
-		glDebugMessageCallbackARB(debugCallbackARB, nullptr);
+	if (g_debugMode == gl_debug_mode::off) {
+		cout << "GL debug output disabled" << endl;
+	} else if (glfwExtensionSupported("GL_ARB_debug_output")) {
+		if (g_debugMode == gl_debug_mode::sync) {
+			// This allows the error location to be determined from a stacktrace
+			glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+			glDebugMessageCallbackARB(debugCallbackARB, nullptr);
+		} else {
+			// Let the driver report from wherever it likes, the log is
+			// drained once per frame
+			glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+			glDebugMessageCallbackARB(gl_debug_log::callback, &g_debugLog);
+		}
 		glDebugMessageControlARB(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, true);
-		cout << "GL_ARB_debug_output callback installed" << endl;
+		cout << "GL_ARB_debug_output callback installed (" << (g_debugMode == gl_debug_mode::sync ? "sync" : "async") << ")" << endl;
 	} else {
 		cout << "GL_ARB_debug_output not available. No worries." << endl;
 	}
@@ -371,27 +669,104 @@ int main(int argc, char **argv) {
 	}
 
 
+	// Load the skeleton given as the first argument, and the
+	// motion given as the second argument, if any
+	if (files.size() > 0) {
+		{
+			CGRA_PROFILE_SCOPE("Load");
+			g_skeleton = new Skeleton(files[0]);
+			if (files.size() > 1) g_skeleton->readAMC(files[1]);
+		}
+		g_skeletonRenderer.init();
+		g_clock.setLength(g_skeleton->frameCount());
+		// wake the main loop when the timeline plots and each new pose are ready
+		g_timeline.setSkeleton(g_skeleton, glfwPostEmptyEvent);
+		g_animator = new Animator(g_skeleton, glfwPostEmptyEvent);
+	}
+
+
 	// Loop until the user closes the window
 	while (!glfwWindowShouldClose(g_window)) {
 
+		// Pick up the pose evaluated while the last frame was submitted
+		// and start evaluating the next one while this one is submitted
+		if (g_animator) {
+			if (g_animator->acquire()) {
+				recordTiming(g_animator->current());
+				damage(1);
+			}
+
+			g_clock.update(glfwGetTime());
+			float frame = float(g_clock.frame());
+			if (frame != g_requestedFrame) {
+				g_animator->request(frame);
+				g_requestedFrame = frame;
+			}
+		}
+
+		// Show the timeline plots once the builder has finished
+		if (g_timeline.acquire()) damage(1);
+
+		// Finish background shader builds, and pick up edited shaders
+		if (g_skeleton) {
+			if (g_skeletonRenderer.update()) damage(1);
+			if (g_shadersReadyTime < 0 && g_skeletonRenderer.impostorsReady()) {
+				g_shadersReadyTime = glfwGetTime();
+				cout << "Shaders ready after " << g_shadersReadyTime << " s" << endl;
+			}
+		}
+
+		// Nothing has changed, sleep until something does
+		if (g_redrawFrames == 0 && !g_clock.playing()) {
+			waitEvents();
+			continue;
+		}
+		if (g_redrawFrames > 0) g_redrawFrames--;
+
 		// Make sure we draw to the WHOLE window
 		int width, height;
 		glfwGetFramebufferSize(g_window, &width, &height);
 
+		advanceFrameArenas();
+		CGRA_PROFILE_FRAME_BEGIN();
+		g_submitStart = Animator::now();
+
 		// Main Render
 		render(width, height);
 
 		// Render GUI on top
 		renderGUI();
+		glState().endFrame();
+
+		g_submitEnd = Animator::now();
 
 		// Swap front and back buffers
-		glfwSwapBuffers(g_window);
+		{
+			CGRA_PROFILE_SCOPE("Swap");
+			glfwSwapBuffers(g_window);
+		}
+		if (g_firstFrameTime < 0) {
+			g_firstFrameTime = glfwGetTime();
+			cout << "First frame after " << g_firstFrameTime << " s" << endl;
+		}
+		CGRA_TRACE_COUNTER("Vertices submitted", g_skeletonRenderer.verticesSubmitted());
+		CGRA_PROFILE_FRAME_END();
 
 		// Poll for and process events
 		glfwPollEvents();
 	}
 
+	delete g_animator;
+	g_timeline.setSkeleton(nullptr);
+	delete g_skeleton;
+	fileWatcher().setCallback(nullptr);
 	glfwTerminate();
+
+#ifdef CGRA_ARENA_DEBUG
+	reportFrameArenas(cout);
+#endif
+
+	if (!g_tracePath.empty()) writeTrace();
 }
 
 
@@ -404,7 +779,7 @@ int main(int argc, char **argv) {
 //-------------------------------------------------------------
 
 // function to translate source to string
-string getStringForSource(GLenum source) {
+const char * getStringForSource(GLenum source) {
 
 	switch(source) {
 		case GL_DEBUG_SOURCE_API: 
@@ -425,7 +800,7 @@ string getStringForSource(GLenum source) {
 }
 
 // function to translate severity to string
-string getStringForSeverity(GLenum severity) {
+const char * getStringForSeverity(GLenum severity) {
 
 	switch(severity) {
 		case GL_DEBUG_SEVERITY_HIGH: 
@@ -440,7 +815,7 @@ string getStringForSeverity(GLenum severity) {
 }
 
 // function to translate type to string
-string getStringForType(GLenum type) {
+const char * getStringForType(GLenum type) {
 	switch(type) {
 		case GL_DEBUG_TYPE_ERROR: 
 			return("Error");
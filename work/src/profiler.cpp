@@ -0,0 +1,280 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#include "profiler.hpp"
+
+#ifdef CGRA_PROFILER
+
+#include <algorithm>
+#include <cstdint>
+
+#include "imgui.h"
+
+using namespace std;
+
+namespace cgra {
+
+	namespace {
+		// Depth of the open CPU scopes on this thread
+		thread_local int t_depth = 0;
+
+		// Stable color for a scope name (FNV-1a, no string copy)
+		float nameHue(const char *name) {
+			uint32_t h = 2166136261u;
+			for (; *name; name++) h = (h ^ uint8_t(*name)) * 16777619u;
+			return float(h % 360) / 360;
+		}
+	}
+
+
+	frame_profiler & frameProfiler() {
+		static frame_profiler profiler;
+		return profiler;
+	}
+
+
+	cpu_profile_scope::cpu_profile_scope(const char *name) : m_name(name), m_depth(t_depth++) {
+		traceRecorder().begin(name);
+		m_start = frameProfiler().now();
+	}
+
+
+	cpu_profile_scope::~cpu_profile_scope() {
+		traceRecorder().end(m_name);
+		t_depth--;
+		frame_profiler &profiler = frameProfiler();
+		profiler.addCPU(m_name, m_start, profiler.now(), m_depth);
+	}
+
+
+	void frame_profiler::series::add(float ms) {
+		if (samples.empty()) samples.reserve(history);
+		if (int(samples.size()) < history) {
+			samples.push_back(ms);
+		} else {
+			samples[next] = ms;
+		}
+		next = (next + 1) % history;
+		last = ms;
+	}
+
+
+	float frame_profiler::series::percentile(float p) const {
+		if (samples.empty()) return 0;
+		sorted.assign(samples.begin(), samples.end());
+		size_t k = min(sorted.size() - 1, size_t(p * sorted.size()));
+		nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+		return sorted[k];
+	}
+
+
+	void frame_profiler::addCPU(const char *name, double start, double end, int depth) {
+		record r;
+		r.name = name;
+		r.start = start;
+		r.end = end;
+		r.depth = depth;
+		r.thread = (this_thread::get_id() == m_mainThread) ? 0 : 1;
+		lock_guard<mutex> lock(m_mutex);
+		m_records.push_back(r);
+	}
+
+
+	void frame_profiler::beginFrame() {
+		m_frameStart = now();
+		m_frameAllocs = allocCounts();
+
+		if (!m_gpuChecked) {
+			m_gpuChecked = true;
+			m_gpuSupported = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+		}
+
+		// The slot this frame reuses was last written gpu_latency frames ago
+		gpu_frame &slot = m_gpuFrames[m_gpuFrame];
+		if (slot.pending) resolveGPU(slot);
+		slot.records.clear();
+		slot.pending = false;
+		m_gpuDepth = 0;
+	}
+
+
+	void frame_profiler::endFrame() {
+		double end = now();
+
+		// Swapping keeps the capacity of both lists
+		m_lastFrame.clear();
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_lastFrame.swap(m_records);
+		}
+
+		// Scopes that ran more than once in the frame are summed
+		sumByName(m_lastFrame);
+		for (auto &t : m_totals) m_series[t.first].add(float(1000 * t.second));
+		for (record &r : m_lastFrame) {
+			r.start -= m_frameStart;
+			r.end -= m_frameStart;
+		}
+		m_lastFrameLength = end - m_frameStart;
+
+		m_lastAllocs = allocCounts() - m_frameAllocs;
+		m_allocSeries.add(float(m_lastAllocs.allocations));
+
+		gpu_frame &slot = m_gpuFrames[m_gpuFrame];
+		slot.pending = !slot.records.empty();
+		m_gpuFrame = (m_gpuFrame + 1) % gpu_latency;
+	}
+
+
+	int frame_profiler::beginGPU(const char *name) {
+		if (!m_gpuSupported) return -1;
+
+		gpu_frame &slot = m_gpuFrames[m_gpuFrame];
+		int index = int(slot.records.size());
+		if (slot.queries.size() < size_t(2 * index + 2)) {
+			size_t first = slot.queries.size();
+			slot.queries.resize(2 * index + 2);
+			glGenQueries(GLsizei(slot.queries.size() - first), &slot.queries[first]);
+		}
+
+		record r;
+		r.name = name;
+		r.start = 2 * index;
+		r.end = 2 * index + 1;
+		r.depth = m_gpuDepth++;
+		r.thread = -1;
+		slot.records.push_back(r);
+
+		glQueryCounter(slot.queries[2 * index], GL_TIMESTAMP);
+		return index;
+	}
+
+
+	void frame_profiler::endGPU(int index) {
+		if (index < 0) return;
+		m_gpuDepth--;
+		glQueryCounter(m_gpuFrames[m_gpuFrame].queries[2 * index + 1], GL_TIMESTAMP);
+	}
+
+
+	void frame_profiler::resolveGPU(gpu_frame &slot) {
+		// Queries complete in order, so the last one tells us about the rest
+		GLint available = 0;
+		GLuint last = slot.queries[2 * slot.records.size() - 1];
+		glGetQueryObjectiv(last, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) return;
+
+		GLuint64 origin = 0;
+		glGetQueryObjectui64v(slot.queries[0], GL_QUERY_RESULT, &origin);
+
+		for (record &r : slot.records) {
+			GLuint64 start = 0, end = 0;
+			glGetQueryObjectui64v(slot.queries[size_t(r.start)], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(slot.queries[size_t(r.end)], GL_QUERY_RESULT, &end);
+			r.start = (start - origin) * 1e-9;
+			r.end = (end - origin) * 1e-9;
+		}
+		sumByName(slot.records);
+		for (auto &t : m_totals) m_gpuSeries[t.first].add(float(1000 * t.second));
+		m_lastGPU = slot.records;
+	}
+
+
+	void frame_profiler::sumByName(const vector<record> &records) {
+		// A frame has a handful of distinct scopes, a linear search beats a map
+		m_totals.clear();
+		for (const record &r : records) {
+			auto it = find_if(m_totals.begin(), m_totals.end(), [&](const pair<const char *, double> &t) { return t.first == r.name; });
+			if (it == m_totals.end()) {
+				m_totals.emplace_back(r.name, r.end - r.start);
+			} else {
+				it->second += r.end - r.start;
+			}
+		}
+	}
+
+
+	void frame_profiler::drawWindow() {
+		ImGui::Begin("Profiler");
+		ImGui::Text("Frame %.2f ms", 1000 * m_lastFrameLength);
+		if (allocTrackingEnabled()) {
+			ImGui::Text("Heap: %llu allocations, %llu frees, %llu bytes (p99 %.0f allocations)",
+				m_lastAllocs.allocations, m_lastAllocs.frees, m_lastAllocs.bytes, m_allocSeries.percentile(0.99f));
+		} else {
+			ImGui::TextDisabled("Heap: allocation tracking off (CGRA_ALLOC_TRACKING)");
+		}
+
+		// Flame graph of the last frame: main thread, other threads, then the GPU
+		ImDrawList *drawList = ImGui::GetWindowDrawList();
+		ImVec2 pos = ImGui::GetCursorScreenPos();
+		float width = max(ImGui::GetContentRegionAvailWidth(), 1.f);
+		float rowHeight = ImGui::GetTextLineHeight() + 2;
+		float y = pos.y;
+
+		auto drawRows = [&](const vector<record> &records, int thread, double length) {
+			int rows = 0;
+			for (const record &r : records) {
+				if (r.thread == thread) rows = max(rows, r.depth + 1);
+			}
+			if (rows == 0 || length <= 0) return;
+
+			for (const record &r : records) {
+				if (r.thread != thread) continue;
+				float x0 = pos.x + float(max(0.0, r.start) / length) * width;
+				float x1 = pos.x + float(min(length, r.end) / length) * width;
+				x1 = max(x1, x0 + 1);
+				float top = y + r.depth * rowHeight;
+
+				drawList->AddRectFilled(ImVec2(x0, top), ImVec2(x1, top + rowHeight - 1), ImColor::HSV(nameHue(r.name), 0.5f, 0.8f));
+
+				ImVec4 clip(x0, top, x1, top + rowHeight);
+				drawList->AddText(ImGui::GetWindowFont(), ImGui::GetWindowFontSize(), ImVec2(x0 + 2, top),
+					ImColor(0, 0, 0), r.name, nullptr, 0, &clip);
+			}
+			y += rows * rowHeight + 4;
+		};
+
+		double gpuLength = 0;
+		for (const record &r : m_lastGPU) gpuLength = max(gpuLength, r.end);
+		drawRows(m_lastFrame, 0, m_lastFrameLength);
+		drawRows(m_lastFrame, 1, m_lastFrameLength);
+		drawRows(m_lastGPU, -1, gpuLength);
+		ImGui::Dummy(ImVec2(width, y - pos.y));
+
+		// Rolling statistics of every scope
+		ImGui::Columns(5, "profiler_stats");
+		ImGui::Text("Scope"); ImGui::NextColumn();
+		ImGui::Text("Last"); ImGui::NextColumn();
+		ImGui::Text("p50"); ImGui::NextColumn();
+		ImGui::Text("p95"); ImGui::NextColumn();
+		ImGui::Text("p99"); ImGui::NextColumn();
+		ImGui::Separator();
+		auto drawSeries = [&](const series_map &map, const char *suffix) {
+			for (const auto &s : map) {
+				ImGui::Text("%s%s", s.first, suffix); ImGui::NextColumn();
+				ImGui::Text("%.3f", s.second.last); ImGui::NextColumn();
+				ImGui::Text("%.3f", s.second.percentile(0.50f)); ImGui::NextColumn();
+				ImGui::Text("%.3f", s.second.percentile(0.95f)); ImGui::NextColumn();
+				ImGui::Text("%.3f", s.second.percentile(0.99f)); ImGui::NextColumn();
+			}
+		};
+		drawSeries(m_series, "");
+		drawSeries(m_gpuSeries, " (GPU)");
+		ImGui::Columns(1);
+
+		ImGui::End();
+	}
+}
+
+#endif
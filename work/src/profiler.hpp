@@ -0,0 +1,183 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#pragma once
+
+// Frame profiler, built when CGRA_PROFILER is defined (the CMake option of
+// the same name). Otherwise the macros below expand to nothing, so scopes
+// can be left in place at no cost. CPU scopes also go to the trace
+// recorder (trace.hpp) while it is enabled.
+//
+//   CGRA_PROFILE_SCOPE("Name")  times the rest of the enclosing block on the CPU
+//   CGRA_PROFILE_GPU("Name")    times the GL commands issued in the rest of the block
+//   CGRA_PROFILE_FRAME_BEGIN()  and CGRA_PROFILE_FRAME_END() bracket each frame
+//
+// Names must be string literals (or otherwise outlive the profiler).
+
+#include "trace.hpp"
+
+#define CGRA_PROFILE_CONCAT_(a, b) a##b
+#define CGRA_PROFILE_CONCAT(a, b) CGRA_PROFILE_CONCAT_(a, b)
+
+#ifdef CGRA_PROFILER
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "alloc_tracker.hpp"
+#include "opengl.hpp"
+
+#define CGRA_PROFILE_SCOPE(name) ::cgra::cpu_profile_scope CGRA_PROFILE_CONCAT(cgra_profile_, __LINE__)(name)
+#define CGRA_PROFILE_GPU(name) ::cgra::gpu_profile_scope CGRA_PROFILE_CONCAT(cgra_profile_, __LINE__)(name)
+#define CGRA_PROFILE_FRAME_BEGIN() ::cgra::frameProfiler().beginFrame()
+#define CGRA_PROFILE_FRAME_END() ::cgra::frameProfiler().endFrame()
+
+namespace cgra {
+
+	// Records CPU scopes from any thread and GPU scopes from the GL thread,
+	// and keeps a rolling history of how long each took.
+	//
+	// GPU scopes are timestamp query pairs (glQueryCounter, GL 3.3 or
+	// ARB_timer_query), which unlike GL_TIME_ELAPSED queries can nest. Their
+	// results are read gpu_latency frames later, and a frame whose results
+	// are still not available is skipped rather than waited for.
+	//
+	// Once every scope has been seen the profiler reuses its buffers, so it
+	// adds no heap allocations of its own to the per-frame counts it shows.
+	class frame_profiler {
+	public:
+		static const int history = 240;    // frames of durations kept
+		static const int gpu_latency = 4;  // frames before GPU results are read
+
+		// A timed scope, in seconds from the start of its frame
+		struct record {
+			const char *name;
+			double start, end;
+			int depth;
+			int thread; // 0 for the main thread, GPU records use -1
+		};
+
+		// Durations of a named scope over the last frames it ran in (ms)
+		struct series {
+			std::vector<float> samples;
+			mutable std::vector<float> sorted; // scratch for percentile()
+			int next = 0;
+			float last = 0;
+
+			void add(float);
+			float percentile(float) const;
+		};
+
+	private:
+		typedef std::chrono::steady_clock clock;
+
+		// Scopes with the same name are the same scope, wherever the literal lives
+		struct name_less {
+			bool operator()(const char *a, const char *b) const { return std::strcmp(a, b) < 0; }
+		};
+		typedef std::map<const char *, series, name_less> series_map;
+
+		// GPU scopes of one frame, waiting for their results
+		struct gpu_frame {
+			std::vector<GLuint> queries;  // two per scope
+			std::vector<record> records;  // start and end are query indices until resolved
+			bool pending = false;
+		};
+
+		clock::time_point m_epoch = clock::now();
+		std::thread::id m_mainThread = std::this_thread::get_id();
+
+		std::mutex m_mutex;           // guards m_records, CPU scopes may be on any thread
+		std::vector<record> m_records;
+		double m_frameStart = 0;
+
+		std::vector<record> m_lastFrame;    // CPU and GPU records of the last finished frame
+		double m_lastFrameLength = 0;
+		std::vector<record> m_lastGPU;      // GPU records of the last frame resolved
+		std::vector<std::pair<const char *, double>> m_totals; // scratch, seconds per scope
+		series_map m_series;
+		series_map m_gpuSeries;
+
+		alloc_counts m_frameAllocs;   // totals when the frame began
+		alloc_counts m_lastAllocs;    // made during the last finished frame
+		series m_allocSeries;         // allocations per frame
+
+		bool m_gpuChecked = false;
+		bool m_gpuSupported = false;
+		gpu_frame m_gpuFrames[gpu_latency];
+		int m_gpuFrame = 0;
+		int m_gpuDepth = 0;
+
+		void resolveGPU(gpu_frame &);
+		void sumByName(const std::vector<record> &);
+
+	public:
+		frame_profiler() { }
+		frame_profiler(const frame_profiler &) = delete;
+		frame_profiler & operator=(const frame_profiler &) = delete;
+
+		// Seconds since the profiler was created
+		double now() const { return std::chrono::duration<double>(clock::now() - m_epoch).count(); }
+
+		void beginFrame();
+		void endFrame();
+
+		// Used by the scope types
+		void addCPU(const char *name, double start, double end, int depth);
+		int beginGPU(const char *name);
+		void endGPU(int index);
+
+		// Draws the profiler window with ImGui
+		void drawWindow();
+	};
+
+	frame_profiler & frameProfiler();
+
+
+	class cpu_profile_scope {
+		const char *m_name;
+		double m_start;
+		int m_depth;
+	public:
+		explicit cpu_profile_scope(const char *name);
+		~cpu_profile_scope();
+		cpu_profile_scope(const cpu_profile_scope &) = delete;
+		cpu_profile_scope & operator=(const cpu_profile_scope &) = delete;
+	};
+
+
+	class gpu_profile_scope {
+		int m_index;
+	public:
+		explicit gpu_profile_scope(const char *name) : m_index(frameProfiler().beginGPU(name)) { }
+		~gpu_profile_scope() { frameProfiler().endGPU(m_index); }
+		gpu_profile_scope(const gpu_profile_scope &) = delete;
+		gpu_profile_scope & operator=(const gpu_profile_scope &) = delete;
+	};
+}
+
+#else
+
+#define CGRA_PROFILE_SCOPE(name) ((void) 0)
+#define CGRA_PROFILE_GPU(name) ((void) 0)
+#define CGRA_PROFILE_FRAME_BEGIN() ((void) 0)
+#define CGRA_PROFILE_FRAME_END() ((void) 0)
+
+#endif
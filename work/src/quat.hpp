@@ -12,6 +12,7 @@
 //
 //----------------------------------------------------------------------------
 
+#pragma once
 
 #include "cgra_math.hpp"
 
@@ -21,8 +22,8 @@ namespace cgra {
 	public:
 		float w, x, y, z;
 
-		quat() : w(1), x(0), y(0), z(0) { }
-		quat(float _w, float _x, float _y, float _z) :  w(_w), x(_x), y(_y), z(_z) { }
+		constexpr quat() : w(1), x(0), y(0), z(0) { }
+		constexpr quat(float _w, float _x, float _y, float _z) :  w(_w), x(_x), y(_y), z(_z) { }
 
 		// eular angle constructor (degrees)
 		// i = rotation around x, j = y, k = z
@@ -65,11 +66,51 @@ namespace cgra {
 			z = s * c.z;
 		}
 
-		quat(const quat& q) : x(q.x), y(q.y), z(q.z), w(q.w) { }
+		// rotation part of an affine transform (must be orthonormal)
+		explicit quat(const affine3 &a) {
+			const vec4 &r0 = a.row(0), &r1 = a.row(1), &r2 = a.row(2);
+			float trace = r0.x + r1.y + r2.z;
+			// divide by the largest of w, x, y, z to stay accurate
+			if (trace > 0) {
+				float s = 0.5f / std::sqrt(trace + 1);
+				w = 0.25f / s;
+				x = (r2.y - r1.z) * s;
+				y = (r0.z - r2.x) * s;
+				z = (r1.x - r0.y) * s;
+			} else if (r0.x > r1.y && r0.x > r2.z) {
+				float s = 2 * std::sqrt(1 + r0.x - r1.y - r2.z);
+				w = (r2.y - r1.z) / s;
+				x = 0.25f * s;
+				y = (r0.y + r1.x) / s;
+				z = (r0.z + r2.x) / s;
+			} else if (r1.y > r2.z) {
+				float s = 2 * std::sqrt(1 + r1.y - r0.x - r2.z);
+				w = (r0.z - r2.x) / s;
+				x = (r0.y + r1.x) / s;
+				y = 0.25f * s;
+				z = (r1.z + r2.y) / s;
+			} else {
+				float s = 2 * std::sqrt(1 + r2.z - r0.x - r1.y);
+				w = (r1.x - r0.y) / s;
+				x = (r0.z + r2.x) / s;
+				y = (r1.z + r2.y) / s;
+				z = 0.25f * s;
+			}
+		}
+
+		// rotation part of a 4x4 transform (must be affine and orthonormal)
+		explicit quat(const mat4 &m) : quat(affine3(m)) { }
 
-		~quat() { }
+		// uniformly distributed random rotation
+		// (Shoemake, "Uniform random rotations", Graphics Gems III)
+		static quat random(math::random_stream &rs = math::threadStream()) {
+			float u1 = rs.nextFloat(), u2 = rs.nextFloat(), u3 = rs.nextFloat();
+			float a = std::sqrt(1 - u1), b = std::sqrt(u1);
+			float t2 = 2 * math::pi<float>() * u2, t3 = 2 * math::pi<float>() * u3;
+			return quat(b * std::cos(t3), a * std::sin(t2), a * std::cos(t2), b * std::sin(t3));
+		}
 
-		static quat checknan(const quat &v) {
+		static constexpr quat checknan(const quat &v) {
 			float sum = v.x + v.y + v.z + v.w;
 			assert(sum == sum);
 			return v;
@@ -90,35 +131,57 @@ namespace cgra {
 			return out << '(' << q.w << ", " << q.x << ", " << q.y << ", " << q.z << ')';
 		}
 
-		explicit operator mat4() const {
+		explicit constexpr operator mat4() const {
 			mat4 m;
 
-			m[0][0]  = w * w + x * x - y * y - z * z;
-			m[0][1]  = 2 * x * y + 2 * w * z;
-			m[0][2]  = 2 * x * z - 2 * w * y;
-			m[0][3]  = 0;
+			m[0].x  = w * w + x * x - y * y - z * z;
+			m[0].y  = 2 * x * y + 2 * w * z;
+			m[0].z  = 2 * x * z - 2 * w * y;
+			m[0].w  = 0;
 
-			m[1][0]  = 2 * x * y - 2 * w * z;
-			m[1][1]  = w * w - x * x + y * y - z * z;
-			m[1][2]  = 2 * y * z + 2 * w * x;
-			m[1][3]  = 0;
+			m[1].x  = 2 * x * y - 2 * w * z;
+			m[1].y  = w * w - x * x + y * y - z * z;
+			m[1].z  = 2 * y * z + 2 * w * x;
+			m[1].w  = 0;
 
-			m[2][0]  = 2 * x * z + 2 * w * y;
-			m[2][1]  = 2 * y * z - 2 * w * x;
-			m[2][2] = w * w - x * x - y * y + z * z;
-			m[2][3] = 0;
+			m[2].x  = 2 * x * z + 2 * w * y;
+			m[2].y  = 2 * y * z - 2 * w * x;
+			m[2].z = w * w - x * x - y * y + z * z;
+			m[2].w = 0;
 
-			m[3][0] = 0;
-			m[3][1] = 0;
-			m[3][2] = 0;
-			m[3][3] = w * w + x * x + y * y + z * z;
+			m[3].x = 0;
+			m[3].y = 0;
+			m[3].z = 0;
+			m[3].w = w * w + x * x + y * y + z * z;
 
 			return m;
 		}
 
 
+		// rotation matrix, for unit quaternions only
+		explicit constexpr operator mat3() const {
+			float x2 = x + x, y2 = y + y, z2 = z + z;
+			float xx = x * x2, yy = y * y2, zz = z * z2;
+			float xy = x * y2, xz = x * z2, yz = y * z2;
+			float wx = w * x2, wy = w * y2, wz = w * z2;
+			return mat3(
+				1 - (yy + zz), xy + wz, xz - wy,
+				xy - wz, 1 - (xx + zz), yz + wx,
+				xz + wy, yz - wx, 1 - (xx + yy));
+		}
+
+
+		// rotation only, combine with affine3::translate for the translation
+		explicit constexpr operator affine3() const {
+			return affine3(
+				vec4(w * w + x * x - y * y - z * z, 2 * x * y - 2 * w * z, 2 * x * z + 2 * w * y, 0),
+				vec4(2 * x * y + 2 * w * z, w * w - x * x + y * y - z * z, 2 * y * z - 2 * w * x, 0),
+				vec4(2 * x * z - 2 * w * y, 2 * y * z + 2 * w * x, w * w - x * x - y * y + z * z, 0));
+		}
+
+
 		// add-assign
-		inline quat & operator+=(const quat &rhs) {
+		constexpr quat & operator+=(const quat &rhs) {
 			w += rhs.w;
 			x += rhs.x;
 			y += rhs.y;
@@ -127,7 +190,7 @@ namespace cgra {
 		}
 
 		// subtract-assign
-		inline quat & operator-=(const quat &rhs) {
+		constexpr quat & operator-=(const quat &rhs) {
 			w -= rhs.w;
 			x -= rhs.x;
 			y -= rhs.y;
@@ -136,7 +199,7 @@ namespace cgra {
 		}
 
 		// mulitply-assign
-		inline quat & operator*=(const quat &rhs) {
+		constexpr quat & operator*=(const quat &rhs) {
 			float _w = w * rhs.w - x * rhs.x - y * rhs.y - z * rhs.z;
 			float _x = w * rhs.x + x * rhs.w + y * rhs.z - z * rhs.y;
 			float _y = w * rhs.y - x * rhs.z + y * rhs.w + z * rhs.x;
@@ -146,7 +209,7 @@ namespace cgra {
 		}
 
 		// mulitply-assign
-		inline quat & operator*=(float rhs) {
+		constexpr quat & operator*=(float rhs) {
 			w *= rhs;
 			x *= rhs;
 			y *= rhs;
@@ -157,7 +220,7 @@ namespace cgra {
 		// divide-assign with quaternions must be outside of the class
 
 		// divide-assign
-		inline quat & operator/=(float rhs) {
+		constexpr quat & operator/=(float rhs) {
 			w /= rhs;
 			x /= rhs;
 			y /= rhs;
@@ -167,7 +230,7 @@ namespace cgra {
 	};
 
 	// dot product
-	inline float dot(const quat &lhs, const quat &rhs) {
+	constexpr float dot(const quat &lhs, const quat &rhs) {
 		return lhs.w * rhs.w + lhs.x * rhs.x +  lhs.y * rhs.y + lhs.z * rhs.z;
 	}
 
@@ -177,7 +240,7 @@ namespace cgra {
 	}
 
 	// inverse rotation
-	inline quat conjugate(const quat& q) {
+	constexpr quat conjugate(const quat& q) {
 		return quat(q.w, -q.x, -q.y, -q.z);
 	}
 
@@ -197,36 +260,36 @@ namespace cgra {
 	}
 
 	// negate
-	inline quat operator-(const quat &q) {
+	constexpr quat operator-(const quat &q) {
 		return conjugate(q);
 	}
 
 	// add
-	inline quat operator+(const quat &lhs, const quat &rhs) {
+	constexpr quat operator+(const quat &lhs, const quat &rhs) {
 		quat q = lhs;
 		return q += rhs;
 	}
 
 	// subtract
-	inline quat operator-(const quat &lhs, const quat &rhs) {
+	constexpr quat operator-(const quat &lhs, const quat &rhs) {
 		quat q = lhs;
 		return q -= rhs;
 	}
 
 	// multiply
-	inline quat operator*(const quat &lhs, const quat &rhs) {
+	constexpr quat operator*(const quat &lhs, const quat &rhs) {
 		quat q = lhs;
 		return q *= rhs;
 	}
 
 	// multiply
-	inline quat operator*(const quat &lhs, float rhs) {
+	constexpr quat operator*(const quat &lhs, float rhs) {
 		quat q = lhs;
 		return q *= rhs;
 	}
 
 	// multiply
-	inline quat operator*(float lhs, const quat &rhs) {
+	constexpr quat operator*(float lhs, const quat &rhs) {
 		quat q = rhs;
 		return q *= lhs;
 	}
@@ -238,7 +301,7 @@ namespace cgra {
 	}
 
 	// divide
-	inline quat operator/(const quat &lhs, float rhs) {
+	constexpr quat operator/(const quat &lhs, float rhs) {
 		quat q = lhs;
 		return q /= rhs;
 	}
@@ -248,22 +311,106 @@ namespace cgra {
 		return q / length(q);
 	}
 
+	// fills out with n uniformly distributed random rotations
+	inline void randomRotations(quat *out, size_t n, math::random_stream &rs = math::threadStream()) {
+		for (size_t i = 0; i < n; i++) out[i] = quat::random(rs);
+	}
+
+	// rotates v by the unit quaternion q, the same as q * quat(0, v) * conjugate(q)
+	// but without building the full product: v + 2w(u x v) + 2u x (u x v)
+	constexpr vec3 rotate(const quat &q, const vec3 &v) {
+		vec3 u(q.x, q.y, q.z);
+		vec3 t = 2.f * cross(u, v);
+		return v + q.w * t + cross(u, t);
+	}
+
+	// rotate
+	constexpr vec3 operator*(const quat &q, const vec3 &v) {
+		return rotate(q, v);
+	}
+
+	// normalized linear interpolation along the shortest path
+	// (constant speed only for small angles, but never needs a sin or acos)
+	inline quat nlerp(const quat &p, const quat &q, float t) {
+		float s = std::signbit(dot(p, q)) ? -t : t;
+		return normalize(p * (1 - t) + q * s);
+	}
+
 	// spherical linear interpolation
 	inline quat slerp(const quat& p1, const quat& q1, float t) {
-		quat q = normalize(q1);
-		quat p = normalize(p1);
-		float epsilon = 0.0001;
-		if (dot(p, q) < 0) {
-			q = q * -1;
-		}
+		quat p = p1 * (1 / length(p1));
+		quat q = q1 * (1 / length(q1));
 		float dpq = dot(p, q);
+		if (dpq < 0) {
+			q *= -1;
+			dpq = -dpq;
+		}
 
-		if ((1.0 - dpq) > epsilon) {
-			float w = std::acos(dpq);
-			return ((std::sin((1 - t) * w) * p) + (std::sin(t * w) * q)) / std::sin(w);
+		// nearly the same rotation: sin(w) approaches zero, and nlerp
+		// is already as close as float precision can tell
+		if ((1 - dpq) <= 0.0001f) {
+			return normalize(p * (1 - t) + q * t);
 		}
-		
-		return (1 - t) * p + t * q;
+
+		// sin(w) from cos(w), with (1 - d)(1 + d) rather than 1 - d*d
+		// to avoid cancellation when d is close to 1
+		float w = std::acos(dpq);
+		float invSin = 1 / std::sqrt((1 - dpq) * (1 + dpq));
+		return p * (std::sin((1 - t) * w) * invSin) + q * (std::sin(t * w) * invSin);
 	}
 
-}
\ No newline at end of file
+
+	// Approximate slerp of unit quaternions with no trigonometric functions,
+	// from D. Eberly, "A Fast and Accurate Algorithm for Computing SLERP".
+	// Both weights are polynomials in dot(p, q) whose coefficients depend
+	// only on t, so constructing one of these prepares interpolation at t
+	// for any number of quaternion pairs (see slerpApprox in quat_soa.hpp).
+	// The weights are within float rounding of slerp's for rotations up to
+	// 90 degrees apart, and within 2e-5 for rotations 180 degrees apart.
+	struct slerp_approx {
+		static constexpr int degree = 8;
+
+		float t, s;             // weights of q and p at dot(p, q) == 1
+		float tc[degree];       // coefficients of the q weight
+		float sc[degree];       // coefficients of the p weight
+
+		explicit slerp_approx(float _t) : t(_t), s(1 - _t) {
+			// sin(t*w)/sin(w) as a series in (cos(w) - 1) has terms with
+			// ratio (t^2 - i^2) / (i (2i + 1)), the last term is scaled by
+			// mu to make up for the truncated ones
+			const float mu = 1.85298109240830f;
+			static const float u[degree] = {
+				1.f / (1 * 3), 1.f / (2 * 5), 1.f / (3 * 7), 1.f / (4 * 9),
+				1.f / (5 * 11), 1.f / (6 * 13), 1.f / (7 * 15), mu / (8 * 17)
+			};
+			static const float v[degree] = {
+				1.f / 3, 2.f / 5, 3.f / 7, 4.f / 9,
+				5.f / 11, 6.f / 13, 7.f / 15, mu * 8 / 17
+			};
+			for (int i = 0; i < degree; i++) {
+				tc[i] = u[i] * t * t - v[i];
+				sc[i] = u[i] * s * s - v[i];
+			}
+		}
+
+		// weight of q (or p, given sc and s) for x = |dot(p, q)|
+		static float weight(const float *c, float a, float x) {
+			float xm1 = x - 1, f = 1;
+			for (int i = degree - 1; i >= 0; i--) f = 1 + c[i] * xm1 * f;
+			return a * f;
+		}
+
+		quat operator()(const quat &p, const quat &q) const {
+			float d = dot(p, q);
+			float x = std::abs(d);
+			float wq = weight(tc, t, x), wp = weight(sc, s, x);
+			if (std::signbit(d)) wq = -wq;
+			return p * wp + q * wq;
+		}
+	};
+
+	// approximate spherical linear interpolation of unit quaternions
+	inline quat slerpApprox(const quat &p, const quat &q, float t) {
+		return slerp_approx(t)(p, q);
+	}
+}
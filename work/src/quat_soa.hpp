@@ -0,0 +1,305 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------
+//
+// Batched quaternion kernels
+//
+// Quaternions stored as separate w, x, y and z arrays, processed four at a
+// time with SSE in the same way as the vector kernels in cgra_soa.hpp. The
+// leftover quaternions are processed one at a time with the same arithmetic
+// as the quat functions, so results match those of quat.hpp exactly.
+//
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "cgra_soa.hpp"
+#include "quat.hpp"
+
+#ifdef CGRA_SIMD_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace cgra {
+
+	// Views and storage
+	//
+
+	// Non-owning view of size quaternions stored as separate w, x, y and z arrays
+	template <typename T>
+	struct quat_span_t {
+		T *w = nullptr;
+		T *x = nullptr;
+		T *y = nullptr;
+		T *z = nullptr;
+		size_t size = 0;
+
+		quat_span_t() { }
+		quat_span_t(T *_w, T *_x, T *_y, T *_z, size_t _size) : w(_w), x(_x), y(_y), z(_z), size(_size) { }
+
+		// mutable to const view
+		template <typename U>
+		quat_span_t(const quat_span_t<U> &other) : w(other.w), x(other.x), y(other.y), z(other.z), size(other.size) { }
+
+		quat operator[](size_t i) const {
+			assert(i < size);
+			return quat(w[i], x[i], y[i], z[i]);
+		}
+	};
+
+	using quat_span = quat_span_t<float>;
+	using const_quat_span = quat_span_t<const float>;
+
+
+	// Growable array of quaternions stored as aligned w, x, y and z arrays
+	class quat_soa {
+	private:
+		aligned_vector<float> m_w, m_x, m_y, m_z;
+
+	public:
+		quat_soa() { }
+
+		explicit quat_soa(size_t n) : m_w(n, 1.f), m_x(n), m_y(n), m_z(n) { }
+
+		explicit quat_soa(const std::vector<quat> &q) {
+			reserve(q.size());
+			for (const quat &p : q) push_back(p);
+		}
+
+		size_t size() const { return m_w.size(); }
+
+		void resize(size_t n) {
+			m_w.resize(n, 1.f);
+			m_x.resize(n);
+			m_y.resize(n);
+			m_z.resize(n);
+		}
+
+		void reserve(size_t n) {
+			m_w.reserve(n);
+			m_x.reserve(n);
+			m_y.reserve(n);
+			m_z.reserve(n);
+		}
+
+		void push_back(const quat &q) {
+			m_w.push_back(q.w);
+			m_x.push_back(q.x);
+			m_y.push_back(q.y);
+			m_z.push_back(q.z);
+		}
+
+		quat get(size_t i) const {
+			return quat(m_w[i], m_x[i], m_y[i], m_z[i]);
+		}
+
+		void set(size_t i, const quat &q) {
+			m_w[i] = q.w;
+			m_x[i] = q.x;
+			m_y[i] = q.y;
+			m_z[i] = q.z;
+		}
+
+		float * w() { return m_w.data(); }
+		float * x() { return m_x.data(); }
+		float * y() { return m_y.data(); }
+		float * z() { return m_z.data(); }
+		const float * w() const { return m_w.data(); }
+		const float * x() const { return m_x.data(); }
+		const float * y() const { return m_y.data(); }
+		const float * z() const { return m_z.data(); }
+
+		operator quat_span() {
+			return quat_span(w(), x(), y(), z(), size());
+		}
+
+		operator const_quat_span() const {
+			return const_quat_span(w(), x(), y(), z(), size());
+		}
+	};
+
+
+	// Kernels
+	// Outputs may be the same arrays as the inputs
+	//
+
+#ifdef CGRA_SIMD_SSE
+	namespace simd {
+
+		struct quat4 {
+			__m128 w, x, y, z;
+		};
+
+		inline quat4 load(const_quat_span q, size_t i) {
+			return quat4 { _mm_loadu_ps(q.w + i), _mm_loadu_ps(q.x + i), _mm_loadu_ps(q.y + i), _mm_loadu_ps(q.z + i) };
+		}
+
+		inline void store(quat_span q, size_t i, const quat4 &v) {
+			_mm_storeu_ps(q.w + i, v.w);
+			_mm_storeu_ps(q.x + i, v.x);
+			_mm_storeu_ps(q.y + i, v.y);
+			_mm_storeu_ps(q.z + i, v.z);
+		}
+
+		inline __m128 dot(const quat4 &l, const quat4 &r) {
+			return _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(l.w, r.w), _mm_mul_ps(l.x, r.x)), _mm_mul_ps(l.y, r.y)), _mm_mul_ps(l.z, r.z));
+		}
+
+		// l * a + r * b
+		inline quat4 blend(const quat4 &l, __m128 a, const quat4 &r, __m128 b) {
+			return quat4 {
+				_mm_add_ps(_mm_mul_ps(l.w, a), _mm_mul_ps(r.w, b)),
+				_mm_add_ps(_mm_mul_ps(l.x, a), _mm_mul_ps(r.x, b)),
+				_mm_add_ps(_mm_mul_ps(l.y, a), _mm_mul_ps(r.y, b)),
+				_mm_add_ps(_mm_mul_ps(l.z, a), _mm_mul_ps(r.z, b))
+			};
+		}
+
+		inline quat4 normalize(const quat4 &q) {
+			__m128 len = _mm_sqrt_ps(dot(q, q));
+			return quat4 { _mm_div_ps(q.w, len), _mm_div_ps(q.x, len), _mm_div_ps(q.y, len), _mm_div_ps(q.z, len) };
+		}
+
+		// slerp_approx::weight for four values of x
+		inline __m128 weight(const float *c, float a, __m128 x) {
+			__m128 xm1 = _mm_sub_ps(x, _mm_set1_ps(1)), f = _mm_set1_ps(1);
+			for (int i = slerp_approx::degree - 1; i >= 0; i--) {
+				f = _mm_add_ps(_mm_set1_ps(1), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(c[i]), xm1), f));
+			}
+			return _mm_mul_ps(_mm_set1_ps(a), f);
+		}
+	}
+#endif
+
+	// quaternion products of lhs and rhs into out
+	inline void multiply(const_quat_span lhs, const_quat_span rhs, quat_span out) {
+		assert(rhs.size >= lhs.size && out.size >= lhs.size);
+		size_t i = 0;
+#ifdef CGRA_SIMD_SSE
+		for (; i + 4 <= lhs.size; i += 4) {
+			simd::quat4 l = simd::load(lhs, i), r = simd::load(rhs, i), o;
+			o.w = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_mul_ps(l.w, r.w), _mm_mul_ps(l.x, r.x)), _mm_mul_ps(l.y, r.y)), _mm_mul_ps(l.z, r.z));
+			o.x = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(l.w, r.x), _mm_mul_ps(l.x, r.w)), _mm_mul_ps(l.y, r.z)), _mm_mul_ps(l.z, r.y));
+			o.y = _mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(l.w, r.y), _mm_mul_ps(l.x, r.z)), _mm_mul_ps(l.y, r.w)), _mm_mul_ps(l.z, r.x));
+			o.z = _mm_add_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(l.w, r.z), _mm_mul_ps(l.x, r.y)), _mm_mul_ps(l.y, r.x)), _mm_mul_ps(l.z, r.w));
+			simd::store(out, i, o);
+		}
+#endif
+		for (; i < lhs.size; i++) {
+			quat q = lhs[i] * rhs[i];
+			out.w[i] = q.w;
+			out.x[i] = q.x;
+			out.y[i] = q.y;
+			out.z[i] = q.z;
+		}
+	}
+
+	// unit quaternions of in into out
+	inline void normalize(const_quat_span in, quat_span out) {
+		assert(out.size >= in.size);
+		size_t i = 0;
+#ifdef CGRA_SIMD_SSE
+		for (; i + 4 <= in.size; i += 4) {
+			simd::store(out, i, simd::normalize(simd::load(in, i)));
+		}
+#endif
+		for (; i < in.size; i++) {
+			quat q = normalize(in[i]);
+			out.w[i] = q.w;
+			out.x[i] = q.x;
+			out.y[i] = q.y;
+			out.z[i] = q.z;
+		}
+	}
+
+	// rotates the vectors in by the unit quaternions q into out
+	inline void rotate(const_quat_span q, const_vec3_span in, vec3_span out) {
+		assert(in.size >= q.size && out.size >= q.size);
+		size_t i = 0;
+#ifdef CGRA_SIMD_SSE
+		const __m128 two = _mm_set1_ps(2);
+		for (; i + 4 <= q.size; i += 4) {
+			__m128 qw = _mm_loadu_ps(q.w + i), qx = _mm_loadu_ps(q.x + i), qy = _mm_loadu_ps(q.y + i), qz = _mm_loadu_ps(q.z + i);
+			__m128 x = _mm_loadu_ps(in.x + i), y = _mm_loadu_ps(in.y + i), z = _mm_loadu_ps(in.z + i);
+			// t = 2 (u x v)
+			__m128 tx = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(qy, z), _mm_mul_ps(qz, y)));
+			__m128 ty = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(qz, x), _mm_mul_ps(qx, z)));
+			__m128 tz = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(qx, y), _mm_mul_ps(qy, x)));
+			// v + w t + u x t
+			_mm_storeu_ps(out.x + i, _mm_add_ps(_mm_add_ps(x, _mm_mul_ps(qw, tx)), _mm_sub_ps(_mm_mul_ps(qy, tz), _mm_mul_ps(qz, ty))));
+			_mm_storeu_ps(out.y + i, _mm_add_ps(_mm_add_ps(y, _mm_mul_ps(qw, ty)), _mm_sub_ps(_mm_mul_ps(qz, tx), _mm_mul_ps(qx, tz))));
+			_mm_storeu_ps(out.z + i, _mm_add_ps(_mm_add_ps(z, _mm_mul_ps(qw, tz)), _mm_sub_ps(_mm_mul_ps(qx, ty), _mm_mul_ps(qy, tx))));
+		}
+#endif
+		for (; i < q.size; i++) {
+			vec3 v = rotate(q[i], in[i]);
+			out.x[i] = v.x;
+			out.y[i] = v.y;
+			out.z[i] = v.z;
+		}
+	}
+
+	// normalized linear interpolation of lhs and rhs at t into out
+	inline void nlerp(const_quat_span lhs, const_quat_span rhs, float t, quat_span out) {
+		assert(rhs.size >= lhs.size && out.size >= lhs.size);
+		size_t i = 0;
+#ifdef CGRA_SIMD_SSE
+		const __m128 vt = _mm_set1_ps(t), vs = _mm_set1_ps(1 - t), sign = _mm_set1_ps(-0.f);
+		for (; i + 4 <= lhs.size; i += 4) {
+			simd::quat4 l = simd::load(lhs, i), r = simd::load(rhs, i);
+			// take the shortest path by giving t the sign of the dot product
+			__m128 b = _mm_xor_ps(vt, _mm_and_ps(simd::dot(l, r), sign));
+			simd::store(out, i, simd::normalize(simd::blend(l, vs, r, b)));
+		}
+#endif
+		for (; i < lhs.size; i++) {
+			quat q = nlerp(lhs[i], rhs[i], t);
+			out.w[i] = q.w;
+			out.x[i] = q.x;
+			out.y[i] = q.y;
+			out.z[i] = q.z;
+		}
+	}
+
+	// approximate spherical linear interpolation (slerp_approx) of the unit
+	// quaternions lhs and rhs at t into out
+	inline void slerpApprox(const_quat_span lhs, const_quat_span rhs, float t, quat_span out) {
+		assert(rhs.size >= lhs.size && out.size >= lhs.size);
+		const slerp_approx f(t);
+		size_t i = 0;
+#ifdef CGRA_SIMD_SSE
+		const __m128 sign = _mm_set1_ps(-0.f);
+		for (; i + 4 <= lhs.size; i += 4) {
+			simd::quat4 l = simd::load(lhs, i), r = simd::load(rhs, i);
+			__m128 d = simd::dot(l, r);
+			__m128 x = _mm_andnot_ps(sign, d);
+			__m128 wr = _mm_xor_ps(simd::weight(f.tc, f.t, x), _mm_and_ps(d, sign));
+			simd::store(out, i, simd::blend(l, simd::weight(f.sc, f.s, x), r, wr));
+		}
+#endif
+		for (; i < lhs.size; i++) {
+			quat q = f(lhs[i], rhs[i]);
+			out.w[i] = q.w;
+			out.x[i] = q.x;
+			out.y[i] = q.y;
+			out.z[i] = q.z;
+		}
+	}
+}
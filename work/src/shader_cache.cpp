@@ -0,0 +1,441 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <sys/stat.h>
+
+#include "shader_cache.hpp"
+#include "simple_shader.hpp"
+
+using namespace std;
+
+namespace cgra {
+
+	namespace {
+		const uint32_t binary_magic = 0x42505243; // "CRPB"
+
+		// Header written before the program binary
+		struct binary_header {
+			uint32_t magic;
+			uint32_t format;
+			uint64_t key;
+			uint32_t length;
+		};
+
+		// 64-bit FNV-1a
+		class fnv_hash {
+			uint64_t m_hash = 14695981039346656037ull;
+		public:
+			void add(const void *data, size_t size) {
+				const unsigned char *p = static_cast<const unsigned char *>(data);
+				for (size_t i = 0; i < size; i++) {
+					m_hash ^= p[i];
+					m_hash *= 1099511628211ull;
+				}
+			}
+
+			// Length prefixed, so consecutive strings cannot run together
+			void add(const string &s) {
+				uint64_t n = s.size();
+				add(&n, sizeof(n));
+				add(s.data(), s.size());
+			}
+
+			uint64_t value() const { return m_hash; }
+		};
+
+		string glString(GLenum name) {
+			const GLubyte *s = glGetString(name);
+			return s ? reinterpret_cast<const char *>(s) : "";
+		}
+
+		// KHR_parallel_shader_compile is newer than our GLEW, the ARB
+		// version has the same enums
+		const GLenum completion_status = 0x91B1;
+		const GLuint max_compiler_threads = 0xFFFFFFFF; // let the driver decide
+		typedef void (APIENTRY *max_compiler_threads_proc)(GLuint);
+
+		// How often watched files are checked for changes, and how often
+		// the main loop is woken while builds are pending
+		const chrono::milliseconds watch_interval(250);
+		const chrono::milliseconds build_poll_interval(20);
+
+		// In nanoseconds, so saves within the same second are told apart
+		int64_t modificationTime(const string &file) {
+			struct stat st;
+			if (stat(file.c_str(), &st) != 0) return 0;
+#if defined(__APPLE__)
+			return int64_t(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+			return int64_t(st.st_mtime) * 1000000000;
+#else
+			return int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+		}
+	}
+
+
+	file_watcher & fileWatcher() {
+		static file_watcher watcher;
+		return watcher;
+	}
+
+
+	file_watcher::~file_watcher() {
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_running = false;
+		}
+		m_wake.notify_one();
+		if (m_thread.joinable()) m_thread.join();
+	}
+
+
+	void file_watcher::setCallback(function<void()> callback) {
+		lock_guard<mutex> lock(m_mutex);
+		m_callback = callback;
+	}
+
+
+	int file_watcher::watch(const string &path) {
+		lock_guard<mutex> lock(m_mutex);
+		m_entries.emplace_back(new entry);
+		m_entries.back()->path = path;
+		m_entries.back()->modified = modificationTime(path);
+		if (!m_running) {
+			m_running = true;
+			m_thread = thread(&file_watcher::run, this);
+		}
+		return int(m_entries.size()) - 1;
+	}
+
+
+	void file_watcher::unwatch(int id) {
+		lock_guard<mutex> lock(m_mutex);
+		m_entries[id]->active = false;
+	}
+
+
+	bool file_watcher::changed(int id) {
+		lock_guard<mutex> lock(m_mutex);
+		bool changed = m_entries[id]->changed;
+		m_entries[id]->changed = false;
+		return changed;
+	}
+
+
+	void file_watcher::run() {
+		unique_lock<mutex> lock(m_mutex);
+		while (m_running) {
+			bool changed = false;
+			for (auto &e : m_entries) {
+				if (!e->active) continue;
+				// A file that is missing is most likely being saved, wait for it
+				int64_t modified = modificationTime(e->path);
+				if (modified != 0 && modified != e->modified) {
+					e->modified = modified;
+					e->changed = true;
+					changed = true;
+				}
+			}
+
+			bool building = m_pendingBuilds > 0;
+			if ((changed || building) && m_callback) m_callback();
+			m_wake.wait_for(lock, building ? build_poll_interval : watch_interval, [&] { return !m_running; });
+		}
+	}
+
+
+	program_cache & programCache() {
+		static program_cache cache;
+		return cache;
+	}
+
+
+	program_cache::program_cache() : m_directory(string(CGRA_SRCDIR) + "/res/shaders/cache") { }
+
+
+	void program_cache::initialize() {
+		if (m_initialized) return;
+		m_initialized = true;
+
+		m_driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+
+		// Some drivers support the extension but no binary formats
+		if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary) {
+			GLint formats = 0;
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+			m_binaries = formats > 0;
+		}
+
+		const char *threads = nullptr;
+		if (glfwExtensionSupported("GL_KHR_parallel_shader_compile")) {
+			threads = "glMaxShaderCompilerThreadsKHR";
+		} else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile")) {
+			threads = "glMaxShaderCompilerThreadsARB";
+		}
+		if (threads) {
+			m_parallel = true;
+			auto setThreads = reinterpret_cast<max_compiler_threads_proc>(glfwGetProcAddress(threads));
+			if (setThreads) setThreads(max_compiler_threads);
+		}
+	}
+
+
+	string program_cache::path(uint64_t key) const {
+		ostringstream oss;
+		oss << m_directory << "/program_" << hex << setw(16) << setfill('0') << key << ".bin";
+		return oss.str();
+	}
+
+
+	bool program_cache::loadBinary(GLuint prog, uint64_t key) {
+		ifstream file(path(key), ios::binary | ios::ate);
+		if (!file) return false;
+		streamoff size = file.tellg();
+		file.seekg(0);
+
+		binary_header header;
+		if (!file.read(reinterpret_cast<char *>(&header), sizeof(header))) return false;
+		if (header.magic != binary_magic || header.key != key) return false;
+
+		// A corrupt or truncated file is recompiled, not trusted with an allocation
+		if (header.length == 0 || streamoff(header.length) != size - streamoff(sizeof(header))) return false;
+
+		vector<char> binary(header.length);
+		if (!file.read(binary.data(), binary.size())) return false;
+
+		glProgramBinary(prog, header.format, binary.data(), GLsizei(binary.size()));
+		GLint link_status = 0;
+		glGetProgramiv(prog, GL_LINK_STATUS, &link_status);
+		return link_status != 0;
+	}
+
+
+	uint64_t program_cache::programKey(const vector<GLenum> &stypes, const vector<string> &sources) {
+		initialize();
+		fnv_hash hash;
+		hash.add(m_driver);
+		for (size_t i = 0; i < stypes.size(); ++i) {
+			hash.add(&stypes[i], sizeof(GLenum));
+			hash.add(sources[i]);
+		}
+		return hash.value();
+	}
+
+
+	GLuint program_cache::loadProgram(uint64_t key) {
+		initialize();
+		if (!binariesEnabled()) return 0;
+
+		GLuint prog = glCreateProgram();
+		if (loadBinary(prog, key)) {
+			m_hits++;
+			cout << "SimpleShader : " << "Shader program loaded from cache" << endl;
+			return prog;
+		}
+		glDeleteProgram(prog);
+		m_misses++;
+		return 0;
+	}
+
+
+	void program_cache::storeProgram(GLuint prog, uint64_t key) {
+		if (!binariesEnabled()) return;
+
+		GLint length = 0;
+		glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) return;
+
+		vector<char> binary(length);
+		GLenum format = 0;
+		glGetProgramBinary(prog, length, &length, &format, binary.data());
+
+		binary_header header;
+		header.magic = binary_magic;
+		header.format = format;
+		header.key = key;
+		header.length = uint32_t(length);
+
+		// Failing to write just means compiling again next time
+		ofstream file(path(key), ios::binary);
+		file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		file.write(binary.data(), length);
+	}
+
+
+	GLuint program_cache::shader(GLenum stype, const string &source) {
+		string key = to_string(stype) + "\n" + source;
+		auto it = m_shaders.find(key);
+		if (it != m_shaders.end()) {
+			m_reused++;
+			return it->second;
+		}
+		GLuint shader = compileShader(stype, source);
+		m_shaders[key] = shader;
+		return shader;
+	}
+
+
+	GLuint program_cache::makeProgram(const vector<GLenum> &stypes, const vector<string> &sources) {
+		if (stypes.size() != sources.size()) {
+			throw runtime_error("stypes and shader sources, vector size mismatch");
+		}
+		uint64_t key = programKey(stypes, sources);
+		if (GLuint cached = loadProgram(key)) return cached;
+
+		GLuint prog = glCreateProgram();
+		for (size_t i = 0; i < stypes.size(); ++i) {
+			glAttachShader(prog, shader(stypes[i], sources[i]));
+		}
+		if (binariesEnabled()) glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+		linkShaderProgram(prog);
+		cout << "SimpleShader : " << "Shader program compiled and linked successfully" << endl;
+
+		storeProgram(prog, key);
+		return prog;
+	}
+
+
+	void program_cache::releaseShaders() {
+		for (auto &s : m_shaders) glDeleteShader(s.second);
+		m_shaders.clear();
+	}
+
+
+	void async_program::load(const string &profile, const vector<GLenum> &stypes, const string &file) {
+		m_profile = profile;
+		m_stypes = stypes;
+		m_file = file;
+		if (m_watch < 0) m_watch = fileWatcher().watch(m_file);
+		submit();
+	}
+
+
+	void async_program::submit() {
+		discardPending();
+
+		ifstream fileStream(m_file);
+		if (!fileStream) {
+			cerr << "SimpleShader : " << "Could not locate and open file " << m_file << endl;
+			m_failed = true;
+			return;
+		}
+		stringstream buffer;
+		buffer << fileStream.rdbuf();
+		vector<string> sources = shaderStageSources(m_profile, m_stypes, buffer.str());
+
+		// A cached binary is ready straight away
+		program_cache &cache = programCache();
+		m_pendingKey = cache.programKey(m_stypes, sources);
+		if (GLuint cached = cache.loadProgram(m_pendingKey)) {
+			if (m_program) glDeleteProgram(m_program);
+			m_program = cached;
+			m_failed = false;
+			return;
+		}
+
+		// Issue everything without asking for the results, which would wait for them
+		m_pending = glCreateProgram();
+		fileWatcher().buildStarted();
+		for (size_t i = 0; i < m_stypes.size(); ++i) {
+			GLuint shader = glCreateShader(m_stypes[i]);
+			const char *text = sources[i].c_str();
+			glShaderSource(shader, 1, &text, nullptr);
+			glCompileShader(shader);
+			glAttachShader(m_pending, shader);
+			m_pendingShaders.push_back(shader);
+		}
+		if (cache.binariesEnabled()) glProgramParameteri(m_pending, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		glLinkProgram(m_pending);
+	}
+
+
+	bool async_program::finish() {
+		GLint link_status = 0;
+		glGetProgramiv(m_pending, GL_LINK_STATUS, &link_status);
+		if (!link_status) {
+			for (GLuint shader : m_pendingShaders) printShaderInfoLog(shader);
+			printProgramInfoLog(m_pending);
+			cerr << "SimpleShader : " << "Could not build " << m_file
+				<< (m_program ? ", keeping the previous program" : "") << endl;
+			discardPending();
+			m_failed = true;
+			return false;
+		}
+
+		printProgramInfoLog(m_pending);
+		cout << "SimpleShader : " << "Shader program " << m_file << " compiled and linked successfully" << endl;
+		programCache().storeProgram(m_pending, m_pendingKey);
+
+		// The shaders are only flagged for deletion until the program goes
+		for (GLuint shader : m_pendingShaders) glDeleteShader(shader);
+		m_pendingShaders.clear();
+
+		if (m_program) glDeleteProgram(m_program);
+		m_program = m_pending;
+		m_pending = 0;
+		fileWatcher().buildFinished();
+		m_failed = false;
+		return true;
+	}
+
+
+	void async_program::discardPending() {
+		for (GLuint shader : m_pendingShaders) glDeleteShader(shader);
+		m_pendingShaders.clear();
+		if (m_pending) {
+			glDeleteProgram(m_pending);
+			fileWatcher().buildFinished();
+		}
+		m_pending = 0;
+	}
+
+
+	bool async_program::poll() {
+		bool finished = false;
+
+		if (m_pending) {
+			GLint done = GL_TRUE;
+			if (programCache().parallelCompile()) glGetProgramiv(m_pending, completion_status, &done);
+			if (done) {
+				finish();
+				finished = true;
+			}
+		}
+
+		if (m_watch >= 0 && fileWatcher().changed(m_watch)) {
+			cout << "SimpleShader : " << "Reloading " << m_file << endl;
+			GLuint previous = m_program;
+			submit();
+			finished = finished || m_program != previous;
+		}
+
+		return finished;
+	}
+
+
+	void async_program::destroy() {
+		if (m_watch >= 0) fileWatcher().unwatch(m_watch);
+		m_watch = -1;
+		discardPending();
+		if (m_program) glDeleteProgram(m_program);
+		m_program = 0;
+	}
+}
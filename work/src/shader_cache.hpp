@@ -0,0 +1,204 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "opengl.hpp"
+
+namespace cgra {
+
+	// Builds shader programs for makeShaderProgram, reusing what it can:
+	//  - shader objects compiled earlier in the run from the same stage
+	//    and source
+	//  - program binaries saved by an earlier run (glGetProgramBinary,
+	//    GL 4.1 or ARB_get_program_binary)
+	//
+	// Binaries are keyed by a hash of the stages, their sources and the
+	// driver's vendor, renderer and version strings, so a driver update
+	// misses the cache rather than loading a stale binary. A binary that
+	// fails to load is silently recompiled from source and replaced.
+	class program_cache {
+	private:
+		std::string m_directory;
+		std::string m_driver;
+		bool m_binaries = false;
+		bool m_parallel = false;
+		bool m_initialized = false;
+
+		// Shader objects by stage and source
+		std::unordered_map<std::string, GLuint> m_shaders;
+
+		unsigned long m_hits = 0;
+		unsigned long m_misses = 0;
+		unsigned long m_reused = 0;
+
+		std::string path(uint64_t key) const;
+		bool loadBinary(GLuint prog, uint64_t key);
+		GLuint shader(GLenum stype, const std::string &source);
+
+	public:
+		program_cache();
+		program_cache(const program_cache &) = delete;
+		program_cache & operator=(const program_cache &) = delete;
+
+		// Directory the binaries are written to (it must exist),
+		// empty disables the disk cache
+		void setDirectory(const std::string &directory) { m_directory = directory; }
+		const std::string & directory() const { return m_directory; }
+
+		// Links a program from one source per stage, the GL context must be
+		// current. Throws shader_compile_error or shader_link_error.
+		GLuint makeProgram(const std::vector<GLenum> &stypes, const std::vector<std::string> &sources);
+
+		// Deletes the shader objects kept for reuse
+		void releaseShaders();
+
+		// Queries what the driver supports, the GL context must be current.
+		// Called by the functions below, so only needed to query first.
+		void initialize();
+
+		// Whether binaries are saved, and whether the driver compiles and
+		// links in the background (KHR/ARB_parallel_shader_compile)
+		bool binariesEnabled() const { return m_binaries && !m_directory.empty(); }
+		bool parallelCompile() const { return m_parallel; }
+
+		// Key of the program binary for these stages and sources
+		uint64_t programKey(const std::vector<GLenum> &stypes, const std::vector<std::string> &sources);
+
+		// Returns a linked program loaded from the cached binary, or 0
+		GLuint loadProgram(uint64_t key);
+
+		// Saves the binary of a linked program (which was linked with
+		// GL_PROGRAM_BINARY_RETRIEVABLE_HINT set)
+		void storeProgram(GLuint prog, uint64_t key);
+
+		unsigned long binaryHits() const { return m_hits; }
+		unsigned long binaryMisses() const { return m_misses; }
+		unsigned long shadersReused() const { return m_reused; }
+	};
+
+	program_cache & programCache();
+
+
+	// Checks files for changes on its own thread, so an idle main loop
+	// blocked in glfwWaitEvents still notices them. The callback (eg.
+	// glfwPostEmptyEvent) is run on the watcher thread after a change, and
+	// regularly while any builds are pending so the main loop can poll them.
+	class file_watcher {
+	private:
+		struct entry {
+			std::string path;
+			int64_t modified;  // nanoseconds, 0 if the file is missing
+			bool changed = false;
+			bool active = true;
+		};
+
+		std::mutex m_mutex;          // guards m_entries and m_callback
+		std::condition_variable m_wake;
+		std::vector<std::unique_ptr<entry>> m_entries;
+		std::function<void()> m_callback;
+		std::thread m_thread;
+		bool m_running = false;
+		std::atomic<int> m_pendingBuilds { 0 };
+
+		void run();
+
+	public:
+		file_watcher() { }
+		~file_watcher();
+		file_watcher(const file_watcher &) = delete;
+		file_watcher & operator=(const file_watcher &) = delete;
+
+		void setCallback(std::function<void()> callback);
+
+		// Starts watching a file, returns its id
+		int watch(const std::string &path);
+		void unwatch(int id);
+
+		// Whether the file changed since the last call
+		bool changed(int id);
+
+		// While builds are pending the callback is run on every check
+		void buildStarted() { m_pendingBuilds++; }
+		void buildFinished() { m_pendingBuilds--; }
+	};
+
+	file_watcher & fileWatcher();
+
+
+	// Program built from a single source file (see makeShaderProgram)
+	// without blocking the main thread.
+	//
+	// The stages are compiled and linked without asking for the result.
+	// With parallel shader compilation, poll only checks the result once
+	// GL_COMPLETION_STATUS_KHR says it is ready. Without it, the driver may
+	// still overlap the work with other commands until the first poll.
+	// Until the first build links, ready() is false and the caller draws
+	// with a fallback.
+	//
+	// The file is watched by fileWatcher(). When it changes, poll rebuilds
+	// it in the background, and the new program replaces the old one only
+	// once it links. A broken edit leaves the last good program in use.
+	class async_program {
+	private:
+		std::string m_profile;
+		std::vector<GLenum> m_stypes;
+		std::string m_file;
+
+		GLuint m_program = 0; // last build that linked
+		GLuint m_pending = 0; // build in progress
+		std::vector<GLuint> m_pendingShaders;
+		uint64_t m_pendingKey = 0;
+		bool m_failed = false;
+		int m_watch = -1;
+
+		void submit();
+		bool finish();
+		void discardPending();
+
+	public:
+		async_program() { }
+		async_program(const async_program &) = delete;
+		async_program & operator=(const async_program &) = delete;
+
+		// Starts building the program, the GL context must be current
+		void load(const std::string &profile, const std::vector<GLenum> &stypes, const std::string &file);
+
+		// Finishes builds that are done and rebuilds the file if it changed,
+		// call once per frame. Returns true if a new program was swapped in
+		// or a build finished (even if it failed).
+		bool poll();
+
+		// Deletes the programs and stops watching the file
+		void destroy();
+
+		bool ready() const { return m_program != 0; }
+		bool pending() const { return m_pending != 0; }
+		// The last build failed (the previous program, if any, is still used)
+		bool failed() const { return m_failed; }
+		GLuint program() const { return m_program; }
+		const std::string & file() const { return m_file; }
+	};
+}
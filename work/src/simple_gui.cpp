@@ -12,8 +12,11 @@
 //
 //----------------------------------------------------------------------------
 
+#include "gl_state.hpp"
 #include "simple_gui.hpp"
+#include "stream_buffer.hpp"
 
+#include <cstring>
 #include <iostream>
 
 using namespace std;
@@ -31,7 +34,8 @@ namespace cgra {
 		static int          g_shaderHandle = 0, g_vertHandle = 0, g_fragHandle = 0;
 		static int          g_attribLocationTex = 0, g_attribLocationProjMtx = 0;
 		static int          g_attribLocationPosition = 0, g_attribLocationUV = 0, g_attribLocationColor = 0;
-		static unsigned int g_vboHandle = 0, g_vaoHandle = 0, g_elementsHandle = 0;
+		static unsigned int g_vaoHandle = 0;
+		static stream_buffer g_vertexStream, g_indexStream;
 
 		static void createFontsTexture() {
 			ImGuiIO& io = ImGui::GetIO();
@@ -41,7 +45,7 @@ namespace cgra {
 			io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);   // Load as RGBA 32-bits for OpenGL3 demo because it is more likely to be compatible with user's existing shader.
 
 			glGenTextures(1, &g_fontTexture);
-			glBindTexture(GL_TEXTURE_2D, g_fontTexture);
+			glState().bindTexture(GL_TEXTURE_2D, g_fontTexture);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
@@ -56,10 +60,7 @@ namespace cgra {
 
 		static bool createDeviceObjects() {
 			// Backup GL state
-			GLint last_texture, last_array_buffer, last_vertex_array;
-			glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
-			glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &last_array_buffer);
-			glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &last_vertex_array);
+			gl_state::snapshot last_state = glState().save();
 
 			const GLchar *vertex_shader =
 				"#version 130\n"
@@ -104,49 +105,46 @@ namespace cgra {
 			g_attribLocationUV = glGetAttribLocation(g_shaderHandle, "UV");
 			g_attribLocationColor = glGetAttribLocation(g_shaderHandle, "Color");
 
-			glGenBuffers(1, &g_vboHandle);
-			glGenBuffers(1, &g_elementsHandle);
-
+			// The vertex array is bound first, as the element buffer binding is part of it
 			glGenVertexArrays(1, &g_vaoHandle);
-			glBindVertexArray(g_vaoHandle);
-			glBindBuffer(GL_ARRAY_BUFFER, g_vboHandle);
+			glState().bindVertexArray(g_vaoHandle);
+			g_vertexStream.init(GL_ARRAY_BUFFER, 512 * 1024);
+			g_indexStream.init(GL_ELEMENT_ARRAY_BUFFER, 128 * 1024);
 			glEnableVertexAttribArray(g_attribLocationPosition);
 			glEnableVertexAttribArray(g_attribLocationUV);
 			glEnableVertexAttribArray(g_attribLocationColor);
 
-		#define OFFSETOF(TYPE, ELEMENT) ((size_t)&(((TYPE *)0)->ELEMENT))
-			glVertexAttribPointer(g_attribLocationPosition, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)OFFSETOF(ImDrawVert, pos));
-			glVertexAttribPointer(g_attribLocationUV, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)OFFSETOF(ImDrawVert, uv));
-			glVertexAttribPointer(g_attribLocationColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)OFFSETOF(ImDrawVert, col));
-		#undef OFFSETOF
-
 			createFontsTexture();
 
 			// Restore modified GL state
-			glBindTexture(GL_TEXTURE_2D, last_texture);
-			glBindBuffer(GL_ARRAY_BUFFER, last_array_buffer);
-			glBindVertexArray(last_vertex_array);
+			glState().restore(last_state);
 
 			return true;
 		}
 
+		// Points the attributes at the vertices starting at offset bytes into the vertex stream
+		static void setVertexPointers(size_t offset) {
+		#define OFFSETOF(TYPE, ELEMENT) ((size_t)&(((TYPE *)0)->ELEMENT))
+			glState().bindBuffer(GL_ARRAY_BUFFER, g_vertexStream.buffer());
+			glVertexAttribPointer(g_attribLocationPosition, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)(offset + OFFSETOF(ImDrawVert, pos)));
+			glVertexAttribPointer(g_attribLocationUV, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)(offset + OFFSETOF(ImDrawVert, uv)));
+			glVertexAttribPointer(g_attribLocationColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)(offset + OFFSETOF(ImDrawVert, col)));
+		#undef OFFSETOF
+		}
+
 		static void renderDrawLists(ImDrawData* draw_data) {
-			// Backup GL state
-			GLint last_program, last_texture, last_array_buffer, last_element_array_buffer, last_vertex_array;
-			glGetIntegerv(GL_CURRENT_PROGRAM, &last_program);
-			glGetIntegerv(GL_TEXTURE_BINDING_2D, &last_texture);
-			glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &last_array_buffer);
-			glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &last_element_array_buffer);
-			glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &last_vertex_array);
+			// Backup GL state (from the shadow copy, glGet can stall)
+			gl_state &state = glState();
+			gl_state::snapshot last_state = state.save();
 
 			// Setup render state: alpha-blending enabled, no face culling, no depth testing, scissor enabled
-			glEnable(GL_BLEND);
+			state.enable(GL_BLEND);
 			glBlendEquation(GL_FUNC_ADD);
 			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			glDisable(GL_CULL_FACE);
-			glDisable(GL_DEPTH_TEST);
-			glEnable(GL_SCISSOR_TEST);
-			glActiveTexture(GL_TEXTURE0);
+			state.disable(GL_CULL_FACE);
+			state.disable(GL_DEPTH_TEST);
+			state.enable(GL_SCISSOR_TEST);
+			state.activeTexture(GL_TEXTURE0);
 
 			// Handle cases of screen coordinates != from framebuffer coordinates (e.g. retina displays)
 			ImGuiIO& io = ImGui::GetIO();
@@ -161,47 +159,78 @@ namespace cgra {
 				{ 0.0f,                  0.0f,                  -1.0f, 0.0f },
 				{-1.0f,                  1.0f,                   0.0f, 1.0f },
 			};
-			glUseProgram(g_shaderHandle);
+			state.useProgram(g_shaderHandle);
 			glUniform1i(g_attribLocationTex, 0);
 			glUniformMatrix4fv(g_attribLocationProjMtx, 1, GL_FALSE, &ortho_projection[0][0]);
-			glBindVertexArray(g_vaoHandle);
+			state.bindVertexArray(g_vaoHandle);
 
+			// Copy every list into one range of each stream, rather than
+			// respecifying the buffers once per list
+			size_t vtx_offset = 0, idx_offset = 0;
+			ImDrawVert* vtx_dst = (ImDrawVert*)g_vertexStream.map(draw_data->TotalVtxCount * sizeof(ImDrawVert), sizeof(ImDrawVert), vtx_offset);
+			ImDrawIdx* idx_dst = (ImDrawIdx*)g_indexStream.map(draw_data->TotalIdxCount * sizeof(ImDrawIdx), sizeof(ImDrawIdx), idx_offset);
 			for (int n = 0; n < draw_data->CmdListsCount; n++)
 			{
 				const ImDrawList* cmd_list = draw_data->CmdLists[n];
-				const ImDrawIdx* idx_buffer_offset = 0;
+				memcpy(vtx_dst, cmd_list->VtxBuffer.Data, cmd_list->VtxBuffer.Size * sizeof(ImDrawVert));
+				memcpy(idx_dst, cmd_list->IdxBuffer.Data, cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx));
+				vtx_dst += cmd_list->VtxBuffer.Size;
+				idx_dst += cmd_list->IdxBuffer.Size;
+			}
+			g_vertexStream.unmap();
+			g_indexStream.unmap();
 
-				glBindBuffer(GL_ARRAY_BUFFER, g_vboHandle);
-				glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmd_list->VtxBuffer.size() * sizeof(ImDrawVert), (GLvoid*)&cmd_list->VtxBuffer.front(), GL_STREAM_DRAW);
+			// With base vertex the attributes are set up once and each list's
+			// indices are offset by where its vertices start, otherwise the
+			// attributes are moved for every list
+			const bool base_vertex = GLEW_VERSION_3_2 || GLEW_ARB_draw_elements_base_vertex;
+			GLint vtx_start = (GLint)(vtx_offset / sizeof(ImDrawVert));
+			size_t idx_buffer_offset = idx_offset;
+			if (base_vertex) setVertexPointers(0);
 
-				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_elementsHandle);
-				glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmd_list->IdxBuffer.size() * sizeof(ImDrawIdx), (GLvoid*)&cmd_list->IdxBuffer.front(), GL_STREAM_DRAW);
+			// Only change the scissor when it differs from the last command
+			ImVec4 clip_rect(-1, -1, -1, -1);
+
+			for (int n = 0; n < draw_data->CmdListsCount; n++)
+			{
+				const ImDrawList* cmd_list = draw_data->CmdLists[n];
+				if (!base_vertex) setVertexPointers(vtx_start * sizeof(ImDrawVert));
 
 				for (const ImDrawCmd* pcmd = cmd_list->CmdBuffer.begin(); pcmd != cmd_list->CmdBuffer.end(); pcmd++)
 				{
 					if (pcmd->UserCallback)
 					{
 						pcmd->UserCallback(cmd_list, pcmd);
+						state.invalidate();
+						clip_rect = ImVec4(-1, -1, -1, -1);
 					}
 					else
 					{
-						glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->TextureId);
-						glScissor((int)pcmd->ClipRect.x, (int)(fb_height - pcmd->ClipRect.w), (int)(pcmd->ClipRect.z - pcmd->ClipRect.x), (int)(pcmd->ClipRect.w - pcmd->ClipRect.y));
-						glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, GL_UNSIGNED_SHORT, idx_buffer_offset);
+						state.bindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->TextureId);
+						const ImVec4& r = pcmd->ClipRect;
+						if (r.x != clip_rect.x || r.y != clip_rect.y || r.z != clip_rect.z || r.w != clip_rect.w) {
+							glScissor((int)r.x, (int)(fb_height - r.w), (int)(r.z - r.x), (int)(r.w - r.y));
+							clip_rect = r;
+						}
+						if (base_vertex)
+							glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, GL_UNSIGNED_SHORT, (const GLvoid*)(intptr_t)idx_buffer_offset, vtx_start);
+						else
+							glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, GL_UNSIGNED_SHORT, (const GLvoid*)(intptr_t)idx_buffer_offset);
 					}
-					idx_buffer_offset += pcmd->ElemCount;
+					idx_buffer_offset += pcmd->ElemCount * sizeof(ImDrawIdx);
 				}
+				vtx_start += cmd_list->VtxBuffer.Size;
 			}
 
+			// Fence this frame's ranges so they are not overwritten while being drawn
+			g_vertexStream.endFrame();
+			g_indexStream.endFrame();
+
 			// Restore modified GL state
-			glUseProgram(last_program);
-			glBindTexture(GL_TEXTURE_2D, last_texture);
-			glBindBuffer(GL_ARRAY_BUFFER, last_array_buffer);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, last_element_array_buffer);
-			glBindVertexArray(last_vertex_array);
-			glDisable(GL_SCISSOR_TEST);
-
-			glDisable(GL_BLEND);
+			state.restore(last_state);
+			state.disable(GL_SCISSOR_TEST);
+
+			state.disable(GL_BLEND);
 		}
 
 
@@ -293,10 +322,10 @@ namespace cgra {
 
 
 		void shutdown() {
-			if (g_vaoHandle) glDeleteVertexArrays(1, &g_vaoHandle);
-			if (g_vboHandle) glDeleteBuffers(1, &g_vboHandle);
-			if (g_elementsHandle) glDeleteBuffers(1, &g_elementsHandle);
-			g_vaoHandle = g_vboHandle = g_elementsHandle = 0;
+			glState().deleteVertexArray(g_vaoHandle);
+			g_vertexStream.destroy();
+			g_indexStream.destroy();
+			g_vaoHandle = 0;
 
 			glDetachShader(g_shaderHandle, g_vertHandle);
 			glDeleteShader(g_vertHandle);
@@ -311,7 +340,7 @@ namespace cgra {
 
 			if (g_fontTexture)
 			{
-				glDeleteTextures(1, &g_fontTexture);
+				glState().deleteTexture(g_fontTexture);
 				ImGui::GetIO().Fonts->TexID = 0;
 				g_fontTexture = 0;
 			}
@@ -19,7 +19,9 @@
 #include <fstream>
 #include <sstream>
 
+#include "cgra_math.hpp"
 #include "opengl.hpp"
+#include "shader_cache.hpp"
 
 namespace cgra {
 
@@ -94,21 +96,10 @@ namespace cgra {
 		printProgramInfoLog(prog);
 	}
 
+	// Programs are built through programCache(), which reuses shader
+	// objects within a run and program binaries across runs
 	inline GLuint makeShaderProgram(const std::vector<GLenum> &stypes, const std::vector<std::string> &sources) {
-		if (stypes.size() != sources.size()) {
-			throw std::runtime_error("stypes and shader sources, vector size mismatch");
-		}
-
-		GLuint prog = glCreateProgram();
-
-		for (size_t i = 0; i < stypes.size(); ++i) {
-			auto shader = compileShader(stypes[i], sources[i]);
-			glAttachShader(prog, shader);
-		}
-
-		linkShaderProgram(prog);
-		std::cout << "SimpleShader : " << "Shader program compiled and linked successfully" << std::endl;
-		return prog;
+		return programCache().makeProgram(stypes, sources);
 	}
 
 	inline GLuint makeShaderProgramFromFile(const std::vector<GLenum> &stypes, const std::vector<std::string> &sourcefiles) {
@@ -128,12 +119,11 @@ namespace cgra {
 		return makeShaderProgram(stypes, sources);
 	}
 
-	// The following use a cuteom something something
-	// TODO write a better explanation
+	// The following build every stage from a single source, prepending
+	// "#version <profile>" and a define naming the stage (eg. _VERTEX_)
 	//
-	inline GLuint makeShaderProgram(const std::string &profile, const std::vector<GLenum> &stypes, const std::string &source) {
-		GLuint prog = glCreateProgram();
-
+	// Sources for each stage of a single source program
+	inline std::vector<std::string> shaderStageSources(const std::string &profile, const std::vector<GLenum> &stypes, const std::string &source) {
 		auto get_define = [](GLenum stype) {
 			switch (stype) {
 			case GL_VERTEX_SHADER:
@@ -151,18 +141,20 @@ namespace cgra {
 			}
 		};
 
+		std::vector<std::string> sources;
 		for (auto stype : stypes) {
 			std::ostringstream oss;
 			oss << "#version " << profile << std::endl;
 			oss << "#define " << get_define(stype) << std::endl;
 			oss << source;
-			auto shader = compileShader(stype, oss.str());
-			glAttachShader(prog, shader);
+			sources.push_back(oss.str());
 		}
 
-		linkShaderProgram(prog);
-		std::cout << "SimpleShader : " << "Shader program compiled and linked successfully" << std::endl;
-		return prog;
+		return sources;
+	}
+
+	inline GLuint makeShaderProgram(const std::string &profile, const std::vector<GLenum> &stypes, const std::string &source) {
+		return makeShaderProgram(stypes, shaderStageSources(profile, stypes, source));
 	}
 
 	inline GLuint makeShaderProgramFromFile(const std::string &profile, const std::vector<GLenum> &stypes, const std::string &sourcefile) {
@@ -177,4 +169,26 @@ namespace cgra {
 
 		return makeShaderProgram(profile, stypes, buffer.str());
 	}	
-}
\ No newline at end of file
+
+
+	// Affine transforms are given to GLSL as mat3x4, which holds the
+	// transpose of the transform, so shaders apply them with
+	// vec4(p, 1) * m (giving a vec3)
+	//
+
+	// Uploads count transforms to a mat3x4 uniform (array)
+	inline void uniformAffine(GLint location, const affine3 *a, GLsizei count = 1) {
+		glUniformMatrix3x4fv(location, count, GL_FALSE, a->dataPointer());
+	}
+
+	// Sets up the three consecutive vec4 attributes starting at index to
+	// read transforms from the bound buffer (eg. per instance data), at
+	// the given byte offset and stride
+	inline void vertexAttribAffine(GLuint index, GLsizei stride, size_t offset = 0) {
+		for (GLuint i = 0; i < 3; i++) {
+			glEnableVertexAttribArray(index + i);
+			glVertexAttribPointer(index + i, 4, GL_FLOAT, GL_FALSE, stride,
+				reinterpret_cast<const GLvoid *>(offset + i * sizeof(vec4)));
+		}
+	}
+}
@@ -12,6 +12,8 @@
 //
 //----------------------------------------------------------------------------
 
+#include <cassert>
+#include <cctype>
 #include <cmath>
 #include <iostream>
 #include <fstream>
@@ -36,6 +38,7 @@ Skeleton::Skeleton(string filename) {
 	b.freedom |= dof_root;
 	m_bones.push_back(b);
 	readASF(filename);
+	buildDofGroups();
 }
 
 //-------------------------------------------------------------
@@ -100,6 +103,251 @@ void Skeleton::renderBone(bone *b) {
 }
 
 
+namespace {
+	// Rotation for euler angles (degrees) applied in x, y, z order
+	mat4 eulerRotation(const vec3 &r) {
+		return mat4::rotateZ(radians(r.z)) * mat4::rotateY(radians(r.y)) * mat4::rotateX(radians(r.x));
+	}
+}
+
+
+pose Skeleton::currentPose() const {
+	pose p;
+	for (const bone &b : m_bones) {
+		p.rotation.push_back(b.rotation);
+	}
+	p.translation = m_bones[0].translation;
+	return p;
+}
+
+
+namespace {
+
+	// Number of motion channels for a set of degrees of freedom
+	constexpr int channelCount(dof_set freedom) {
+		return ((freedom & dof_root) ? 3 : 0) + ((freedom & dof_rx) != 0) + ((freedom & dof_ry) != 0) + ((freedom & dof_rz) != 0);
+	}
+
+
+	// Kernels specialized for each combination of degrees of freedom. The
+	// tests on Dofs are compile time constants, so each instantiation only
+	// reads and computes the channels that it has.
+
+	// Samples the joints of group g between frames c0 and c1
+	template <dof_set Dofs>
+	void sampleJoints(const dof_group &g, const float *c0, const float *c1, float t, pose &p) {
+		for (size_t k = 0; k < g.bones.size(); k++) {
+			const float *a = c0 + g.channels[k], *b = c1 + g.channels[k];
+			vec3 r;
+			if (Dofs & dof_root) {
+				p.translation = mix(vec3(a[0], a[1], a[2]), vec3(b[0], b[1], b[2]), t);
+				a += 3;
+				b += 3;
+			}
+			int c = 0;
+			if (Dofs & dof_rx) { r.x = a[c] + (b[c] - a[c]) * t; c++; }
+			if (Dofs & dof_ry) { r.y = a[c] + (b[c] - a[c]) * t; c++; }
+			if (Dofs & dof_rz) { r.z = a[c] + (b[c] - a[c]) * t; c++; }
+			p.rotation[g.bones[k]] = r;
+		}
+	}
+
+	// Rotates the rows m[i] and m[j] of a matrix by the given angle (degrees),
+	// the same as multiplying by an axis rotation on the left
+	inline void rotateRows(vec3 &mi, vec3 &mj, float angle) {
+		float s = std::sin(radians(angle)), c = std::cos(radians(angle));
+		vec3 i = mi;
+		mi = c * i - s * mj;
+		mj = s * i + c * mj;
+	}
+
+	// Local transform of the joints of group g, C * Rz * Ry * Rx * C^-1
+	// followed by the offset to the start of the bone. Starting from C^-1
+	// (the transpose of C, its rows are the columns of C), each axis rotation
+	// only changes two rows, and axes without a dof are skipped entirely.
+	template <dof_set Dofs>
+	void evaluateJoints(const dof_group &g, const pose &p, vector<affine3> &local) {
+		for (size_t k = 0; k < g.bones.size(); k++) {
+			int i = g.bones[k];
+			vec3 t = (Dofs & dof_root) ? p.translation : g.offset[k];
+			if (!(Dofs & (dof_rx | dof_ry | dof_rz))) {
+				local[i] = affine3::translate(t);
+				continue;
+			}
+
+			const mat3 &C = g.basis[k];
+			const vec3 &r = p.rotation[i];
+			vec3 m0 = C[0], m1 = C[1], m2 = C[2];
+			if (Dofs & dof_rx) rotateRows(m1, m2, r.x);
+			if (Dofs & dof_ry) rotateRows(m2, m0, r.y);
+			if (Dofs & dof_rz) rotateRows(m0, m1, r.z);
+
+			// C times the rows m0, m1, m2
+			mat3 R(
+				C[0] * m0.x + C[1] * m1.x + C[2] * m2.x,
+				C[0] * m0.y + C[1] * m1.y + C[2] * m2.y,
+				C[0] * m0.z + C[1] * m1.z + C[2] * m2.z);
+			local[i] = affine3(R, t);
+		}
+	}
+
+	using sample_kernel = void (*)(const dof_group &, const float *, const float *, float, pose &);
+	using evaluate_kernel = void (*)(const dof_group &, const pose &, vector<affine3> &);
+
+	// Kernels for every dof_set, indexed by the set
+	template <dof_set... Dofs>
+	struct dof_kernels {
+		static constexpr sample_kernel sample[] = { sampleJoints<Dofs>... };
+		static constexpr evaluate_kernel evaluate[] = { evaluateJoints<Dofs>... };
+	};
+
+	template <dof_set... Dofs>
+	constexpr sample_kernel dof_kernels<Dofs...>::sample[];
+
+	template <dof_set... Dofs>
+	constexpr evaluate_kernel dof_kernels<Dofs...>::evaluate[];
+
+	using kernels = dof_kernels<0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15>;
+}
+
+
+// Groups the bones by their degrees of freedom and lays out their channels
+// in a frame of motion. Called once the whole skeleton has been read.
+void Skeleton::buildDofGroups() {
+	// Lay out the channels of each bone in a frame, in bone order.
+	// The root has 3 translation channels before its rotation.
+	m_channels = 0;
+	for (bone &b : m_bones) {
+		assert(b.freedom < 16);
+		b.channel = m_channels;
+		m_channels += channelCount(b.freedom);
+	}
+
+	// Parents before children, starting from the root
+	m_order.clear();
+	m_parent.assign(m_bones.size(), -1);
+	vector<int> stack { 0 };
+	while (!stack.empty()) {
+		int i = stack.back();
+		stack.pop_back();
+		m_order.push_back(i);
+		for (const bone *c : m_bones[i].children) {
+			int ci = int(c - &m_bones[0]);
+			m_parent[ci] = i;
+			stack.push_back(ci);
+		}
+	}
+
+	// One group for each dof_set used, in order of the set
+	m_dofGroups.clear();
+	for (dof_set freedom = 0; freedom < 16; freedom++) {
+		dof_group g;
+		g.freedom = freedom;
+		for (int i : m_order) {
+			const bone &b = m_bones[i];
+			if (b.freedom != freedom) continue;
+			g.bones.push_back(i);
+			g.channels.push_back(b.channel);
+			g.basis.push_back(mat3(vec3(b.basis[0]), vec3(b.basis[1]), vec3(b.basis[2])));
+			int parent = m_parent[i];
+			g.offset.push_back((parent < 0) ? vec3() : m_bones[parent].boneDir * m_bones[parent].length);
+		}
+		if (!g.bones.empty()) m_dofGroups.push_back(move(g));
+	}
+}
+
+
+void Skeleton::samplePose(float frame, pose &p) const {
+	if (m_frames == 0) {
+		p = currentPose();
+		return;
+	}
+
+	// Frames either side of the sample, wrapping around at the end
+	float whole = std::floor(frame);
+	float t = frame - whole;
+	int f0 = int(whole) % m_frames;
+	if (f0 < 0) f0 += m_frames;
+	int f1 = (f0 + 1) % m_frames;
+
+	const float *c0 = &m_motion[size_t(f0) * m_channels];
+	const float *c1 = &m_motion[size_t(f1) * m_channels];
+
+	p.rotation.resize(m_bones.size());
+	for (const dof_group &g : m_dofGroups) {
+		kernels::sample[g.freedom](g, c0, c1, t, p);
+	}
+}
+
+
+// Local transforms of every joint from the group kernels, then composed
+// down the hierarchy
+void Skeleton::evaluatePose(const pose &p, vector<affine3> &world) const {
+	world.resize(m_bones.size());
+	for (const dof_group &g : m_dofGroups) {
+		kernels::evaluate[g.freedom](g, p, world);
+	}
+	for (int i : m_order) {
+		if (m_parent[i] >= 0) world[i] = world[m_parent[i]] * world[i];
+	}
+}
+
+
+void Skeleton::samplePoseGeneric(float frame, pose &p) const {
+	if (m_frames == 0) {
+		p = currentPose();
+		return;
+	}
+
+	// Frames either side of the sample, wrapping around at the end
+	float whole = std::floor(frame);
+	float t = frame - whole;
+	int f0 = int(whole) % m_frames;
+	if (f0 < 0) f0 += m_frames;
+	int f1 = (f0 + 1) % m_frames;
+
+	const float *c0 = &m_motion[size_t(f0) * m_channels];
+	const float *c1 = &m_motion[size_t(f1) * m_channels];
+
+	p.rotation.resize(m_bones.size());
+	for (size_t i = 0; i < m_bones.size(); i++) {
+		const bone &b = m_bones[i];
+		int c = b.channel;
+		vec3 r;
+
+		if (b.freedom & dof_root) {
+			p.translation = mix(vec3(c0[c], c0[c+1], c0[c+2]), vec3(c1[c], c1[c+1], c1[c+2]), t);
+			c += 3;
+		}
+		if (b.freedom & dof_rx) { r.x = c0[c] + (c1[c] - c0[c]) * t; c++; }
+		if (b.freedom & dof_ry) { r.y = c0[c] + (c1[c] - c0[c]) * t; c++; }
+		if (b.freedom & dof_rz) { r.z = c0[c] + (c1[c] - c0[c]) * t; c++; }
+
+		p.rotation[i] = r;
+	}
+}
+
+
+void Skeleton::evaluatePoseGeneric(const pose &p, vector<affine3> &world) const {
+	world.resize(m_bones.size());
+	evaluateBone(&m_bones[0], affine3::translate(p.translation), p, world);
+}
+
+
+// The joint rotation is applied in the bone's local basis (C * R * C^-1)
+// and every child starts at the end of its parent
+void Skeleton::evaluateBone(const bone *b, const affine3 &parent, const pose &p, vector<affine3> &world) const {
+	size_t i = b - &m_bones[0];
+	affine3 m = parent * affine3(b->basis * eulerRotation(p.rotation[i]) * b->basisInverse);
+	world[i] = m;
+
+	affine3 end = m * affine3::translate(b->boneDir * b->length);
+	for (const bone *c : b->children) {
+		evaluateBone(c, end, p, world);
+	}
+}
+
+
 // Helper method for retreiving and trimming the next line in a file.
 // You should not need to modify this method.
 namespace {
@@ -265,6 +513,8 @@ void Skeleton::readBone(ifstream &file) {
 		if (line == "end") {
 			// End of the data for this bone
 			// Push the bone into the vector
+			b.basis = eulerRotation(b.basisRot);
+			b.basisInverse = inverseRigid(b.basis);
 			m_bones.push_back(b);
 			return;
 		}
@@ -385,9 +635,75 @@ void Skeleton::readHierarchy(ifstream &file) {
 // Complete the following method to load data from an *.amc file
 //-------------------------------------------------------------
 void Skeleton::readAMC(string filename) {
-	// YOUR CODE GOES HERE
-	// ...
 
+	ifstream file(filename);
+
+	if (!file.is_open()) {
+		cerr << "Failed to open file " <<  filename << endl;
+		throw runtime_error("Error :: could not open file.");
+	}
+
+	cout << "Reading file" << filename << endl;
+
+	// Channels were laid out by buildDofGroups
+	m_motion.clear();
+	m_frames = 0;
+
+	while (file.good()) {
+
+		// Pull out line from file
+		string line = nextLineTrimmed(file);
+
+		// Skip comments, empty lines and the ':FULLY-SPECIFIED'/':DEGREES' headers
+		if (line.empty() || line[0] == '#' || line[0] == ':')
+			continue;
+
+		istringstream lineStream(line);
+
+		if (isdigit(line[0])) {
+			// A line with only the frame number starts a new frame
+			m_motion.resize(m_motion.size() + m_channels, 0.f);
+			m_frames++;
+			continue;
+		}
+
+		if (m_frames == 0) {
+			cerr << "Expected a frame number, found \"" << line << "\"" << endl;
+			throw runtime_error("Error :: could not parse .amc file.");
+		}
+
+		string name;
+		lineStream >> name;
+		int boneIndex = findBone(name);
+		if (boneIndex < 0) {
+			cerr << "Expected a valid bone name, found \"" << name << "\"" << endl;
+			throw runtime_error("Error :: could not parse .amc file.");
+		}
+
+		const bone &b = m_bones[boneIndex];
+		float *channels = &m_motion[size_t(m_frames - 1) * m_channels + b.channel];
+
+		if (b.freedom & dof_root) {
+			// translation is in the same units as the bone lengths
+			for (int i = 0; i < 3; i++) {
+				lineStream >> channels[i];
+				channels[i] *= (1.0/0.45) * 0.0254;
+			}
+			channels += 3;
+		}
+
+		int rotations = ((b.freedom & dof_rx) != 0) + ((b.freedom & dof_ry) != 0) + ((b.freedom & dof_rz) != 0);
+		for (int i = 0; i < rotations; i++) {
+			lineStream >> channels[i];
+		}
+
+		if (lineStream.fail()) {
+			cerr << "Unable to parse \"" << line << "\"" << endl;
+			throw runtime_error("Error :: could not parse .amc file.");
+		}
+	}
+
+	cout << "Completed reading motion file, " << m_frames << " frames" << endl;
 }
 
 // YOUR CODE GOES HERE
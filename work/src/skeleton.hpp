@@ -51,6 +51,8 @@ struct bone {
 	float length = 0;             // Length of the bone
 	cgra::vec3 boneDir;           // Direction of the bone
 	cgra::vec3 basisRot;          // Euler angle rotations for the bone basis
+	cgra::mat4 basis = cgra::mat4::identity();        // Rotation matrix of basisRot (C)
+	cgra::mat4 basisInverse = cgra::mat4::identity(); // and its inverse (C^-1)
 	dof_set freedom = dof_none;   // Degrees of freedom for the joint rotation
 	std::vector<bone *> children; // Pointers to bone children
 
@@ -61,6 +63,28 @@ struct bone {
 	cgra::vec3 translation;       // Translation (Only for the Root)
 	cgra::vec3 rotation_max;      // Maximum value for rotation for this joint (degrees)
 	cgra::vec3 rotation_min;      // Minimum value for rotation for this joint (degrees)
+
+	// Motion
+	int channel = 0;              // Offset of this bone's first channel in a frame of motion
+};
+
+
+// Rotation of every bone (degrees, indexed the same as the skeleton's
+// bones) and the translation of the root
+struct pose {
+	std::vector<cgra::vec3> rotation;
+	cgra::vec3 translation;
+};
+
+
+// Bones that have the same degrees of freedom, so their joints can be
+// sampled and evaluated by a kernel specialized for exactly those channels
+struct dof_group {
+	dof_set freedom = dof_none;
+	std::vector<int> bones;           // Index of each bone in the skeleton
+	std::vector<int> channels;        // First channel of each bone (bone::channel)
+	std::vector<cgra::mat3> basis;    // Basis of each bone (C)
+	std::vector<cgra::vec3> offset;   // Start of each bone in its parent's frame
 };
 
 
@@ -69,8 +93,21 @@ class Skeleton {
 private:
 	std::vector<bone> m_bones;
 
+	// Motion read from an AMC file. Every frame is m_channels floats,
+	// holding the channels of each bone back to back (see bone::channel)
+	std::vector<float> m_motion;
+	int m_channels = 0;
+	int m_frames = 0;
+
+	// Bones grouped by their degrees of freedom, and the order to compose
+	// their transforms in (every parent before its children)
+	std::vector<dof_group> m_dofGroups;
+	std::vector<int> m_order;
+	std::vector<int> m_parent;        // Parent of each bone, -1 for the root
+
 	// Helper method
 	int findBone(std::string);
+	void buildDofGroups();
 	
 	// Reading code
 	void readASF(std::string);
@@ -80,11 +117,43 @@ private:
 
 	void renderBone(bone *);
 
+	void evaluateBone(const bone *, const cgra::affine3 &, const pose &, std::vector<cgra::affine3> &) const;
+
 public:
 	Skeleton(std::string);
 	void renderSkeleton();
 	void readAMC(std::string);
 
+	// Bones in file order, the root is always first
+	const std::vector<bone> & bones() const { return m_bones; }
+
+	// Number of frames of motion read by readAMC
+	int frameCount() const { return m_frames; }
+
+	// The motion, frameCount() frames of channelsPerFrame() floats (see bone::channel)
+	const std::vector<float> & motion() const { return m_motion; }
+	int channelsPerFrame() const { return m_channels; }
+
+	// The rotations/translation currently stored in the bones
+	pose currentPose() const;
+
+	// Samples the motion at a (fractional) frame, interpolating between
+	// whole frames. Uses currentPose() if no motion has been read.
+	void samplePose(float, pose &) const;
+
+	// Evaluates a pose into the world transform at the start of every
+	// bone (indexed the same as bones())
+	void evaluatePose(const pose &, std::vector<cgra::affine3> &) const;
+
+	// The same as samplePose and evaluatePose, but branching on the degrees
+	// of freedom of every bone instead of running the kernel specialized for
+	// each dof group (kept to check and benchmark the kernels against)
+	void samplePoseGeneric(float, pose &) const;
+	void evaluatePoseGeneric(const pose &, std::vector<cgra::affine3> &) const;
+
+	// Bones grouped by their degrees of freedom
+	const std::vector<dof_group> & dofGroups() const { return m_dofGroups; }
+
 	// YOUR CODE GOES HERE
 	// ...
 };
@@ -0,0 +1,246 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "cgra_geometry.hpp"
+#include "cgra_math.hpp"
+#include "frame_arena.hpp"
+#include "gl_state.hpp"
+#include "opengl.hpp"
+#include "simple_shader.hpp"
+#include "skeleton_renderer.hpp"
+
+using namespace std;
+using namespace cgra;
+
+
+namespace {
+	// Corners of the sphere quad, drawn as a triangle strip
+	const float quad_corners[] = {
+		-1, -1,
+		 1, -1,
+		-1,  1,
+		 1,  1
+	};
+
+	// Corners of the capsule bounding box, drawn as a single triangle strip
+	const float box_corners[] = {
+		-1,  1,  1,
+		 1,  1,  1,
+		-1, -1,  1,
+		 1, -1,  1,
+		 1, -1, -1,
+		 1,  1,  1,
+		 1,  1, -1,
+		-1,  1,  1,
+		-1,  1, -1,
+		-1, -1,  1,
+		-1, -1, -1,
+		 1, -1, -1,
+		-1,  1, -1,
+		 1,  1, -1
+	};
+
+	const int quad_vertex_count = 4;
+	const int box_vertex_count = 14;
+
+	string shaderPath(const string &name) {
+		return string(CGRA_SRCDIR) + "/res/shaders/" + name;
+	}
+
+	// Queries the locations only when the program has changed
+	void updateAttribs(impostor_attribs &a, GLuint program, const char *first, const char *second) {
+		if (a.program == program) return;
+		a.program = program;
+		a.corner = glGetAttribLocation(program, "a_corner");
+		a.first = glGetAttribLocation(program, first);
+		a.second = second ? glGetAttribLocation(program, second) : -1;
+	}
+
+	// Float attribute from the bound array buffer, skipped if the program
+	// does not use it (eg. optimized out of an edited shader)
+	void enableAttrib(GLint location, GLint size, GLsizei stride, size_t offset, GLuint divisor) {
+		if (location < 0) return;
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, stride, (const GLvoid *) offset);
+		if (divisor) glVertexAttribDivisorARB(location, divisor);
+	}
+
+	void disableAttrib(GLint location, bool instanced) {
+		if (location < 0) return;
+		if (instanced) glVertexAttribDivisorARB(location, 0);
+		glDisableVertexAttribArray(location);
+	}
+}
+
+
+void SkeletonRenderer::init() {
+	// Needs generic attribute divisors and instanced draws (core in 3.3)
+	if (!GLEW_ARB_instanced_arrays || !GLEW_ARB_draw_instanced) {
+		cout << "SkeletonRenderer : instancing not available, impostors disabled" << endl;
+		return;
+	}
+
+	// Both are submitted before either is waited on, so the driver can build them together
+	vector<GLenum> stages = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+	m_sphereProgram.load("120", stages, shaderPath("impostor_sphere.glsl"));
+	m_capsuleProgram.load("120", stages, shaderPath("impostor_capsule.glsl"));
+
+	glGenBuffers(1, &m_quadBuffer);
+	glState().bindBuffer(GL_ARRAY_BUFFER, m_quadBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad_corners), quad_corners, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &m_boxBuffer);
+	glState().bindBuffer(GL_ARRAY_BUFFER, m_boxBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(box_corners), box_corners, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &m_instanceBuffer);
+	glState().bindBuffer(GL_ARRAY_BUFFER, 0);
+
+	m_impostorsSupported = true;
+}
+
+
+void SkeletonRenderer::setMode(render_mode mode) {
+	if (mode == render_mode::impostor && !m_impostorsSupported) return;
+	m_mode = mode;
+}
+
+
+bool SkeletonRenderer::update() {
+	if (!m_impostorsSupported) return false;
+	bool finished = m_sphereProgram.poll();
+	finished = m_capsuleProgram.poll() || finished;
+	return finished;
+}
+
+
+void SkeletonRenderer::render(const Skeleton &skeleton, const vector<affine3> &world, const mat4 &view) {
+	if (m_mode == render_mode::impostor && impostorsReady())
+		renderImpostors(skeleton, world);
+	else
+		renderTessellated(skeleton, world, view);
+}
+
+
+void SkeletonRenderer::renderTessellated(const Skeleton &skeleton, const vector<affine3> &world, const mat4 &view) {
+	const vector<bone> &bones = skeleton.bones();
+	unsigned long start = cgraVertexCount();
+
+	glState().useProgram(0);
+	glMatrixMode(GL_MODELVIEW);
+	for (size_t i = 0; i < bones.size(); i++) {
+		const bone &b = bones[i];
+		// the root has no length and is not drawn
+		if (b.length <= 0) continue;
+
+		// the rotation below is about the bone's origin, so it does not change the LOD
+		mat4 model(world[i]);
+		mat4 modelview = view * model;
+		glPushMatrix();
+		glMultMatrixf(model.dataPointer());
+
+		// rotate z onto the bone direction
+		vec3 axis = cross(vec3(0, 0, 1), b.boneDir);
+		if (length(axis) > 1e-6f) {
+			float angle = degrees(std::acos(std::max(-1.f, std::min(1.f, b.boneDir.z))));
+			glRotatef(angle, axis.x, axis.y, axis.z);
+		} else if (b.boneDir.z < 0) {
+			glRotatef(180, 1, 0, 0);
+		}
+
+		cgraCylinderLOD(boneRadius, boneRadius, b.length, modelview);
+		cgraSphereLOD(jointRadius, modelview);
+		glPopMatrix();
+	}
+
+	m_vertices = cgraVertexCount() - start;
+}
+
+
+void SkeletonRenderer::renderImpostors(const Skeleton &skeleton, const vector<affine3> &world) {
+	const vector<bone> &bones = skeleton.bones();
+
+	// Build the instance data from the evaluated pose, it is only
+	// needed until it has been uploaded
+	frame_arena &arena = frameArena();
+	sphere_instance *spheres = arena.alloc<sphere_instance>(bones.size());
+	capsule_instance *capsules = arena.alloc<capsule_instance>(bones.size());
+	size_t count = 0;
+	for (size_t i = 0; i < bones.size(); i++) {
+		const bone &b = bones[i];
+		if (b.length <= 0) continue;
+
+		vec3 start = world[i].translation();
+		vec3 end = transformPoint(world[i], b.boneDir * b.length);
+		spheres[count] = { start, jointRadius };
+		capsules[count] = { start, boneRadius, end };
+		count++;
+	}
+
+	m_vertices = 0;
+	if (count == 0) return;
+
+	// Attributes are set up on the default vertex array, not whichever
+	// one was left bound (eg. the GUI's)
+	glState().bindVertexArray(0);
+
+	// Spheres
+	const impostor_attribs &sa = m_sphereAttribs;
+	updateAttribs(m_sphereAttribs, m_sphereProgram.program(), "a_sphere", nullptr);
+	glState().useProgram(sa.program);
+
+	glState().bindBuffer(GL_ARRAY_BUFFER, m_quadBuffer);
+	enableAttrib(sa.corner, 2, 0, 0, 0);
+
+	glState().bindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, count * sizeof(sphere_instance), spheres, GL_STREAM_DRAW);
+	enableAttrib(sa.first, 4, sizeof(sphere_instance), 0, 1);
+
+	glDrawArraysInstancedARB(GL_TRIANGLE_STRIP, 0, quad_vertex_count, GLsizei(count));
+	m_vertices += quad_vertex_count * count;
+
+	disableAttrib(sa.first, true);
+	disableAttrib(sa.corner, false);
+
+	// Capsules
+	const impostor_attribs &ca = m_capsuleAttribs;
+	updateAttribs(m_capsuleAttribs, m_capsuleProgram.program(), "a_start", "a_end");
+	glState().useProgram(ca.program);
+
+	glState().bindBuffer(GL_ARRAY_BUFFER, m_boxBuffer);
+	enableAttrib(ca.corner, 3, 0, 0, 0);
+
+	// the instance buffer is orphaned by the new upload, so the sphere draw is not stalled
+	glState().bindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, count * sizeof(capsule_instance), capsules, GL_STREAM_DRAW);
+	enableAttrib(ca.first, 4, sizeof(capsule_instance), 0, 1);
+	enableAttrib(ca.second, 3, sizeof(capsule_instance), offsetof(capsule_instance, end), 1);
+
+	glDrawArraysInstancedARB(GL_TRIANGLE_STRIP, 0, box_vertex_count, GLsizei(count));
+	m_vertices += box_vertex_count * count;
+
+	disableAttrib(ca.first, true);
+	disableAttrib(ca.second, true);
+	disableAttrib(ca.corner, false);
+
+	glState().bindBuffer(GL_ARRAY_BUFFER, 0);
+	glState().useProgram(0);
+}
@@ -0,0 +1,100 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+#include "cgra_math.hpp"
+#include "opengl.hpp"
+#include "shader_cache.hpp"
+#include "skeleton.hpp"
+
+
+// Per-instance data uploaded for the impostor shaders
+struct sphere_instance {
+	cgra::vec3 center;
+	float radius;
+};
+
+struct capsule_instance {
+	cgra::vec3 start;
+	float radius;
+	cgra::vec3 end;
+};
+
+
+// Attribute locations of an impostor program (-1 when unused), looked up
+// again whenever a different program is swapped in. A swapped in program
+// is created while the old one is still alive, so their names differ.
+struct impostor_attribs {
+	GLuint program = 0;
+	GLint corner = -1;
+	GLint first = -1;  // a_sphere, or a_start for capsules
+	GLint second = -1; // a_end for capsules
+};
+
+
+enum class render_mode {
+	tessellated, // cgraSphere/cgraCylinder through the fixed function pipeline
+	impostor     // one ray-cast quad per joint and one ray-cast box per bone
+};
+
+
+// Draws a posed skeleton as spheres (joints) and capsules (bones)
+class SkeletonRenderer {
+
+private:
+	render_mode m_mode = render_mode::tessellated;
+	bool m_impostorsSupported = false;
+	unsigned long m_vertices = 0;
+
+	// Impostor resources, the programs build in the background and the
+	// tessellated path is drawn until they are ready
+	cgra::async_program m_sphereProgram;
+	cgra::async_program m_capsuleProgram;
+	GLuint m_quadBuffer = 0;
+	GLuint m_boxBuffer = 0;
+	GLuint m_instanceBuffer = 0;
+	impostor_attribs m_sphereAttribs;
+	impostor_attribs m_capsuleAttribs;
+
+	void renderTessellated(const Skeleton &, const std::vector<cgra::affine3> &, const cgra::mat4 &view);
+	void renderImpostors(const Skeleton &, const std::vector<cgra::affine3> &);
+
+public:
+	float jointRadius = 0.02;
+	float boneRadius = 0.01;
+
+	// Must be called once the GL context is current
+	void init();
+
+	bool impostorsSupported() const { return m_impostorsSupported; }
+	bool impostorsReady() const { return m_sphereProgram.ready() && m_capsuleProgram.ready(); }
+	render_mode mode() const { return m_mode; }
+	void setMode(render_mode);
+
+	// Finishes shader builds and reloads edited shaders, call once per frame
+	// (fileWatcher() wakes the main loop while builds are pending). Returns
+	// true when a build finished and a frame is needed to show the result.
+	bool update();
+
+	// Draws the skeleton with the world transforms from Skeleton::evaluatePose.
+	// view must match the GL modelview matrix, it picks the tessellation
+	// level of each bone without reading the matrices back from GL.
+	void render(const Skeleton &, const std::vector<cgra::affine3> &, const cgra::mat4 &view);
+
+	// Vertices submitted by the last call to render
+	unsigned long verticesSubmitted() const { return m_vertices; }
+};
@@ -0,0 +1,328 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "skinning.hpp"
+
+#ifdef CGRA_SIMD_SSE
+#include <xmmintrin.h>
+#endif
+
+using namespace std;
+using namespace cgra;
+
+
+namespace {
+
+	// Smallest chunk worth starting a thread for, smaller meshes are
+	// skinned on the calling thread
+	const size_t minChunk = 16384;
+
+
+	// Threads kept for the life of the program, so skinning every frame
+	// does not start and join threads or allocate. One job runs at a time,
+	// its chunks are claimed by the workers and the calling thread.
+	class worker_pool {
+		mutex m_mutex;          // guards everything below but m_threads
+		mutex m_callMutex;      // one job at a time
+		condition_variable m_wake;
+		condition_variable m_done;
+		vector<thread> m_threads;
+
+		void (*m_run)(void *, size_t) = nullptr;
+		void *m_job = nullptr;
+		size_t m_chunks = 0;
+		size_t m_next = 0;      // next chunk to claim
+		size_t m_remaining = 0; // chunks not yet finished
+		unsigned long m_generation = 0;
+		bool m_stop = false;
+
+		// Claims the next chunk of the given job, if there is one left
+		// (these two are called with m_mutex held)
+		bool claim(unsigned long generation, size_t &chunk) {
+			if (m_generation != generation || m_next >= m_chunks) return false;
+			chunk = m_next++;
+			return true;
+		}
+
+		void finish() {
+			if (--m_remaining == 0) m_done.notify_one();
+		}
+
+		void work() {
+			unsigned long seen = 0;
+			unique_lock<mutex> lock(m_mutex);
+			while (true) {
+				m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+				if (m_stop) return;
+				seen = m_generation;
+
+				size_t chunk;
+				while (claim(seen, chunk)) {
+					void (*run)(void *, size_t) = m_run;
+					void *job = m_job;
+					lock.unlock();
+					run(job, chunk);
+					lock.lock();
+					finish();
+				}
+			}
+		}
+
+		template <typename F>
+		static void invoke(void *f, size_t chunk) { (*static_cast<F *>(f))(chunk); }
+
+	public:
+		worker_pool() {
+			unsigned n = max(1u, thread::hardware_concurrency()) - 1;
+			m_threads.reserve(n);
+			for (unsigned i = 0; i < n; i++) m_threads.emplace_back(&worker_pool::work, this);
+		}
+
+		~worker_pool() {
+			{
+				lock_guard<mutex> lock(m_mutex);
+				m_stop = true;
+			}
+			m_wake.notify_all();
+			for (thread &t : m_threads) t.join();
+		}
+
+		// Runs f(chunk) for every chunk in [0, chunks) and returns once all are done
+		template <typename F>
+		void run(size_t chunks, F &f) {
+			lock_guard<mutex> call(m_callMutex);
+			unique_lock<mutex> lock(m_mutex);
+			m_run = &invoke<F>;
+			m_job = &f;
+			m_chunks = chunks;
+			m_next = 0;
+			m_remaining = chunks;
+			unsigned long generation = ++m_generation;
+			m_wake.notify_all();
+
+			size_t chunk;
+			while (claim(generation, chunk)) {
+				lock.unlock();
+				f(chunk);
+				lock.lock();
+				finish();
+			}
+			m_done.wait(lock, [&] { return m_remaining == 0; });
+		}
+	};
+
+	worker_pool & workerPool() {
+		static worker_pool pool;
+		return pool;
+	}
+
+
+	// Runs f(begin, end) over [0, n) in chunks on up to the given number of
+	// threads of the worker pool, the calling thread included. Chunks are
+	// multiples of four vertices so only the last one has a remainder.
+	template <typename F>
+	void parallelChunks(size_t n, unsigned threads, F f) {
+		if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+		size_t chunks = min<size_t>(threads, max<size_t>(1, n / minChunk));
+		size_t perChunk = ((n + chunks - 1) / chunks + 3) & ~size_t(3);
+
+		if (perChunk == 0 || perChunk >= n) {
+			f(size_t(0), n);
+			return;
+		}
+		chunks = (n + perChunk - 1) / perChunk;
+		auto chunk = [&](size_t i) { f(i * perChunk, min(n, (i + 1) * perChunk)); };
+		workerPool().run(chunks, chunk);
+	}
+
+
+#ifdef CGRA_SIMD_SSE
+	// Loads the four floats at a, b, c and d and transposes them, so v[0]
+	// holds the first float of each, v[1] the second and so on
+	inline void gather(const float *a, const float *b, const float *c, const float *d, __m128 v[4]) {
+		v[0] = _mm_loadu_ps(a);
+		v[1] = _mm_loadu_ps(b);
+		v[2] = _mm_loadu_ps(c);
+		v[3] = _mm_loadu_ps(d);
+		_MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+	}
+
+	inline __m128 dot4(const __m128 a[4], const __m128 b[4]) {
+		return _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2])), _mm_mul_ps(a[3], b[3]));
+	}
+#endif
+
+
+	void linearBlendChunk(const vector<affine3> &joints, const skin_influences &influences,
+		const_vec3_span in, vec3_span out, size_t begin, size_t end)
+	{
+		size_t i = begin;
+#ifdef CGRA_SIMD_SSE
+		for (; i + 4 <= end; i += 4) {
+			// blend the rows of each vertex's matrix, then transpose them so
+			// r[row][component] holds that element for the four vertices
+			__m128 r[3][4];
+			for (int v = 0; v < 4; v++) {
+				__m128 r0 = _mm_setzero_ps(), r1 = _mm_setzero_ps(), r2 = _mm_setzero_ps();
+				for (int k = 0; k < skin_influences::slots; k++) {
+					const float *m = joints[influences.joint[k][i + v]].dataPointer();
+					__m128 w = _mm_set1_ps(influences.weight[k][i + v]);
+					r0 = _mm_add_ps(r0, _mm_mul_ps(_mm_loadu_ps(m), w));
+					r1 = _mm_add_ps(r1, _mm_mul_ps(_mm_loadu_ps(m + 4), w));
+					r2 = _mm_add_ps(r2, _mm_mul_ps(_mm_loadu_ps(m + 8), w));
+				}
+				r[0][v] = r0;
+				r[1][v] = r1;
+				r[2][v] = r2;
+			}
+			for (int row = 0; row < 3; row++) {
+				_MM_TRANSPOSE4_PS(r[row][0], r[row][1], r[row][2], r[row][3]);
+			}
+
+			__m128 x = _mm_loadu_ps(in.x + i), y = _mm_loadu_ps(in.y + i), z = _mm_loadu_ps(in.z + i);
+			float *o[3] = { out.x, out.y, out.z };
+			for (int row = 0; row < 3; row++) {
+				__m128 p = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r[row][0], x), _mm_mul_ps(r[row][1], y)), _mm_mul_ps(r[row][2], z)), r[row][3]);
+				_mm_storeu_ps(o[row] + i, p);
+			}
+		}
+#endif
+		for (; i < end; i++) {
+			vec3 p = Skinning::linearBlend(joints, influences, i, in[i]);
+			out.x[i] = p.x;
+			out.y[i] = p.y;
+			out.z[i] = p.z;
+		}
+	}
+
+
+	void dualQuaternionChunk(const vector<dualquat> &joints, const skin_influences &influences,
+		const_vec3_span in, vec3_span out, size_t begin, size_t end)
+	{
+		size_t i = begin;
+#ifdef CGRA_SIMD_SSE
+		const __m128 sign = _mm_set1_ps(-0.f), two = _mm_set1_ps(2);
+		for (; i + 4 <= end; i += 4) {
+			// blended real and dual parts, w, x, y and z for four vertices
+			__m128 br[4], bd[4], first[4];
+			for (int c = 0; c < 4; c++) br[c] = bd[c] = _mm_setzero_ps();
+
+			for (int k = 0; k < skin_influences::slots; k++) {
+				const uint16_t *j = influences.joint[k].data() + i;
+				__m128 real[4], dual[4];
+				gather(&joints[j[0]].real.w, &joints[j[1]].real.w, &joints[j[2]].real.w, &joints[j[3]].real.w, real);
+				gather(&joints[j[0]].dual.w, &joints[j[1]].dual.w, &joints[j[2]].dual.w, &joints[j[3]].dual.w, dual);
+				if (k == 0) copy(real, real + 4, first);
+
+				// flip into the hemisphere of the first joint
+				__m128 w = _mm_loadu_ps(influences.weight[k].data() + i);
+				w = _mm_xor_ps(w, _mm_and_ps(dot4(first, real), sign));
+				for (int c = 0; c < 4; c++) {
+					br[c] = _mm_add_ps(br[c], _mm_mul_ps(real[c], w));
+					bd[c] = _mm_add_ps(bd[c], _mm_mul_ps(dual[c], w));
+				}
+			}
+
+			// normalize
+			__m128 len = _mm_sqrt_ps(dot4(br, br));
+			for (int c = 0; c < 4; c++) {
+				br[c] = _mm_div_ps(br[c], len);
+				bd[c] = _mm_div_ps(bd[c], len);
+			}
+			__m128 rw = br[0], rx = br[1], ry = br[2], rz = br[3];
+			__m128 dw = bd[0], dx = bd[1], dy = bd[2], dz = bd[3];
+
+			// translation : 2 dual conjugate(real)
+			__m128 cx = _mm_xor_ps(rx, sign), cy = _mm_xor_ps(ry, sign), cz = _mm_xor_ps(rz, sign);
+			__m128 tx = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dw, cx), _mm_mul_ps(dx, rw)), _mm_mul_ps(dy, cz)), _mm_mul_ps(dz, cy));
+			__m128 ty = _mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(dw, cy), _mm_mul_ps(dx, cz)), _mm_mul_ps(dy, rw)), _mm_mul_ps(dz, cx));
+			__m128 tz = _mm_add_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(dw, cz), _mm_mul_ps(dx, cy)), _mm_mul_ps(dy, cx)), _mm_mul_ps(dz, rw));
+			tx = _mm_mul_ps(two, tx);
+			ty = _mm_mul_ps(two, ty);
+			tz = _mm_mul_ps(two, tz);
+
+			// rotation : v + w a + u x a, with a = 2 (u x v)
+			__m128 x = _mm_loadu_ps(in.x + i), y = _mm_loadu_ps(in.y + i), z = _mm_loadu_ps(in.z + i);
+			__m128 ax = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(ry, z), _mm_mul_ps(rz, y)));
+			__m128 ay = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(rz, x), _mm_mul_ps(rx, z)));
+			__m128 az = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(rx, y), _mm_mul_ps(ry, x)));
+			x = _mm_add_ps(_mm_add_ps(x, _mm_mul_ps(rw, ax)), _mm_sub_ps(_mm_mul_ps(ry, az), _mm_mul_ps(rz, ay)));
+			y = _mm_add_ps(_mm_add_ps(y, _mm_mul_ps(rw, ay)), _mm_sub_ps(_mm_mul_ps(rz, ax), _mm_mul_ps(rx, az)));
+			z = _mm_add_ps(_mm_add_ps(z, _mm_mul_ps(rw, az)), _mm_sub_ps(_mm_mul_ps(rx, ay), _mm_mul_ps(ry, ax)));
+
+			_mm_storeu_ps(out.x + i, _mm_add_ps(x, tx));
+			_mm_storeu_ps(out.y + i, _mm_add_ps(y, ty));
+			_mm_storeu_ps(out.z + i, _mm_add_ps(z, tz));
+		}
+#endif
+		for (; i < end; i++) {
+			vec3 p = Skinning::dualQuaternion(joints, influences, i, in[i]);
+			out.x[i] = p.x;
+			out.y[i] = p.y;
+			out.z[i] = p.z;
+		}
+	}
+}
+
+
+void Skinning::linearBlend(const vector<affine3> &joints, const skin_influences &influences,
+	const_vec3_span in, vec3_span out, unsigned threads)
+{
+	assert(in.size == influences.size() && out.size >= in.size);
+	parallelChunks(in.size, threads, [&](size_t begin, size_t end) {
+		linearBlendChunk(joints, influences, in, out, begin, end);
+	});
+}
+
+
+void Skinning::dualQuaternion(const vector<dualquat> &joints, const skin_influences &influences,
+	const_vec3_span in, vec3_span out, unsigned threads)
+{
+	assert(in.size == influences.size() && out.size >= in.size);
+	parallelChunks(in.size, threads, [&](size_t begin, size_t end) {
+		dualQuaternionChunk(joints, influences, in, out, begin, end);
+	});
+}
+
+
+vec3 Skinning::linearBlend(const vector<affine3> &joints, const skin_influences &influences, size_t i, const vec3 &p) {
+	vec4 r0, r1, r2;
+	for (int k = 0; k < skin_influences::slots; k++) {
+		const affine3 &m = joints[influences.joint[k][i]];
+		float w = influences.weight[k][i];
+		r0 += m.row(0) * w;
+		r1 += m.row(1) * w;
+		r2 += m.row(2) * w;
+	}
+	vec4 v(p, 1);
+	return vec3(dot(r0, v), dot(r1, v), dot(r2, v));
+}
+
+
+vec3 Skinning::dualQuaternion(const vector<dualquat> &joints, const skin_influences &influences, size_t i, const vec3 &p) {
+	dualquat q[skin_influences::slots];
+	float w[skin_influences::slots];
+	for (int k = 0; k < skin_influences::slots; k++) {
+		q[k] = joints[influences.joint[k][i]];
+		w[k] = influences.weight[k][i];
+	}
+	return transformPoint(blend(q, w, skin_influences::slots), p);
+}
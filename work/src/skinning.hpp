@@ -0,0 +1,68 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "cgra_math.hpp"
+#include "cgra_soa.hpp"
+#include "dualquat.hpp"
+
+
+// Joints that move each vertex of a skinned mesh, up to four per vertex.
+// Slot k of vertex i is joint[k][i] with weight[k][i], the weights of a
+// vertex sum to one and unused slots have weight zero (and any valid joint).
+// Each slot is its own array so vertices can be skinned four at a time.
+struct skin_influences {
+	static constexpr int slots = 4;
+
+	cgra::aligned_vector<uint16_t> joint[slots];
+	cgra::aligned_vector<float> weight[slots];
+
+	size_t size() const { return weight[0].size(); }
+
+	void resize(size_t n) {
+		for (int k = 0; k < slots; k++) {
+			joint[k].resize(n, 0);
+			weight[k].resize(n, 0.f);
+		}
+	}
+};
+
+
+// CPU skinning of mesh vertices by the joints of a skeleton.
+//
+// Joint transforms take a vertex from the bind pose to the current pose (the
+// joint's world transform times the inverse of its bind pose world transform).
+// Vertices are processed four at a time with SSE where cgra_math_simd.hpp
+// enables it, and meshes that are large enough are split into chunks that
+// are skinned on a persistent worker pool (threads = 0 uses every hardware
+// thread), so skinning every frame neither starts threads nor allocates.
+namespace Skinning {
+
+	// Linear blend skinning, blends the joint matrices of each vertex
+	void linearBlend(const std::vector<cgra::affine3> &joints, const skin_influences &influences,
+		cgra::const_vec3_span in, cgra::vec3_span out, unsigned threads = 0);
+
+	// Dual quaternion skinning, blends the joint dual quaternions of each vertex
+	void dualQuaternion(const std::vector<cgra::dualquat> &joints, const skin_influences &influences,
+		cgra::const_vec3_span in, cgra::vec3_span out, unsigned threads = 0);
+
+	// A single vertex, for reference and for the vertices left over when the
+	// count is not a multiple of four (the kernels give exactly the same result)
+	cgra::vec3 linearBlend(const std::vector<cgra::affine3> &joints, const skin_influences &influences, size_t i, const cgra::vec3 &p);
+	cgra::vec3 dualQuaternion(const std::vector<cgra::dualquat> &joints, const skin_influences &influences, size_t i, const cgra::vec3 &p);
+}
@@ -0,0 +1,157 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cassert>
+
+#include "gl_state.hpp"
+#include "stream_buffer.hpp"
+
+using namespace std;
+
+namespace cgra {
+
+	namespace {
+		const GLbitfield persistentFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		const GLuint64 fenceTimeout = 100000000; // 100ms, per wait
+	}
+
+
+	void stream_buffer::init(GLenum target, size_t size, const mode *forced) {
+		assert(size > 0);
+		release();
+		m_target = target;
+
+		bool sync = GLEW_VERSION_3_2 || GLEW_ARB_sync;
+		if (forced) {
+			m_mode = *forced;
+		} else if (sync && (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)) {
+			m_mode = mode::persistent;
+		} else if (sync) {
+			m_mode = mode::unsynchronized;
+		} else {
+			m_mode = mode::orphan;
+		}
+
+		create(size);
+	}
+
+
+	void stream_buffer::create(size_t size) {
+		glGenBuffers(1, &m_buffer);
+		glState().bindBuffer(m_target, m_buffer);
+		if (m_mode == mode::persistent) {
+			glBufferStorage(m_target, size, nullptr, persistentFlags);
+			m_persistent = glMapBufferRange(m_target, 0, size, persistentFlags);
+		} else {
+			glBufferData(m_target, size, nullptr, GL_STREAM_DRAW);
+		}
+		m_size = size;
+	}
+
+
+	void stream_buffer::release() {
+		for (frame_fence &f : m_fences) glDeleteSync(f.sync);
+		m_fences.clear();
+
+		// Deleting a mapped buffer unmaps it
+		glState().deleteBuffer(m_buffer);
+		m_buffer = 0;
+		m_size = 0;
+		m_persistent = nullptr;
+		m_mapped = false;
+		m_frameStart = m_head;
+	}
+
+
+	void stream_buffer::waitUntilFree(uint64_t end) {
+		// Bytes up to end were last written size bytes ago
+		if (end <= m_size) return;
+		uint64_t reused = end - m_size;
+
+		while (!m_fences.empty() && m_fences.front().start < reused) {
+			GLsync sync = m_fences.front().sync;
+			GLenum status = GL_TIMEOUT_EXPIRED;
+			while (status == GL_TIMEOUT_EXPIRED) {
+				status = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, fenceTimeout);
+			}
+			glDeleteSync(sync);
+			m_fences.pop_front();
+		}
+	}
+
+
+	void * stream_buffer::map(size_t bytes, size_t alignment, size_t &offset) {
+		assert(m_buffer && !m_mapped && alignment > 0);
+
+		size_t head = m_head % m_size;
+		size_t start = (head + alignment - 1) / alignment * alignment;
+		bool wrap = start + bytes > m_size;
+		if (wrap) start = 0;
+		uint64_t end = m_head + (wrap ? m_size - head : start - head) + bytes;
+
+		if (end - m_frameStart > m_size) {
+			// This frame does not fit, replace the buffer with one that does
+			size_t size = m_size;
+			while (size < 2 * (bytes + (m_head - m_frameStart))) size *= 2;
+			release();
+			create(size);
+
+			// Keep counting from a multiple of the new size, so the next
+			// allocation lands at the start of the new buffer
+			m_head = m_frameStart = (m_head + size - 1) / size * size;
+			start = 0;
+			end = m_head + bytes;
+		} else if (wrap && m_mode == mode::orphan) {
+			// Let the driver hand us fresh storage instead of waiting
+			glState().bindBuffer(m_target, m_buffer);
+			glBufferData(m_target, m_size, nullptr, GL_STREAM_DRAW);
+		} else {
+			waitUntilFree(end);
+		}
+
+		m_head = end;
+		offset = start;
+		glState().bindBuffer(m_target, m_buffer);
+
+		if (m_mode == mode::persistent) return static_cast<char *>(m_persistent) + start;
+		if (bytes == 0) return nullptr;
+
+		GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+		if (m_mode == mode::unsynchronized) access |= GL_MAP_UNSYNCHRONIZED_BIT;
+		m_mapped = true;
+		return glMapBufferRange(m_target, start, bytes, access);
+	}
+
+
+	void stream_buffer::unmap() {
+		if (!m_mapped) return;
+		glState().bindBuffer(m_target, m_buffer);
+		glUnmapBuffer(m_target);
+		m_mapped = false;
+	}
+
+
+	void stream_buffer::endFrame() {
+		if (m_head == m_frameStart) return;
+		if (m_mode != mode::orphan) {
+			frame_fence f;
+			f.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			f.start = m_frameStart;
+			f.end = m_head;
+			m_fences.push_back(f);
+		}
+		m_frameStart = m_head;
+	}
+}
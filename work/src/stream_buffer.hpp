@@ -0,0 +1,99 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+#include "opengl.hpp"
+
+namespace cgra {
+
+	// Ring buffer for data that is written by the CPU and drawn by the GPU
+	// every frame (eg. GUI vertices), without reallocating driver storage.
+	//
+	// Each frame allocates ranges one after the other through the buffer,
+	// wrapping back to the start when it reaches the end. A fence is placed
+	// after every frame, and a range is only handed out again once the
+	// frame that last used it has finished on the GPU. The buffer doubles
+	// in size when a single frame does not fit.
+	//
+	// Uses the best of what the context supports:
+	//  - persistent: mapped once with glBufferStorage (GL 4.4 or ARB_buffer_storage)
+	//  - unsynchronized: glMapBufferRange without implicit sync, guarded
+	//    by the fences (GL 3.2 or ARB_sync)
+	//  - orphan: glMapBufferRange, and the storage is orphaned with
+	//    glBufferData instead of waiting when the ring wraps around
+	class stream_buffer {
+	public:
+		enum class mode { persistent, unsynchronized, orphan };
+
+	private:
+		struct frame_fence {
+			GLsync sync;
+			uint64_t start, end; // range of the frame, counted in bytes ever allocated
+		};
+
+		GLenum m_target = 0;
+		GLuint m_buffer = 0;
+		mode m_mode = mode::orphan;
+		size_t m_size = 0;
+		void *m_persistent = nullptr;  // whole buffer, in persistent mode
+		bool m_mapped = false;
+
+		// Position of the next allocation, counted in bytes ever allocated
+		// (so wrapping around does not lose track of which frame wrote what)
+		uint64_t m_head = 0;
+		uint64_t m_frameStart = 0;
+		std::deque<frame_fence> m_fences;
+
+		void create(size_t size);
+		void release();
+		void waitUntilFree(uint64_t end);
+
+	public:
+		stream_buffer() { }
+		stream_buffer(const stream_buffer &) = delete;
+		stream_buffer & operator=(const stream_buffer &) = delete;
+
+		// Creates the buffer for the given target (eg. GL_ARRAY_BUFFER), the
+		// GL context must be current. forced picks a mode rather than the best
+		// supported (it must be supported).
+		void init(GLenum target, size_t size, const mode *forced = nullptr);
+
+		// Deletes the buffer and fences. Not done by the destructor, as the
+		// context is usually gone by the time statics are destroyed.
+		void destroy() { release(); }
+
+		// Reserves bytes aligned to alignment (which does not have to be a
+		// power of two, eg. the size of a vertex), binds the buffer to its
+		// target and returns where to write them. offset is set to where they
+		// start in the buffer. Must be followed by unmap before drawing.
+		// If the frame outgrows the buffer (or the ring wraps in orphan mode)
+		// the storage is replaced, so ranges mapped earlier in the frame must
+		// have been drawn from already.
+		void * map(size_t bytes, size_t alignment, size_t &offset);
+		void unmap();
+
+		// Fences everything allocated since the last call, call once per frame
+		// after the draws that read this frame's data
+		void endFrame();
+
+		GLuint buffer() const { return m_buffer; }
+		size_t size() const { return m_size; }
+		mode currentMode() const { return m_mode; }
+	};
+}
@@ -0,0 +1,225 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+#include "frame_arena.hpp"
+#include "profiler.hpp"
+#include "timeline.hpp"
+
+using namespace std;
+using namespace cgra;
+
+
+void minmax_pyramid::build(const float *samples, int count, int stride) {
+	levels.clear();
+	if (count <= 0) return;
+
+	levels.emplace_back(count);
+	for (int i = 0; i < count; i++) {
+		float v = samples[size_t(i) * stride];
+		levels[0][i] = vec2(v, v);
+	}
+
+	// Halve until a single bucket covers the whole channel
+	while (levels.back().size() > 1) {
+		const vector<vec2> &below = levels.back();
+		vector<vec2> level((below.size() + 1) / 2);
+		for (size_t i = 0; i < level.size(); i++) {
+			vec2 a = below[2 * i];
+			vec2 b = (2 * i + 1 < below.size()) ? below[2 * i + 1] : a;
+			level[i] = vec2(min(a.x, b.x), max(a.y, b.y));
+		}
+		levels.push_back(move(level));
+	}
+}
+
+
+vec2 minmax_pyramid::range(int first, int last, int level) const {
+	level = max(0, min(level, int(levels.size()) - 1));
+	const vector<vec2> &buckets = levels[level];
+	int b0 = max(0, first >> level);
+	int b1 = min(int(buckets.size()), ((last - 1) >> level) + 1);
+
+	vec2 r(numeric_limits<float>::max(), -numeric_limits<float>::max());
+	for (int b = b0; b < b1; b++) {
+		r.x = min(r.x, buckets[b].x);
+		r.y = max(r.y, buckets[b].y);
+	}
+	return r;
+}
+
+
+void Timeline::setSkeleton(const Skeleton *skeleton, function<void()> onReady) {
+	if (m_builder.joinable()) m_builder.join();
+	m_ready = false;
+	m_fresh = false;
+	m_skeleton = skeleton;
+	m_onReady = onReady;
+	m_channels.clear();
+	m_names.clear();
+	if (!m_skeleton || m_skeleton->frameCount() == 0) return;
+
+	// Name the channels in the order they are laid out in a frame
+	static const char *axes[] = { "rx", "ry", "rz" };
+	for (const bone &b : m_skeleton->bones()) {
+		if (b.freedom & dof_root) {
+			m_names.push_back(b.name + " tx");
+			m_names.push_back(b.name + " ty");
+			m_names.push_back(b.name + " tz");
+		}
+		for (int i = 0; i < 3; i++) {
+			if (b.freedom & (dof_rx << i)) m_names.push_back(b.name + " " + axes[i]);
+		}
+	}
+
+	m_viewStart = 0;
+	m_viewFrames = float(m_skeleton->frameCount());
+	m_builder = thread(&Timeline::build, this);
+}
+
+
+void Timeline::build() {
+	CGRA_TRACE_THREAD("Timeline builder");
+	CGRA_PROFILE_SCOPE("Summarize channels");
+
+	const vector<float> &motion = m_skeleton->motion();
+	int channels = m_skeleton->channelsPerFrame();
+	int frames = m_skeleton->frameCount();
+
+	vector<minmax_pyramid> pyramids(channels);
+	for (int c = 0; c < channels; c++) {
+		pyramids[c].build(&motion[c], frames, channels);
+	}
+
+	m_channels = move(pyramids);
+	m_ready = true;
+	m_fresh = true;
+	if (m_onReady) m_onReady();
+}
+
+
+float Timeline::frameAt(float x, float left, float width) const {
+	return m_viewStart + (x - left) / width * m_viewFrames;
+}
+
+
+void Timeline::drawChannel(ImDrawList *drawList, const minmax_pyramid &pyramid, ImVec2 pos, ImVec2 size) {
+	const ImU32 color = ImColor(120, 200, 255);
+
+	// Scale the whole channel to the row
+	vec2 total = pyramid.levels.back()[0];
+	float scale = (total.y > total.x) ? (size.y - 2) / (total.y - total.x) : 0;
+	auto y = [&](float v) { return pos.y + size.y - 1 - (v - total.x) * scale; };
+
+	float framesPerPixel = m_viewFrames / size.x;
+	if (framesPerPixel <= 1) {
+		// Zoomed in, one segment per frame
+		int first = max(0, int(floor(m_viewStart)));
+		int last = min(pyramid.frames(), int(ceil(m_viewStart + m_viewFrames)) + 1);
+		arena_vector<ImVec2> points;
+		points.reserve(max(0, last - first));
+		for (int f = first; f < last; f++) {
+			float x = pos.x + (f - m_viewStart) / framesPerPixel;
+			points.push_back(ImVec2(x, y(pyramid.levels[0][f].x)));
+		}
+		if (points.size() > 1) drawList->AddPolyline(points.data(), int(points.size()), color, false, 1.0f, true);
+		return;
+	}
+
+	// Zoomed out, one vertical span per pixel from buckets no wider than it
+	int level = int(floor(log2(framesPerPixel)));
+	for (int px = 0; px < int(size.x); px++) {
+		float f0 = m_viewStart + px * framesPerPixel;
+		int first = int(floor(f0));
+		int last = int(ceil(f0 + framesPerPixel));
+		if (last <= 0 || first >= pyramid.frames()) continue;
+		vec2 r = pyramid.range(first, last, level);
+		float x = pos.x + px + 0.5f;
+		drawList->AddLine(ImVec2(x, y(r.y)), ImVec2(x, y(r.x) + 1), color);
+	}
+}
+
+
+bool Timeline::draw(float &frame) {
+	if (!m_skeleton || m_viewFrames <= 0) return false;
+
+	ImGuiIO &io = ImGui::GetIO();
+	ImDrawList *drawList = ImGui::GetWindowDrawList();
+	int frames = m_skeleton->frameCount();
+	bool seeked = false;
+
+	// Ruler, which takes the zoom and pan for the whole timeline
+	ImVec2 pos = ImGui::GetCursorScreenPos();
+	float width = max(ImGui::GetContentRegionAvailWidth(), 1.f);
+	float height = ImGui::GetTextLineHeightWithSpacing();
+	ImGui::InvisibleButton("ruler", ImVec2(width, height));
+
+	if (ImGui::IsItemHovered() && io.MouseWheel != 0) {
+		float anchor = frameAt(io.MousePos.x, pos.x, width);
+		float zoomed = m_viewFrames * pow(0.8f, io.MouseWheel);
+		m_viewFrames = max(8.f, min(float(frames), zoomed));
+		m_viewStart = anchor - (io.MousePos.x - pos.x) / width * m_viewFrames;
+	}
+	if (ImGui::IsItemHovered() && ImGui::IsMouseDragging(1)) {
+		m_viewStart -= ImGui::GetMouseDragDelta(1).x / width * m_viewFrames;
+		ImGui::ResetMouseDragDelta(1);
+	}
+	m_viewStart = max(0.f, min(float(frames) - m_viewFrames, m_viewStart));
+
+	if (ImGui::IsItemActive()) {
+		frame = max(0.f, min(float(frames - 1), frameAt(io.MousePos.x, pos.x, width)));
+		seeked = true;
+	}
+
+	drawList->AddRectFilled(pos, ImVec2(pos.x + width, pos.y + height), ImColor(40, 40, 50));
+	char label[64];
+	snprintf(label, sizeof(label), "%d - %d", int(m_viewStart), int(m_viewStart + m_viewFrames));
+	drawList->AddText(ImVec2(pos.x + 4, pos.y), ImColor(200, 200, 200), label);
+
+	float playhead = pos.x + (frame - m_viewStart) / m_viewFrames * width;
+	float bottom = pos.y + height;
+
+	// Channel plots, only the visible rows are drawn
+	if (!m_ready) {
+		ImGui::TextDisabled("Summarizing channels...");
+	} else {
+		ImGui::BeginChild("channels");
+		ImDrawList *rows = ImGui::GetWindowDrawList();
+		ImGuiListClipper clipper(int(m_channels.size()), rowHeight);
+		for (int c = clipper.DisplayStart; c < clipper.DisplayEnd; c++) {
+			ImVec2 row = ImGui::GetCursorScreenPos();
+			ImGui::PushID(c);
+			ImGui::InvisibleButton("channel", ImVec2(width, rowHeight - 1));
+			ImGui::PopID();
+			if (ImGui::IsItemActive()) {
+				frame = max(0.f, min(float(frames - 1), frameAt(io.MousePos.x, row.x, width)));
+				seeked = true;
+			}
+
+			rows->AddRectFilled(row, ImVec2(row.x + width, row.y + rowHeight - 1), ImColor(30, 30, 35));
+			drawChannel(rows, m_channels[c], row, ImVec2(width, rowHeight - 1));
+			rows->AddText(ImVec2(row.x + 4, row.y), ImColor(200, 200, 200), m_names[c].c_str());
+			rows->AddLine(ImVec2(playhead, row.y), ImVec2(playhead, row.y + rowHeight), ImColor(255, 200, 80));
+		}
+		clipper.End();
+		ImGui::EndChild();
+	}
+
+	drawList->AddLine(ImVec2(playhead, pos.y), ImVec2(playhead, bottom), ImColor(255, 200, 80), 2);
+	return seeked;
+}
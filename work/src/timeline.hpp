@@ -0,0 +1,100 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cgra_math.hpp"
+#include "imgui.h"
+#include "skeleton.hpp"
+
+
+// Minimum and maximum of a channel over every power of two run of frames,
+// so any span of frames can be summarized from a handful of buckets
+struct minmax_pyramid {
+	// levels[k][i] is the (min, max) of frames [i * 2^k, (i + 1) * 2^k),
+	// level 0 holds the samples themselves
+	std::vector<std::vector<cgra::vec2>> levels;
+
+	// Builds the levels from count samples, stride floats apart
+	void build(const float *samples, int count, int stride);
+
+	// (min, max) of frames [first, last), from the buckets of the given level
+	cgra::vec2 range(int first, int last, int level) const;
+
+	int frames() const { return levels.empty() ? 0 : int(levels[0].size()); }
+};
+
+
+// Timeline with a plot of every motion channel underneath, for scrubbing
+// through a clip.
+//
+// The plots are drawn from a min/max pyramid of each channel, built on a
+// background thread once the motion is loaded. Each plot draws at most
+// about one segment per pixel whatever the zoom, picking the pyramid level
+// whose buckets are no wider than a pixel.
+//
+// Mouse wheel zooms around the cursor, dragging with the right button pans
+// and clicking or dragging with the left button seeks.
+class Timeline {
+
+private:
+	const Skeleton *m_skeleton = nullptr;
+	std::vector<std::string> m_names;       // "bone rx" for each channel
+
+	// Written by the builder thread until m_ready is set
+	std::vector<minmax_pyramid> m_channels;
+	std::thread m_builder;
+	std::atomic<bool> m_ready { false };
+	std::atomic<bool> m_fresh { false };    // ready and not yet acquired
+	std::function<void()> m_onReady;
+
+	// Visible frames
+	float m_viewStart = 0;
+	float m_viewFrames = 0;
+
+	void build();
+	float frameAt(float x, float left, float width) const;
+	void drawChannel(ImDrawList *, const minmax_pyramid &, ImVec2 pos, ImVec2 size);
+
+public:
+	float rowHeight = 28;
+
+	Timeline() { }
+	Timeline(const Timeline &) = delete;
+	Timeline & operator=(const Timeline &) = delete;
+	~Timeline() { setSkeleton(nullptr); }
+
+	// Starts summarizing the skeleton's motion in the background. The
+	// skeleton must outlive the timeline or the next call. The callback is
+	// run on the builder thread once the plots are ready (eg.
+	// glfwPostEmptyEvent to wake an idle main loop)
+	void setSkeleton(const Skeleton *, std::function<void()> onReady = nullptr);
+
+	// The channel plots are ready to draw
+	bool ready() const { return m_ready; }
+
+	// Returns true once after the plots become ready, so the caller can
+	// redraw a single frame instead of polling while they are built
+	bool acquire() { return m_fresh.exchange(false); }
+
+	// Draws into the current window. Returns true if the user seeked,
+	// setting frame to where. Otherwise frame is only shown as the playhead.
+	bool draw(float &frame);
+};
@@ -0,0 +1,200 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#include "trace.hpp"
+
+#ifdef CGRA_PROFILER
+
+#include <cstring>
+#include <fstream>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CGRA_TRACE_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CGRA_TRACE_RDTSC
+#endif
+
+using namespace std;
+
+namespace cgra {
+
+	namespace {
+		// Buffer of the calling thread, once it has recorded anything
+		thread_local void *t_buffer = nullptr;
+
+		void writeString(ostream &out, const char *s) {
+			out << '"';
+			for (; *s; s++) {
+				if (*s == '"' || *s == '\\') out << '\\';
+				if (static_cast<unsigned char>(*s) >= 0x20) out << *s;
+			}
+			out << '"';
+		}
+	}
+
+
+	trace_recorder & traceRecorder() {
+		static trace_recorder recorder;
+		return recorder;
+	}
+
+
+	trace_recorder::trace_recorder() : m_epoch(clock::now()), m_epochTicks(ticks()) { }
+
+
+	int64_t trace_recorder::ticks() {
+#ifdef CGRA_TRACE_RDTSC
+		return int64_t(__rdtsc());
+#else
+		return chrono::duration_cast<chrono::nanoseconds>(clock::now().time_since_epoch()).count();
+#endif
+	}
+
+
+	double trace_recorder::nanosecondsPerTick() const {
+#ifdef CGRA_TRACE_RDTSC
+		double ns = chrono::duration<double, nano>(clock::now() - m_epoch).count();
+		int64_t elapsed = ticks() - m_epochTicks;
+		return elapsed > 0 ? ns / elapsed : 1;
+#else
+		return 1;
+#endif
+	}
+
+
+	trace_recorder::~trace_recorder() {
+		for (thread_buffer *t : m_threads) {
+			chunk *c = t->first;
+			while (c) {
+				chunk *next = c->next.load(memory_order_relaxed);
+				delete c;
+				c = next;
+			}
+			delete t;
+		}
+	}
+
+
+	trace_recorder::thread_buffer * trace_recorder::threadBuffer() {
+		if (t_buffer) return static_cast<thread_buffer *>(t_buffer);
+
+		thread_buffer *t = new thread_buffer;
+		t->first = t->last = new chunk;
+		lock_guard<mutex> lock(m_mutex);
+		t->id = int(m_threads.size());
+		t->name = "Thread " + to_string(t->id);
+		m_threads.push_back(t);
+		t_buffer = t;
+		return t;
+	}
+
+
+	void trace_recorder::append(char phase, const char *name, uint64_t bits) {
+		int64_t time = ticks() - m_epochTicks;
+		thread_buffer *t = threadBuffer();
+
+		chunk *c = t->last;
+		size_t n = c->count.load(memory_order_relaxed);
+		if (n == chunk::capacity) {
+			chunk *fresh = new chunk;
+			c->next.store(fresh, memory_order_release);
+			t->last = c = fresh;
+			n = 0;
+		}
+
+		event &e = c->events[n];
+		e.time = time;
+		e.name = name;
+		e.id = bits;
+		e.phase = phase;
+		c->count.store(n + 1, memory_order_release);
+	}
+
+
+	void trace_recorder::counter(const char *name, double value) {
+		if (!enabled()) return;
+		uint64_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		append('C', name, bits);
+	}
+
+
+	void trace_recorder::setThreadName(const string &name) {
+		thread_buffer *t = threadBuffer();
+		lock_guard<mutex> lock(m_mutex);
+		t->name = name;
+	}
+
+
+	size_t trace_recorder::eventCount() {
+		lock_guard<mutex> lock(m_mutex);
+		size_t count = 0;
+		for (thread_buffer *t : m_threads) {
+			for (chunk *c = t->first; c; c = c->next.load(memory_order_acquire)) {
+				count += c->count.load(memory_order_acquire);
+			}
+		}
+		return count;
+	}
+
+
+	bool trace_recorder::write(const string &path) {
+		ofstream out(path);
+		if (!out) return false;
+
+		double scale = nanosecondsPerTick();
+		lock_guard<mutex> lock(m_mutex);
+		out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+		bool first = true;
+		auto separate = [&] {
+			if (!first) out << ",\n";
+			first = false;
+		};
+
+		for (thread_buffer *t : m_threads) {
+			separate();
+			out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << t->id << ",\"args\":{\"name\":";
+			writeString(out, t->name.c_str());
+			out << "}}";
+
+			for (chunk *c = t->first; c; c = c->next.load(memory_order_acquire)) {
+				size_t count = c->count.load(memory_order_acquire);
+				for (size_t i = 0; i < count; i++) {
+					const event &e = c->events[i];
+					separate();
+					out << "{\"ph\":\"" << e.phase << "\",\"name\":";
+					writeString(out, e.name);
+					// Timestamps are in microseconds
+					int64_t ns = int64_t(e.time * scale);
+					out << ",\"pid\":1,\"tid\":" << t->id << ",\"ts\":" << ns / 1000 << '.'
+						<< char('0' + ns / 100 % 10) << char('0' + ns / 10 % 10) << char('0' + ns % 10);
+					if (e.phase == 'C') {
+						out << ",\"args\":{\"value\":" << e.value << "}";
+					} else if (e.phase == 's' || e.phase == 'f') {
+						out << ",\"cat\":\"flow\",\"id\":" << e.id;
+						if (e.phase == 'f') out << ",\"bp\":\"e\"";
+					}
+					out << "}";
+				}
+			}
+		}
+
+		out << "\n]}\n";
+		return bool(out);
+	}
+}
+
+#endif
@@ -0,0 +1,129 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#pragma once
+
+// Event recorder that writes Chrome trace_event JSON (chrome://tracing,
+// Perfetto), built with the frame profiler (CGRA_PROFILER). Every
+// CGRA_PROFILE_SCOPE is also recorded as a begin/end pair while tracing.
+//
+//   CGRA_TRACE_COUNTER(name, value)  plots a value over time
+//   CGRA_TRACE_FLOW_BEGIN(name, id)  draws an arrow from here to the
+//   CGRA_TRACE_FLOW_END(name, id)    matching end, eg. across threads
+//   CGRA_TRACE_THREAD(name)          names the calling thread
+//
+// Names must be string literals (or otherwise outlive the recorder).
+
+#ifdef CGRA_PROFILER
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define CGRA_TRACE_COUNTER(name, value) ::cgra::traceRecorder().counter(name, double(value))
+#define CGRA_TRACE_FLOW_BEGIN(name, id) ::cgra::traceRecorder().flowBegin(name, uint64_t(id))
+#define CGRA_TRACE_FLOW_END(name, id) ::cgra::traceRecorder().flowEnd(name, uint64_t(id))
+#define CGRA_TRACE_THREAD(name) ::cgra::traceRecorder().setThreadName(name)
+
+namespace cgra {
+
+	// Records events into a buffer per thread. Only the owning thread
+	// appends to a buffer, and it publishes each event with a release store
+	// of the count, so recording takes no locks and write() can run while
+	// other threads are still recording.
+	//
+	// Nothing is recorded until tracing is enabled, and until then each
+	// event costs one relaxed load. Events are kept until exit.
+	class trace_recorder {
+	public:
+		struct event {
+			int64_t time;     // ticks since the recorder was created
+			const char *name;
+			union {
+				double value;   // counters
+				uint64_t id;    // flows
+			};
+			char phase;       // trace_event phase: B, E, C, s or f
+		};
+
+	private:
+		struct chunk {
+			static const size_t capacity = 4096;
+			event events[capacity];
+			std::atomic<size_t> count { 0 };
+			std::atomic<chunk *> next { nullptr };
+		};
+
+		struct thread_buffer {
+			int id;
+			std::string name;
+			chunk *first;
+			chunk *last;
+		};
+
+		// Events are stamped with the CPU's time stamp counter where there is
+		// one, which is cheaper to read than the OS clock, and converted to
+		// time when written out using the OS clock over the same span
+		typedef std::chrono::steady_clock clock;
+		clock::time_point m_epoch;
+		int64_t m_epochTicks;
+		std::atomic<bool> m_enabled { false };
+
+		static int64_t ticks();
+		double nanosecondsPerTick() const;
+
+		std::mutex m_mutex; // guards the list of threads and their names
+		std::vector<thread_buffer *> m_threads;
+
+		thread_buffer * threadBuffer();
+		void append(char phase, const char *name, uint64_t bits);
+
+	public:
+		trace_recorder();
+		trace_recorder(const trace_recorder &) = delete;
+		trace_recorder & operator=(const trace_recorder &) = delete;
+		~trace_recorder();
+
+		void setEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+		bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+		void begin(const char *name) { if (enabled()) append('B', name, 0); }
+		void end(const char *name) { if (enabled()) append('E', name, 0); }
+		void counter(const char *name, double value);
+		void flowBegin(const char *name, uint64_t id) { if (enabled()) append('s', name, id); }
+		void flowEnd(const char *name, uint64_t id) { if (enabled()) append('f', name, id); }
+		void setThreadName(const std::string &);
+
+		// Writes everything recorded so far, returns false if the file
+		// could not be written
+		bool write(const std::string &path);
+
+		// Events recorded so far, across all threads
+		size_t eventCount();
+	};
+
+	trace_recorder & traceRecorder();
+}
+
+#else
+
+#define CGRA_TRACE_COUNTER(name, value) ((void) 0)
+#define CGRA_TRACE_FLOW_BEGIN(name, id) ((void) 0)
+#define CGRA_TRACE_FLOW_END(name, id) ((void) 0)
+#define CGRA_TRACE_THREAD(name) ((void) 0)
+
+#endif
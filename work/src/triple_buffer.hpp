@@ -0,0 +1,73 @@
+//---------------------------------------------------------------------------
+//
+// Copyright (c) 2016 Taehyun Rhee, Joshua Scott, Ben Allen
+//
+// This software is provided 'as-is' for assignment of COMP308 in ECS,
+// Victoria University of Wellington, without any express or implied warranty. 
+// In no event will the authors be held liable for any damages arising from
+// the use of this software.
+//
+// The contents of this file may not be copied or duplicated in any form
+// without the prior permission of its owner.
+//
+//----------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+
+namespace cgra {
+
+	// Lock-free hand-off of values from one producer thread to one consumer
+	// thread. The producer fills back() and publishes it, the consumer
+	// acquires the most recently published value into front(). Neither side
+	// ever waits for the other; values published faster than they are
+	// acquired are simply skipped.
+	//
+	// The three buffers are only ever swapped, never copied, so values that
+	// own memory (like vectors) keep their capacity between uses.
+	template <typename T>
+	class triple_buffer {
+	private:
+		// set on the shared index when it holds a value not yet acquired
+		static const unsigned fresh_bit = 4;
+
+		T m_buffers[3];
+		unsigned m_back = 0;
+		std::atomic<unsigned> m_shared { 1 };
+		unsigned m_front = 2;
+
+	public:
+		// Producer side
+		//
+
+		T & back() {
+			return m_buffers[m_back];
+		}
+
+		// Makes the back buffer available to the consumer and takes
+		// whichever buffer was shared as the new back buffer
+		void publish() {
+			m_back = m_shared.exchange(m_back | fresh_bit, std::memory_order_acq_rel) & ~fresh_bit;
+		}
+
+		// Consumer side
+		//
+
+		// Takes the most recently published buffer as the front buffer,
+		// returns false (and keeps the current front) if nothing new was published
+		bool acquire() {
+			if (!(m_shared.load(std::memory_order_relaxed) & fresh_bit)) return false;
+			m_front = m_shared.exchange(m_front, std::memory_order_acq_rel) & ~fresh_bit;
+			return true;
+		}
+
+		const T & front() const {
+			return m_buffers[m_front];
+		}
+
+		T & front() {
+			return m_buffers[m_front];
+		}
+	};
+}